@@ -7,6 +7,7 @@ layout (binding = 0) uniform sampler2DArray textureSampler;
 layout(location = 0) in vec3 vPosition;
 layout(location = 1) in vec3 vNormal;
 layout(location = 2) in vec3 vUV;
+layout(location = 3) in float vAO;
 
 layout(push_constant) uniform _fragment_push {
 	layout(offset = 192) vec4 lightColor;
@@ -34,6 +35,6 @@ void main() {
 	float spec = pow(max(dot(view_dir, reflect_dir), 0.0f), 32.0f);
 	vec3 specular = specular_strength * spec * ubo.lightColor.xyz;
 
-	vec4 light_result = vec4(ambient + diffuse + specular, 1.0f);
+	vec4 light_result = vec4((ambient + diffuse) * vAO + specular, 1.0f);
 	fragColor = light_result * texcolor;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec3 uv;
+layout(location = 3) in float ao;
 
 layout(push_constant) uniform _ubo {
 	mat4 model;
@@ -20,9 +21,14 @@ out gl_PerVertex {
 layout(location = 0) out vec3 vPosition;
 layout(location = 1) out vec3 vNormal;
 layout(location = 2) out vec3 vUV;
+layout(location = 3) out float vAO;
+
+// Brightness for each baked ambient occlusion level, 0 being fully occluded
+const float aoCurve[4] = float[4](0.45f, 0.65f, 0.85f, 1.0f);
 
 void main() {
 	vUV = uv;
+	vAO = aoCurve[clamp(int(ao), 0, 3)];
 	mat3 norm_transform = transpose(inverse(mat3(ubo.model)));
 	vNormal = normalize(norm_transform * normal);
 	vPosition = vec3(vec4(position, 1.0f) * ubo.model);
@@ -0,0 +1,68 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Unpacks packed_chunk_vertex_t: see engine/include/objects/PackedChunkVertex.hpp for the bit layout.
+// DecodePackedChunkVertex() in that header is the CPU reference for this shader.
+layout(location = 0) in uvec2 packedData;
+
+layout(push_constant) uniform _ubo {
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+} ubo;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+layout(location = 0) out vec3 vPosition;
+layout(location = 1) out vec3 vNormal;
+layout(location = 2) out vec3 vUV;
+layout(location = 3) out float vAO;
+
+// Brightness for each baked ambient occlusion level, 0 being fully occluded
+const float aoCurve[4] = float[4](0.45f, 0.65f, 0.85f, 1.0f);
+
+const vec3 normals[6] = vec3[6](
+	vec3( 0.0f, 0.0f, 1.0f), vec3( 1.0f, 0.0f, 0.0f), vec3( 0.0f, 1.0f, 0.0f),
+	vec3(-1.0f, 0.0f, 0.0f), vec3( 0.0f,-1.0f, 0.0f), vec3( 0.0f, 0.0f,-1.0f)
+);
+
+// Which side of the block each corner of each face lies on, indexed by face * 4 + corner
+const vec3 cornerOffsets[24] = vec3[24](
+	vec3(0, 0, 1), vec3(1, 0, 1), vec3(1, 1, 1), vec3(0, 1, 1), // front
+	vec3(1, 0, 1), vec3(1, 0, 0), vec3(1, 1, 0), vec3(1, 1, 1), // right
+	vec3(0, 1, 1), vec3(1, 1, 1), vec3(1, 1, 0), vec3(0, 1, 0), // top
+	vec3(0, 0, 0), vec3(0, 0, 1), vec3(0, 1, 1), vec3(0, 1, 0), // left
+	vec3(0, 0, 0), vec3(1, 0, 0), vec3(1, 0, 1), vec3(0, 0, 1), // bottom
+	vec3(1, 0, 0), vec3(0, 0, 0), vec3(0, 1, 0), vec3(1, 1, 0)  // back
+);
+
+const vec2 cornerUVs[4] = vec2[4](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1));
+
+// Axes that UV.x and UV.y run along, per face
+const ivec2 uvAxes[6] = ivec2[6](ivec2(0, 1), ivec2(2, 1), ivec2(0, 2), ivec2(2, 1), ivec2(0, 2), ivec2(0, 1));
+
+void main() {
+	vec3 block = vec3(float(packedData.x & 0x1Fu), float((packedData.x >> 5) & 0x7Fu), float((packedData.x >> 12) & 0x1Fu));
+	uint face = (packedData.x >> 17) & 0x7u;
+	uint corner = (packedData.x >> 20) & 0x3u;
+	float layer = float(packedData.y & 0xFFFu);
+	float width = float(((packedData.y >> 12) & 0x7Fu) + 1u);
+	float height = float(((packedData.y >> 19) & 0x7Fu) + 1u);
+
+	vec3 extent = vec3(1.0f);
+	extent[uvAxes[face].x] = width;
+	extent[uvAxes[face].y] = height;
+
+	vec3 position = block - vec3(0.50f) + cornerOffsets[face * 4u + corner] * extent;
+
+	vUV = vec3(cornerUVs[corner] * vec2(width, height), layer);
+	vAO = aoCurve[(packedData.x >> 22) & 0x3u];
+	mat3 norm_transform = transpose(inverse(mat3(ubo.model)));
+	vNormal = normalize(norm_transform * normals[face]);
+	vPosition = vec3(vec4(position, 1.0f) * ubo.model);
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(position, 1.0f);
+}
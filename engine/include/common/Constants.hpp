@@ -1,6 +1,7 @@
 #pragma once
 #ifndef HEPHAESTUS_ENGINE_CONSTANTS_HPP
 #define HEPHAESTUS_ENGINE_CONSTANTS_HPP
+#include <cstddef>
 
 // Light has a range from 0-15. 15 is absolute highest, equivalent to sunlight.
 // 14 is highest we allow for all non-sunlight sources.
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_DENSITY_FIELD_HPP
+#define HEPHAESTUS_ENGINE_DENSITY_FIELD_HPP
+#include "NoiseGen.hpp"
+#include "objects/Chunk.hpp"
+#include <array>
+
+namespace terrain {
+
+	/*
+		DensityField
+
+		3D noise across a chunk, for terrain a heightmap can't express: overhangs, arches and caves. Noise is only
+		evaluated on a coarse lattice, every LATTICE_SPACING blocks along each axis, and trilinearly interpolated
+		in between: 9 x 33 x 9 samples per chunk rather than one per block. Features smaller than the spacing are
+		lost, which for large scale density noise is no loss.
+	*/
+	class DensityField {
+	public:
+
+		constexpr static size_t LATTICE_SPACING = 4;
+		constexpr static size_t LATTICE_X = CHUNK_SIZE / LATTICE_SPACING + 1;
+		constexpr static size_t LATTICE_Y = CHUNK_SIZE_Y / LATTICE_SPACING + 1;
+		constexpr static size_t LATTICE_Z = LATTICE_X;
+
+		// Samples "noise" at the lattice points of the chunk at "grid_position"
+		void SampleLattice(const noise::NoiseGenerator& noise, const glm::ivec2& grid_position);
+		// Adds (base_height - y) * falloff at each lattice point, pulling the field towards a surface at base_height.
+		// Being linear in y, interpolating it is exact.
+		void AddHeightGradient(const float& base_height, const float& falloff);
+		// Writes the field's value at each block of the chunk to "dest", BLOCKS_PER_CHUNK values in GetBlockIndex() order
+		void Interpolate(float* dest) const;
+
+		float GetLatticeValue(const size_t& x, const size_t& y, const size_t& z) const;
+
+	private:
+
+		// Bilinear interpolation of lattice layer "y" to each block column, x-major like GetBlockIndex()
+		void interpolateLayer(const size_t& y, float* dest) const;
+
+		std::array<float, LATTICE_X * LATTICE_Y * LATTICE_Z> lattice;
+
+	};
+
+	struct DensityTerrainParams {
+		// Height the surface lies around, in blocks
+		float BaseHeight = 64.0f;
+		// Change in density per block along y. Smaller values let the noise carve taller overhangs and deeper caves.
+		float HeightFalloff = 1.0f / 24.0f;
+	};
+
+	// Fills chunk.Blocks for chunk.GridPosition: stone wherever the density field is positive, air elsewhere, and bedrock
+	// on the bottom layer. Nothing in the engine calls this yet: ChunkManager's terrain comes from TerrainGenerator alone.
+	// It's a standalone alternative for worlds wanting overhangs, timed by tests/density_benchmark.
+	void GenerateDensityTerrain(const noise::NoiseGenerator& noise, const DensityTerrainParams& params, ChunkComponent& chunk);
+
+}
+
+#endif //!HEPHAESTUS_ENGINE_DENSITY_FIELD_HPP
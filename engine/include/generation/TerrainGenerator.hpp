@@ -1,22 +1,171 @@
 #pragma once
-#ifndef TERRAIN_GENERATOR_H
-#define TERRAIN_GENERATOR_H
-
-#include "stdafx.h"
-#include "NoiseSampler.h"
+#ifndef HEPHAESTUS_ENGINE_TERRAIN_GENERATOR_HPP
+#define HEPHAESTUS_ENGINE_TERRAIN_GENERATOR_HPP
+#include "NoiseGen.hpp"
+#include "objects/Chunk.hpp"
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include "glm/gtx/hash.hpp"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace terrain {
 
+	constexpr static size_t COLUMNS_PER_CHUNK = CHUNK_SIZE * CHUNK_SIZE;
+
+	// In the order they run
+	enum class terrainStage {
+		HEIGHT,
+		STRATA,
+		CAVES,
+		DECORATION,
+		COUNT
+	};
+
+	// 2D noise across the world, remapped from the noise's range to [Min, Max]
+	struct TerrainSampler {
+		TerrainSampler(const float& frequency, const size_t& seed, const float& min, const float& max) : Min(min), Max(max) {
+			Noise.Frequency = frequency;
+			Noise.Seed = seed;
+		}
+		noise::NoiseCfg Noise;
+		float Min, Max;
+	};
+
+	struct TerrainCfg {
+		// Broad lay of the land, in blocks
+		TerrainSampler HeightBase{ 0.0025f, 192487, 48.0f, 80.0f };
+		// Local hills added to HeightBase
+		TerrainSampler HeightScale{ 0.01f, 7919, -12.0f, 16.0f };
+		// Blocks of dirt under the surface, grass included
+		TerrainSampler SoilDepth{ 0.02f, 6133, 2.0f, 6.0f };
+		// Blocks of grass on top of the dirt
+		TerrainSampler GrassDepth{ 0.02f, 2953, 1.0f, 2.0f };
+		// Height of cave floors
+		TerrainSampler CaveStart{ 0.005f, 9049, 12.0f, 48.0f };
+		// Height of caves above their floor. No cave where this is below 1, so caves form winding tunnels and chambers.
+		TerrainSampler CaveEnd{ 0.015f, 5413, -8.0f, 10.0f };
+		// Small scale wobble added to cave floors and ceilings
+		TerrainSampler CaveWalkVariance{ 0.03f, 1361, -3.0f, 3.0f };
+		// Picks where decorations go
+		uint32_t DecorationSeed = 8231;
+		// Chances of a grass block getting tall grass, or a flower, on top
+		float TallGrassChance = 0.125f;
+		float FlowerChance = 0.02f;
+		// Chunks whose cached stage output is kept, per cached stage
+		size_t CacheCapacity = 256;
+	};
+
+	// Shared by the stages generating a chunk: each reads what earlier stages wrote
+	struct TerrainScratch {
+		glm::ivec2 GridPosition;
+		// Per column, indexed x * CHUNK_SIZE + z like a layer of blocks. Written by HEIGHT.
+		std::array<uint8_t, COLUMNS_PER_CHUNK> Height, SoilDepth, GrassDepth;
+		// Blocks from CaveFloor up to, but not including, CaveCeiling are carved out. Written by CAVES.
+		std::array<uint8_t, COLUMNS_PER_CHUNK> CaveFloor, CaveCeiling;
+		// Remapped sampler output, before rounding to blocks, for stages combining samplers
+		std::array<std::array<float, COLUMNS_PER_CHUNK>, 2> Samples;
+		// Indices into the generator's palette, in GetBlockIndex() order
+		std::vector<uint16_t> Entries = std::vector<uint16_t>(BLOCKS_PER_CHUNK);
+	};
+
+	struct TerrainStageStats {
+		uint64_t Runs{ 0 };
+		// Runs that took their output from the cache, rather than sampling it
+		uint64_t CacheHits{ 0 };
+		double TotalTimeMs{ 0.0 };
+	};
+
+	/*
+		TerrainGenerator
+
+		Fills chunks with terrain in stages, each working on whole columns of the chunk:
+
+		- HEIGHT samples the surface height and soil depths of each column
+		- STRATA fills each column with bedrock, stone, dirt and grass up to its surface
+		- CAVES samples a cave's floor and ceiling in each column, and carves it out
+		- DECORATION puts tall grass and flowers on grass. ChunkMeshingSystem can't draw plants yet, so switch it off for
+		  chunks that get meshed.
+
+		Stages pass their results along through a TerrainScratch, one per thread. A stage that's switched off leaves the
+		scratch as it found it, which is a flat, bare, cave-free world before any stage runs. HEIGHT and CAVES, the stages
+		that sample noise, can keep their output for the most recently generated chunks, so regenerating a chunk (e.g. as
+		a baseline for saving it) only runs the cheap fills.
+
+		Generate() may be called from several threads at once: the config and samplers are fixed at construction. Stage switches are not synchronized: set them up first.
+	*/
 	class TerrainGenerator {
+		TerrainGenerator(const TerrainGenerator&) = delete;
+		TerrainGenerator& operator=(const TerrainGenerator&) = delete;
 	public:
 
-		TerrainGenerator();
+		constexpr static size_t STAGE_COUNT = static_cast<size_t>(terrainStage::COUNT);
+		// Bump whenever a change to the stages changes their output. Config changes are covered by GetVersion().
+		constexpr static uint32_t VERSION = 1;
+
+		TerrainGenerator(const TerrainCfg& cfg = TerrainCfg());
+
+		void Generate(ChunkComponent& chunk) const;
+		// Runs the enabled stages into "scratch", without building a chunk from it
+		void RunStages(const glm::ivec2& grid_position, TerrainScratch& scratch) const;
+
+		void SetStageEnabled(const terrainStage stage, const bool enabled);
+		// Only HEIGHT and CAVES produce cacheable output: others throw std::invalid_argument
+		void SetStageCached(const terrainStage stage, const bool cached);
+		bool StageEnabled(const terrainStage stage) const noexcept;
+		bool StageCached(const terrainStage stage) const noexcept;
+
+		// Identifies the terrain Generate() produces: VERSION mixed with a hash of the config, the enabled stages and the SIMD level
+		// noise is sampled with. Chunks saved as deltas against the terrain can only be loaded by a generator with the same version.
+		uint32_t GetVersion() const noexcept;
+
+		TerrainStageStats GetStageStats(const terrainStage stage) const;
+		void ResetStageStats();
+
+		// Blocks the scratch's entries refer to
+		static const std::vector<BlockComponent>& GetPalette();
 
 	private:
-		
-		noise::NoiseSampler HeightBase, HeightScale, SoilDepth, GrassDepth,
-			CaveStart, CaveEnd, CaveWalkVariance;
+
+		struct stageCache {
+			std::mutex Mutex;
+			std::unordered_map<glm::ivec2, std::vector<uint8_t>> Entries;
+			// Oldest first, for eviction
+			std::deque<glm::ivec2> Order;
+		};
+
+		struct stageCounters {
+			std::atomic<uint64_t> Runs{ 0 };
+			std::atomic<uint64_t> CacheHits{ 0 };
+			std::atomic<uint64_t> Nanoseconds{ 0 };
+		};
+
+		void runStage(const terrainStage stage, TerrainScratch& scratch) const;
+		// Returns true if it took the stage's output from the cache
+		bool runHeight(TerrainScratch& scratch) const;
+		void runStrata(TerrainScratch& scratch) const;
+		bool runCaves(TerrainScratch& scratch) const;
+		void runDecoration(TerrainScratch& scratch) const;
+
+		// Writes "noise", remapped as "sampler" says, at each column of the chunk at "grid_position" to "dest"
+		void sampleColumns(const noise::NoiseGenerator& noise, const TerrainSampler& sampler, const glm::ivec2& grid_position, float* dest) const;
+		// Scratch arrays holding each cacheable stage's output
+		static std::vector<uint8_t*> stageOutputs(const terrainStage stage, TerrainScratch& scratch);
+		bool fetchCached(const terrainStage stage, TerrainScratch& scratch) const;
+		void storeCached(const terrainStage stage, TerrainScratch& scratch) const;
+
+		const TerrainCfg cfg;
+		const noise::NoiseGenerator heightBase, heightScale, soilDepth, grassDepth, caveStart, caveEnd, caveWalkVariance;
+		std::array<bool, STAGE_COUNT> stageEnabled;
+		std::array<bool, STAGE_COUNT> stageCached;
+		mutable std::array<stageCache, STAGE_COUNT> caches;
+		mutable std::array<stageCounters, STAGE_COUNT> counters;
 	};
 
 }
-#endif // !TERRAIN_GENERATOR_H
+#endif // !HEPHAESTUS_ENGINE_TERRAIN_GENERATOR_HPP
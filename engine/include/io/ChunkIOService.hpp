@@ -0,0 +1,144 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_IO_SERVICE_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_IO_SERVICE_HPP
+#include "RegionStore.hpp"
+#include "util/mpsc_queue.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+
+    ChunkIOService
+
+    Saves and loads chunks on a dedicated I/O thread, which owns the RegionStore, so the
+    main thread never waits on the disk. Requests go into a bounded queue: when it is
+    full, Save() and Load() refuse new requests rather than block, and the caller tries
+    again next frame.
+
+    - Saves are keyed by chunk. Saving a chunk that is still queued replaces the queued
+      blocks rather than adding a second write.
+    - Reads are served before any queued write, and between the writes of a batch.
+    - Writes are taken a batch at a time, sorted by region file and then position in
+      the file, and each region file touched is flushed once per batch.
+    - A load of a chunk still waiting to be saved returns the queued blocks, so chunks
+      that leave and re-enter view before their save lands don't lose edits.
+
+    Loaded chunks come back through DrainCompleted(), which also reports ChunkIOStats to
+    the callback set with SetStatsCallback(), once per call.
+
+*/
+
+struct ChunkIOStats {
+    size_t QueuedReads{ 0 };
+    size_t QueuedWrites{ 0 };
+    // Saves that replaced a queued save of the same chunk
+    uint64_t CoalescedWrites{ 0 };
+    uint64_t ChunksRead{ 0 };
+    uint64_t ChunksWritten{ 0 };
+    uint64_t BytesRead{ 0 };
+    uint64_t BytesWritten{ 0 };
+    // Requests that failed, e.g. on a corrupt payload, a region file that couldn't be opened, or a full disk
+    uint64_t Errors{ 0 };
+    // Loads of chunks saved against a different generator version, and saves skipped so as not to overwrite them
+    uint64_t IncompatibleChunks{ 0 };
+    // Since the previous report
+    double ReadBytesPerSecond{ 0.0 };
+    double WriteBytesPerSecond{ 0.0 };
+};
+
+class ChunkIOService {
+    ChunkIOService(const ChunkIOService&) = delete;
+    ChunkIOService& operator=(const ChunkIOService&) = delete;
+public:
+
+    // "baseline" is used from the I/O thread, see RegionStore
+    ChunkIOService(const std::string& directory, TerrainBaseline baseline = TerrainBaseline(), const size_t max_queued = 1024, const size_t max_batch = 64);
+    // Finishes every queued save before returning
+    ~ChunkIOService();
+
+    // Queues "chunk" to be saved, taking its blocks. Returns false, leaving "chunk" untouched, if the queue is full.
+    bool Save(ChunkComponent& chunk);
+    // Queues a load of the chunk at "grid_position", handed back through DrainCompleted(). Returns false if the queue is full.
+    bool Load(const glm::ivec2& grid_position);
+    // Hints that the chunk at "grid_position" will be loaded soon. Dropped if the queue is full.
+    void Prefetch(const glm::ivec2& grid_position);
+
+    // Call once per frame, from the main thread. Invokes "fn(const glm::ivec2& grid_position, ChunkLoadStatus status, ChunkComponent* chunk)"
+    // for every load completed since the last call, with "chunk" set to nullptr unless "status" is Loaded. A load that threw
+    // reading the region file reports Failed. Then reports stats to the stats callback, if any. Returns the number of loads handed out.
+    template<typename Fn>
+    size_t DrainCompleted(Fn&& fn);
+
+    // Called from DrainCompleted(), on the main thread
+    void SetStatsCallback(std::function<void(const ChunkIOStats&)> callback);
+    ChunkIOStats GetStats() const;
+    // Blocks until the queue is empty and the I/O thread is idle
+    void WaitIdle();
+
+private:
+
+    struct loadResult {
+        glm::ivec2 GridPosition;
+        ChunkLoadStatus Status;
+        ChunkComponent Chunk;
+    };
+
+    void ioThreadFunction();
+    // Serves every queued read and prefetch. "unwritten" is the part of the current write batch not on disk yet.
+    // Call without queueMutex held.
+    void serviceReads(const span_t<const ChunkComponent> unwritten);
+    void writeBatch(std::vector<ChunkComponent>& batch);
+    size_t queuedRequests() const noexcept;
+    void reportStats();
+
+    RegionStore store;
+    size_t maxQueued;
+    size_t maxBatch;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable cVar;
+    std::condition_variable idleCVar;
+    std::deque<glm::ivec2> reads;
+    std::deque<glm::ivec2> prefetches;
+    std::unordered_map<glm::ivec2, ChunkComponent> writes;
+    // Order "writes" were first queued in
+    std::deque<glm::ivec2> writeOrder;
+    bool busy{ false };
+    bool shutdown{ false };
+    // Mirrors reads.size(), so the I/O thread can check for reads between writes without locking
+    std::atomic<size_t> pendingReads{ 0 };
+    std::thread ioThread;
+
+    mpsc_queue_t<loadResult> completed;
+
+    std::atomic<uint64_t> coalescedWrites{ 0 };
+    std::atomic<uint64_t> chunksRead{ 0 };
+    std::atomic<uint64_t> chunksWritten{ 0 };
+    std::atomic<uint64_t> bytesRead{ 0 };
+    std::atomic<uint64_t> bytesWritten{ 0 };
+    std::atomic<uint64_t> errors{ 0 };
+    std::atomic<uint64_t> incompatibleChunks{ 0 };
+
+    // Only accessed from the main thread
+    std::function<void(const ChunkIOStats&)> statsCallback;
+    std::chrono::steady_clock::time_point lastReport{ std::chrono::steady_clock::now() };
+    uint64_t lastBytesRead{ 0 };
+    uint64_t lastBytesWritten{ 0 };
+
+};
+
+template<typename Fn>
+inline size_t ChunkIOService::DrainCompleted(Fn&& fn) {
+    const size_t num_drained = completed.consume_all([&](loadResult&& result) {
+        fn(static_cast<const glm::ivec2&>(result.GridPosition), result.Status, result.Status == ChunkLoadStatus::Loaded ? &result.Chunk : nullptr);
+    });
+    reportStats();
+    return num_drained;
+}
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_IO_SERVICE_HPP
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_SERIALIZER_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_SERIALIZER_HPP
+#include "objects/Chunk.hpp"
+#include "util/span.hpp"
+#include <cstdint>
+#include <vector>
+
+/*
+
+    ChunkSerializer
+
+    Converts a chunk's blocks to and from the payloads stored in region files. A payload
+    is a payload_header_t, the chunk's palette, then each block's palette index in
+    GetBlockIndex() order, run-length encoded as 16 bit values. Whole layers of air or
+    stone collapse into a couple of runs, so a typical chunk is a few KiB.
+
+    Delta payloads (FLAG_DELTA) only hold the blocks that differ from a baseline: the
+    chunk as the terrain generator produces it. The header is followed by the version
+    of the generator the baseline came from, then a palette of just the changed blocks.
+    Each entry is 0 for a block matching the baseline, or one more than its index into
+    that palette. An untouched chunk is then a single run of zeroes, a few dozen bytes.
+    Loading one means regenerating the baseline with the same generator version, then
+    patching it.
+
+    Payloads are written in the host's byte order: little endian, on every platform we
+    ship on.
+
+*/
+
+struct ChunkSerializer {
+
+    constexpr static uint32_t MAGIC = 0x4b484348; // "HCHK"
+    constexpr static uint16_t VERSION = 1;
+    constexpr static uint16_t FLAG_DELTA = 0x1;
+    // GetBaselineVersion() of a payload holding the whole chunk
+    constexpr static uint32_t NO_BASELINE = UINT32_MAX;
+
+    struct payload_header_t {
+        uint32_t Magic;
+        uint16_t Version;
+        uint16_t Flags;
+        uint32_t PaletteSize;
+        // In 16 bit values
+        uint32_t EncodedSize;
+    };
+
+    // Replaces the contents of "payload"
+    static void Serialize(const ChunkComponent& chunk, std::vector<uint8_t>& payload);
+    // Replaces the contents of "payload" with the blocks of "chunk" that differ from "baseline", which version
+    // "generator_version" of the terrain generator produced for the same chunk. Chunks that differ from their
+    // baseline in half their blocks or more are written whole, as the delta would gain nothing.
+    static void SerializeDelta(const ChunkComponent& chunk, const ChunkComponent& baseline, const uint32_t generator_version, std::vector<uint8_t>& payload);
+    // Replaces the blocks of "chunk". For delta payloads, "chunk" must hold the baseline the payload was made
+    // against, which gets patched. Throws if "payload" isn't a valid chunk payload.
+    static void Deserialize(const span_t<const uint8_t> payload, ChunkComponent& chunk);
+    // Version of the terrain generator a delta payload has to be applied to the output of, or NO_BASELINE
+    static uint32_t GetBaselineVersion(const span_t<const uint8_t> payload);
+
+};
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_SERIALIZER_HPP
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_MAPPED_FILE_HPP
+#define HEPHAESTUS_ENGINE_MAPPED_FILE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+
+    MappedFile
+
+    Read-only memory mapping of a whole file, through mmap on POSIX systems and file
+    mapping objects on Windows. Reading through the mapping skips the copy from the
+    page cache into a stdio buffer, and then into the caller's. Advise() passes access
+    pattern hints on to the OS: madvise, or PrefetchVirtualMemory on Windows (which has
+    no equivalent for the other hints, so only acts on WillNeed).
+
+    The mapping covers the file as it was when mapped. Writes to that range through
+    other handles show up in it, once flushed out of any stdio buffers, but the file
+    has to be mapped again to see past its old end.
+
+*/
+
+enum class MappedAccess : uint8_t {
+    Normal,
+    Sequential,
+    Random,
+    // Read the range in ahead of use
+    WillNeed
+};
+
+class MappedFile {
+public:
+
+    MappedFile() noexcept = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps all of "path", replacing any current mapping. Throws if the file can't be opened or mapped. Empty files
+    // can't be mapped, and leave the object unmapped.
+    void Map(const std::string& path);
+    void Unmap() noexcept;
+
+    bool IsMapped() const noexcept;
+    const uint8_t* Data() const noexcept;
+    size_t Size() const noexcept;
+
+    // Hint for the bytes from "offset" to "offset" + "length". Best effort: failures are ignored.
+    void Advise(const size_t offset, const size_t length, const MappedAccess access) const noexcept;
+
+private:
+
+    const uint8_t* data{ nullptr };
+    size_t size{ 0 };
+
+};
+
+#endif //!HEPHAESTUS_ENGINE_MAPPED_FILE_HPP
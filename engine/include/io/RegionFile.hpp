@@ -0,0 +1,117 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_REGION_FILE_HPP
+#define HEPHAESTUS_ENGINE_REGION_FILE_HPP
+#include "MappedFile.hpp"
+#include "util/span.hpp"
+#include "glm/vec2.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+
+    RegionFile
+
+    On-disk store for the chunks of one region: a REGION_SIZE x REGION_SIZE area of the
+    chunk grid, so a world of any size takes a manageable number of files. The file is
+    split into SECTOR_SIZE byte sectors:
+
+    - Sector 0: file header (magic, version, sector size).
+    - Sectors 1-2: offset table, one entry_t per chunk in the region: the first sector
+      of its payload, and the payload's length in bytes. Offset 0 means "not saved".
+    - Everything after: chunk payloads, each starting on a sector boundary and padded
+      out to a whole number of sectors.
+
+    Payloads are opaque bytes here; ChunkSerializer decides what goes in them. A chunk
+    rewritten with a payload that still fits its sectors is overwritten in place, so
+    saving a handful of changed chunks only touches those chunks' sectors and their
+    table entries. A payload that has outgrown its sectors moves to the first free run
+    of sectors large enough, or to the end of the file. A payload that moves is written
+    before the table entry pointing at it, so a crash mid-save leaves the old version
+    readable; one overwritten in place is only as safe as the write itself.
+
+    Reads can go through ReadMapped(), which returns a view of the payload straight out
+    of a memory mapping of the file, rather than copying it through stdio. The mapping
+    is created on first use and refreshed after writes. Prefetch() asks the OS to start
+    reading a chunk's pages in before they are needed.
+
+    Not thread safe: callers serialize access to each file.
+
+*/
+
+class RegionFile {
+public:
+
+    // Chunks along x and z of a region
+    constexpr static int32_t REGION_SIZE = 32;
+    constexpr static size_t CHUNKS_PER_REGION = size_t(REGION_SIZE) * REGION_SIZE;
+    constexpr static size_t SECTOR_SIZE = 4096;
+    constexpr static uint32_t VERSION = 1;
+
+    // Opens the region file at "path", creating it if it doesn't exist yet. Throws if it can't be opened, or isn't a region file.
+    RegionFile(const std::string& path);
+    ~RegionFile();
+
+    RegionFile(const RegionFile&) = delete;
+    RegionFile& operator=(const RegionFile&) = delete;
+
+    // Chunk coordinates passed to these are local to the region, each in [0, REGION_SIZE)
+    bool Contains(const glm::ivec2& local) const noexcept;
+    // Reads the chunk's payload into "payload", resizing it to fit. Returns false if the chunk has never been saved.
+    bool Read(const glm::ivec2& local, std::vector<uint8_t>& payload);
+    // Payload of the chunk, viewed in place in the file's memory mapping, or an empty span if the chunk has never been saved.
+    // Stays valid until the next Write() or Erase() on this file.
+    span_t<const uint8_t> ReadMapped(const glm::ivec2& local);
+    // Hints that the chunk will be read soon, so its pages can be read in ahead of time
+    void Prefetch(const glm::ivec2& local);
+    void Write(const glm::ivec2& local, const span_t<const uint8_t> payload);
+    void Erase(const glm::ivec2& local);
+    void Flush();
+
+    const std::string& GetPath() const noexcept;
+    // Size of the file, in sectors
+    size_t SectorCount() const noexcept;
+
+    // Region holding the chunk at "grid_position", rounding towards negative infinity
+    static glm::ivec2 GetRegionCoord(const glm::ivec2& grid_position) noexcept;
+    // Position of the chunk at "grid_position" within its region
+    static glm::ivec2 GetLocalCoord(const glm::ivec2& grid_position) noexcept;
+
+    struct entry_t {
+        uint32_t SectorOffset;
+        uint32_t ByteLength;
+    };
+
+    constexpr static size_t HEADER_BYTES = 16;
+    constexpr static size_t TABLE_OFFSET = SECTOR_SIZE;
+    constexpr static size_t TABLE_SECTORS = (CHUNKS_PER_REGION * sizeof(entry_t) + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    constexpr static size_t FIRST_PAYLOAD_SECTOR = 1 + TABLE_SECTORS;
+
+    static size_t GetSectorsForBytes(const size_t bytes) noexcept;
+    // Slot of the chunk at "local" in the offset table
+    static size_t GetTableIndex(const glm::ivec2& local) noexcept;
+
+private:
+
+    void create();
+    void readTable();
+    void writeEntry(const size_t idx);
+    // First sector of a free run of "count" sectors, growing the file if no free run is long enough
+    uint32_t allocateSectors(const size_t count);
+    void markSectors(const uint32_t first, const size_t count, const bool used);
+    void seek(const uint64_t offset);
+    // Maps the file if it isn't yet, or again if writes have made it outgrow the mapping
+    void updateMapping();
+
+    std::string path;
+    std::FILE* file{ nullptr };
+    std::vector<entry_t> entries;
+    std::vector<bool> usedSectors;
+    MappedFile mapping;
+    // Set by writes: stdio buffers have to be flushed before they are visible through the mapping
+    bool mappingStale{ true };
+
+};
+
+#endif //!HEPHAESTUS_ENGINE_REGION_FILE_HPP
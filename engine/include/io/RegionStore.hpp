@@ -0,0 +1,92 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_REGION_STORE_HPP
+#define HEPHAESTUS_ENGINE_REGION_STORE_HPP
+#include "RegionFile.hpp"
+#include "objects/Chunk.hpp"
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include "glm/gtx/hash.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+
+    RegionStore
+
+    Saves and loads chunks of a world kept in a directory of region files, one per region
+    named "r.<x>.<z>.hrg". Region files are opened as chunks in them are first accessed,
+    and kept open until the store is destroyed. Reading a chunk from a region with no
+    file yet doesn't create one. Chunks are loaded straight from the region file's
+    memory mapping, without an intermediate copy of their payload.
+
+    Given a TerrainBaseline, chunks are saved as deltas against the terrain the generator
+    produces for them, and loaded by regenerating that terrain and then patching it. A
+    delta saved against one GeneratorVersion can't be applied to another version's output:
+    such chunks load as Incompatible, and are never overwritten, so the edits in them
+    survive until a matching generator comes back.
+
+*/
+
+enum class ChunkLoadStatus : uint8_t {
+    NotSaved,
+    Loaded,
+    // Saved as a delta against terrain from a different generator version
+    Incompatible,
+    // The saved payload can't be decoded. Nothing in it can be recovered, so it may be overwritten.
+    Corrupt,
+    // Reading the region file failed, e.g. it couldn't be opened or mapped. The saved copy may well be intact, so it
+    // mustn't be overwritten. Only reported by ChunkIOService: RegionStore::LoadChunk() throws instead.
+    Failed
+};
+
+// Regenerates chunks' terrain from the world seed, for saving chunks as deltas against it
+struct TerrainBaseline {
+    // Has to change whenever the generator's output for a given chunk does, e.g. TerrainGenerator::GetVersion()
+    uint32_t GeneratorVersion{ 0 };
+    // Fills chunk.Blocks with the generated terrain at chunk.GridPosition. Called from whichever thread uses the store.
+    std::function<void(ChunkComponent& chunk)> Generate;
+};
+
+class RegionStore {
+public:
+
+    // Chunks are saved whole if "baseline" has no Generate function
+    RegionStore(const std::string& directory, TerrainBaseline baseline = TerrainBaseline());
+
+    // Loads the blocks of the chunk at chunk.GridPosition. Unless it returns Loaded, chunk.Blocks are untouched, or
+    // for Corrupt payloads, unspecified. Throws if the region file can't be read.
+    ChunkLoadStatus LoadChunk(ChunkComponent& chunk);
+    // Returns false, writing nothing, if the saved copy of the chunk is Incompatible
+    bool SaveChunk(const ChunkComponent& chunk);
+    // Hints that the chunk at "grid_position" will be loaded soon, so its data can be read in ahead of time
+    void PrefetchChunk(const glm::ivec2& grid_position);
+    void Flush();
+
+    const std::string& GetDirectory() const noexcept;
+    // Payload bytes read and written since the store was created
+    uint64_t BytesRead() const noexcept;
+    uint64_t BytesWritten() const noexcept;
+
+private:
+
+    // True if "payload" is a delta this store can't regenerate the baseline of
+    bool incompatible(const span_t<const uint8_t> payload) const;
+    // nullptr if the file doesn't exist and "create" is false
+    RegionFile* getRegion(const glm::ivec2& region_coord, const bool create);
+
+    std::string directory;
+    std::unordered_map<glm::ivec2, std::unique_ptr<RegionFile>> regions;
+    std::vector<uint8_t> payload;
+    TerrainBaseline baseline;
+    // Regenerated terrain of the chunk being saved
+    ChunkComponent baselineChunk;
+    uint64_t bytesRead{ 0 };
+    uint64_t bytesWritten{ 0 };
+
+};
+
+#endif //!HEPHAESTUS_ENGINE_REGION_STORE_HPP
@@ -2,6 +2,7 @@
 #ifndef HEPHAESTUS_ENGINE_BLOCK_HPP
 #define HEPHAESTUS_ENGINE_BLOCK_HPP
 #include "common/Constants.hpp"
+#include "common/BlockTypes.hpp"
 
 // Range of potential rotations a block can experience.
 enum class BlockRotation : uint8_t {
@@ -14,10 +15,18 @@ enum class BlockRotation : uint8_t {
 };
 
 struct BlockComponent {
-    uint16_t Type;
-    BlockRotation Rotation;
+    uint16_t Type{ static_cast<uint16_t>(BlockTypes::AIR) };
+    BlockRotation Rotation{ BlockRotation::R0 };
     // mostly added as padding
-    uint8_t Parameters;
+    uint8_t Parameters{ 0 };
 };
 
+inline bool operator==(const BlockComponent& lhs, const BlockComponent& rhs) noexcept {
+    return lhs.Type == rhs.Type && lhs.Rotation == rhs.Rotation && lhs.Parameters == rhs.Parameters;
+}
+
+inline bool operator!=(const BlockComponent& lhs, const BlockComponent& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
 #endif // !BLOCK_H
@@ -2,13 +2,12 @@
 #ifndef HEPHAESTUS_ENGINE_CHUNK_HPP
 #define HEPHAESTUS_ENGINE_CHUNK_HPP
 #include "common/Constants.hpp"
-#include "ecs/entity.hpp"
+#include "ChunkBlockStorage.hpp"
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
-#include <array>
 
 struct ChunkComponent {
-    std::array<ecs::entity_t, BLOCKS_PER_CHUNK> Blocks;
+    ChunkBlockStorage<> Blocks;
     glm::vec3 WorldPosition;
     glm::ivec2 GridPosition;
 };
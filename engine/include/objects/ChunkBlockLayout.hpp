@@ -0,0 +1,86 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_BLOCK_LAYOUT_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_BLOCK_LAYOUT_HPP
+#include "common/Constants.hpp"
+#include "util/CommonUtil.hpp"
+#include "util/Morton.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+
+    Chunk block layouts
+
+    Policies deciding the order blocks of a chunk are stored in, used as the Layout
+    parameter of ChunkBlockStorage. Each maps block (x, y, z) to a unique index in
+    [0, BLOCKS_PER_CHUNK):
+
+    - LinearChunkLayout: GetBlockIndex(), y-major then x then z. Whole layers and
+      z columns are contiguous, which suits meshing and slice-by-slice work.
+    - MortonChunkLayout: Z-order curve over each 32^3 cube of the chunk, cubes stacked
+      along y. Neighbours along every axis tend to share cache lines, which suits
+      lighting floods and other 3D neighbourhood walks.
+    - TiledChunkLayout: 4^3 micro-bricks of 64 blocks, themselves in linear order. A
+      cheaper compromise between the two.
+
+    tests/layout_benchmark times meshing, lighting and column scans under each.
+
+    Interleaving all seven bits of y with x and z would need 21 bits of index for a
+    17 bit chunk, so the Morton layout only interleaves the low five bits of y and
+    uses the rest to pick the cube.
+
+*/
+
+static_assert(CHUNK_SIZE == 32 && CHUNK_SIZE_Y % 32 == 0, "Chunk layouts assume 32 block wide chunks, a multiple of 32 blocks tall");
+
+struct LinearChunkLayout {
+    // Whether each layer of blocks occupies one contiguous range, starting at GetIndex(0, y, 0)
+    constexpr static bool CONTIGUOUS_LAYERS = true;
+
+    constexpr static size_t GetIndex(const uint32_t x, const uint32_t y, const uint32_t z) noexcept {
+        return GetBlockIndex(x, y, z);
+    }
+};
+
+namespace detail {
+
+    constexpr std::array<uint16_t, 32> buildSpreadTable() noexcept {
+        std::array<uint16_t, 32> result{};
+        for (uint32_t i = 0; i < 32; ++i) {
+            result[i] = static_cast<uint16_t>(morton_encode<morton_method_t::MagicBits>(0u, 0u, i));
+        }
+        return result;
+    }
+
+    constexpr static std::array<uint16_t, 32> MORTON_SPREAD_5 = buildSpreadTable();
+
+}
+
+struct MortonChunkLayout {
+    constexpr static bool CONTIGUOUS_LAYERS = false;
+
+    // z in the lowest bit of each triple, then x, then y: same priority as the linear layout
+    constexpr static size_t GetIndex(const uint32_t x, const uint32_t y, const uint32_t z) noexcept {
+        return (size_t(y >> 5) << 15) | (size_t(detail::MORTON_SPREAD_5[y & 31]) << 2) | (size_t(detail::MORTON_SPREAD_5[x]) << 1) |
+            size_t(detail::MORTON_SPREAD_5[z]);
+    }
+};
+
+struct TiledChunkLayout {
+    constexpr static bool CONTIGUOUS_LAYERS = false;
+
+    constexpr static uint32_t TILE_SIZE = 4;
+    constexpr static uint32_t TILES_X = CHUNK_SIZE / TILE_SIZE;
+    constexpr static uint32_t TILES_Z = CHUNK_SIZE / TILE_SIZE;
+
+    constexpr static size_t GetIndex(const uint32_t x, const uint32_t y, const uint32_t z) noexcept {
+        const size_t tile = (size_t(y >> 2) * TILES_X + (x >> 2)) * TILES_Z + (z >> 2);
+        return (tile << 6) | ((y & 3u) << 4) | ((x & 3u) << 2) | (z & 3u);
+    }
+};
+
+// Layout used by ChunkComponent
+using DefaultChunkLayout = LinearChunkLayout;
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_BLOCK_LAYOUT_HPP
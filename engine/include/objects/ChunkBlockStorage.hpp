@@ -0,0 +1,123 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_BLOCK_STORAGE_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_BLOCK_STORAGE_HPP
+#include "common/Constants.hpp"
+#include "common/BlockTypes.hpp"
+#include "Block.hpp"
+#include "ChunkBlockLayout.hpp"
+#include <cstdint>
+#include <vector>
+
+/*
+
+    ChunkBlockStorage
+
+    Palette-compressed blocks of a single chunk. Each distinct BlockComponent in the
+    chunk gets one palette entry, and each block stores the index of its entry in as
+    few bits as the palette needs: 0 (the whole chunk is one block), 1, 2, 4, 8 or 16.
+    Widths divide 64, so an index never straddles two words and get/set are a shift
+    and a mask. A chunk of up to 16 block types takes 64KiB, where an entity per block
+    took over 512KiB of ids alone, plus the registry's per-entity storage.
+
+    Palette entries are reference counted: an entry no block uses anymore is reused
+    by the next new block, so the palette only grows when it really has to. Compact()
+    drops unused entries and narrows the indices again, e.g. after a large edit.
+
+    Blocks are stored in the order given by the Layout policy (see ChunkBlockLayout.hpp).
+    Single-index accessors take an index in that order, i.e. Layout::GetIndex(x, y, z);
+    everything taking coordinates, and CopyTypes(), is the same for every layout.
+
+*/
+
+template<typename Layout = DefaultChunkLayout>
+class ChunkBlockStorage {
+public:
+
+    using layout_type = Layout;
+
+    ChunkBlockStorage(const BlockComponent& fill = BlockComponent());
+
+    const BlockComponent& GetBlock(const size_t idx) const noexcept;
+    const BlockComponent& GetBlock(const size_t x, const size_t y, const size_t z) const noexcept;
+    BlockType GetType(const size_t x, const size_t y, const size_t z) const noexcept;
+
+    void SetBlock(const size_t idx, const BlockComponent& block);
+    void SetBlock(const size_t x, const size_t y, const size_t z, const BlockComponent& block);
+    // Sets every block in the chunk, releasing the palette and indices.
+    void Fill(const BlockComponent& block);
+
+    // Decodes the types of layers y_begin to y_end - 1 into "dest", which holds BLOCKS_PER_CHUNK entries laid out as per
+    // GetBlockIndex() whatever our own layout is. Only those layers are written.
+    void CopyTypes(BlockType* dest, const uint32_t y_begin = 0, const uint32_t y_end = CHUNK_SIZE_Y) const noexcept;
+
+    // Copies out the palette entries in use, and the entry of each block in GetBlockIndex() order into "entries_out",
+    // which holds BLOCKS_PER_CHUNK values. For saving chunks: ImportEntries() restores them.
+    void ExportEntries(std::vector<BlockComponent>& palette_out, uint16_t* entries_out) const;
+    // Replaces every block in the chunk. "entries" holds BLOCKS_PER_CHUNK indices into "palette", in GetBlockIndex() order.
+    void ImportEntries(const BlockComponent* palette, const size_t palette_size, const uint16_t* entries);
+
+    // Drops unused palette entries, and shrinks indices to the narrowest width that still fits.
+    void Compact();
+
+    uint32_t BitsPerBlock() const noexcept;
+    // Number of palette entries in use
+    size_t PaletteSize() const noexcept;
+    // Bytes of heap memory used by the palette and indices
+    size_t MemoryUsage() const noexcept;
+
+    // Each block's index is at most 16 bits
+    constexpr static size_t MAX_PALETTE_SIZE = 1u << 16u;
+
+private:
+
+    uint32_t getIndex(const size_t idx) const noexcept;
+    void setIndex(const size_t idx, const uint32_t value) noexcept;
+    // Decodes layers y_begin to y_end - 1 into "dest" in GetBlockIndex() order, mapping each palette index through "lookup"
+    template<typename Lookup>
+    void copyEntries(uint16_t* dest, const uint32_t y_begin, const uint32_t y_end, const Lookup& lookup) const noexcept;
+    uint32_t findOrAddEntry(const BlockComponent& block);
+    // Re-packs every index at "bits" wide, mapping old palette index i to remap[i] (or keeping it, if remap is empty)
+    void repack(const uint32_t bits, const std::vector<uint32_t>& remap);
+
+    std::vector<BlockComponent> palette;
+    // Number of blocks using each palette entry. Zero for entries free to reuse.
+    std::vector<uint32_t> refCounts;
+    std::vector<uint32_t> freeEntries;
+    std::vector<uint64_t> indices;
+    uint32_t bitsPerBlock{ 0 };
+    // log2 of the number of indices in each word of "indices"
+    uint32_t indicesPerWordShift{ 0 };
+
+};
+
+template<typename Layout>
+inline uint32_t ChunkBlockStorage<Layout>::getIndex(const size_t idx) const noexcept {
+    if (bitsPerBlock == 0) {
+        return 0;
+    }
+    const size_t word = idx >> indicesPerWordShift;
+    const uint32_t shift = static_cast<uint32_t>(idx & ((size_t(1) << indicesPerWordShift) - 1)) * bitsPerBlock;
+    return static_cast<uint32_t>(indices[word] >> shift) & ((1u << bitsPerBlock) - 1u);
+}
+
+template<typename Layout>
+inline const BlockComponent& ChunkBlockStorage<Layout>::GetBlock(const size_t idx) const noexcept {
+    return palette[getIndex(idx)];
+}
+
+template<typename Layout>
+inline const BlockComponent& ChunkBlockStorage<Layout>::GetBlock(const size_t x, const size_t y, const size_t z) const noexcept {
+    return palette[getIndex(Layout::GetIndex(uint32_t(x), uint32_t(y), uint32_t(z)))];
+}
+
+template<typename Layout>
+inline BlockType ChunkBlockStorage<Layout>::GetType(const size_t x, const size_t y, const size_t z) const noexcept {
+    return palette[getIndex(Layout::GetIndex(uint32_t(x), uint32_t(y), uint32_t(z)))].Type;
+}
+
+// Instantiated in ChunkBlockStorage.cpp
+extern template class ChunkBlockStorage<LinearChunkLayout>;
+extern template class ChunkBlockStorage<MortonChunkLayout>;
+extern template class ChunkBlockStorage<TiledChunkLayout>;
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_BLOCK_STORAGE_HPP
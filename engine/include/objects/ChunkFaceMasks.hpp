@@ -0,0 +1,104 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_FACE_MASKS_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_FACE_MASKS_HPP
+#include "common/Constants.hpp"
+#include "common/BlockTypes.hpp"
+#include <array>
+#include <cstdint>
+
+/*
+
+    Bitmask face culling
+
+    A row of blocks along the x axis is exactly CHUNK_SIZE == 32 blocks long, so the
+    opacity of a whole row fits in one uint32_t: bit x of row (y, z) is set when the
+    block at (x, y, z) is solid. The visible faces of all 32 blocks in a row can then
+    be found with a couple of shifts and ANDs against the neighbouring rows, instead
+    of probing six neighbours per block.
+
+*/
+
+static_assert(CHUNK_SIZE == 32, "Face masks store one row of blocks per uint32_t, and require CHUNK_SIZE == 32");
+
+static constexpr size_t ROWS_PER_CHUNK = CHUNK_SIZE_Y * CHUNK_SIZE;
+
+// Rows are stored y-major, so the 32 rows of a single y level are contiguous.
+static constexpr inline size_t GetRowIndex(const size_t& y, const size_t& z) {
+    return (y * CHUNK_SIZE) + z;
+}
+
+struct ChunkOpacityMask {
+    std::array<uint32_t, ROWS_PER_CHUNK> Rows;
+};
+
+struct ChunkFaceMasks {
+    // Indexed by BlockFace, then by row. Bit x is set if the block at (x, y, z) has that face visible.
+    std::array<std::array<uint32_t, ROWS_PER_CHUNK>, 6> Faces;
+};
+
+// Opacity of the blocks just outside the four horizontal sides of a chunk, taken from its neighbours.
+// Defaults to solid, which is also what a neighbour that isn't loaded counts as.
+struct ChunkBorderMasks {
+    ChunkBorderMasks() noexcept {
+        PosX.fill(0xFFFFFFFFu);
+        NegX.fill(0xFFFFFFFFu);
+        PosZ.fill(0xFFFFFFFFu);
+        NegZ.fill(0xFFFFFFFFu);
+    }
+
+    // Bit z of PosX[y] is set if block (0, y, z) of the +x neighbour is solid. NegX is the same, for
+    // block (CHUNK_SIZE - 1, y, z) of the -x neighbour.
+    std::array<uint32_t, CHUNK_SIZE_Y> PosX;
+    std::array<uint32_t, CHUNK_SIZE_Y> NegX;
+    // Bit x of PosZ[y] is set if block (x, y, 0) of the +z neighbour is solid. NegZ is the same, for
+    // block (x, y, CHUNK_SIZE - 1) of the -z neighbour.
+    std::array<uint32_t, CHUNK_SIZE_Y> PosZ;
+    std::array<uint32_t, CHUNK_SIZE_Y> NegZ;
+};
+
+// Ambient occlusion of a face, 2 bits per corner with corner c in bits 2c and 2c + 1. Corners are in the order
+// of packed_vertex::corner_offsets. Each level runs from 0 (fully occluded) to 3 (unoccluded).
+using FaceAO = uint8_t;
+static constexpr FaceAO FACE_AO_UNOCCLUDED = 0xFF;
+
+static constexpr inline uint32_t GetCornerAO(const FaceAO ao, const uint32_t corner) {
+    return (ao >> (corner * 2)) & 0x3;
+}
+
+// Quads are split along the diagonal from corner 0 to corner 2. AO is interpolated across each triangle,
+// so when corners 1 and 3 are brighter the split should run between them instead, or the shading of
+// identical geometry changes with the quad's orientation.
+static constexpr inline bool ShouldFlipQuad(const FaceAO ao) {
+    return GetCornerAO(ao, 0) + GetCornerAO(ao, 2) < GetCornerAO(ao, 1) + GetCornerAO(ao, 3);
+}
+
+// "blocks" is a dense array of BLOCKS_PER_CHUNK block types, laid out as per GetBlockIndex(). Only the rows
+// of layers y_begin to y_end - 1 are written.
+void BuildOpacityMask(const BlockType* blocks, ChunkOpacityMask& result, const uint32_t y_begin = 0, const uint32_t y_end = CHUNK_SIZE_Y) noexcept;
+// Faces on the x and z sides of the chunk are culled against "borders". Above and below the chunk counts
+// as solid. Uses AVX2 when the compiler targets it, and an equivalent scalar path otherwise. Only layers
+// y_begin to y_end - 1 are written, which reads the opacity of one more layer either side of them.
+void BuildFaceMasks(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, ChunkFaceMasks& result,
+    const uint32_t y_begin = 0, const uint32_t y_end = CHUNK_SIZE_Y) noexcept;
+// The scalar path of BuildFaceMasks(), always compiled in so the AVX2 path can be tested against it
+void BuildFaceMasksScalar(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, ChunkFaceMasks& result,
+    const uint32_t y_begin = 0, const uint32_t y_end = CHUNK_SIZE_Y) noexcept;
+
+// Opacity rows around one row (y, z) of a face mask, widened to hold the x borders. Every face in that row
+// looks out onto the same rows, so loading them once makes AO for each face a few shifts and a table lookup.
+struct FaceAORow {
+    BlockFace Face;
+    // For left and right faces, bit x + Shift of a row lies in front of block x's face
+    uint32_t Shift;
+    std::array<uint64_t, 9> Rows;
+};
+
+void LoadFaceAORow(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, const uint32_t y, const uint32_t z, const BlockFace face, FaceAORow& result) noexcept;
+// AO for the face of block (x, y, z), from the blocks in the layer that face looks out onto. A corner's level drops
+// by one for each solid block among its two edge neighbours and the diagonal between them, and is 0 if both edge
+// neighbours are solid. Blocks above/below the chunk and in diagonally adjacent chunks count as air.
+FaceAO ComputeFaceAO(const FaceAORow& row, const uint32_t x) noexcept;
+// Same as above, for a single face
+FaceAO ComputeFaceAO(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, const uint32_t x, const uint32_t y, const uint32_t z, const BlockFace face) noexcept;
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_FACE_MASKS_HPP
@@ -0,0 +1,149 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_GENERATION_JOBS_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_GENERATION_JOBS_HPP
+#include "Chunk.hpp"
+#include "generation/TerrainGenerator.hpp"
+#include "util/mpsc_queue.hpp"
+#include "glm/vec2.hpp"
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include "glm/gtx/hash.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+
+    ChunkGenerationJobSystem
+
+    Generates chunk terrain on a pool of worker threads, so chunks coming into view
+    never hold up the frame.
+
+    Submitted chunks wait on the main thread until Schedule(), which ranks them by
+    distance from the camera, favouring chunks in the direction it's looking, and hands
+    the most urgent out to the workers. Only a couple of jobs per worker are handed out
+    at once, so a camera that moves on re-ranks everything that hasn't started yet.
+    Each worker has its own queue, and steals from the others' once its own runs dry.
+
+    Cancelling a chunk (e.g. one that left view) drops it if it hasn't started, and
+    otherwise discards its result. Finished chunks come back through DrainCompleted(),
+    which stops handing them out once the frame's time budget is spent: the rest wait
+    for the next frame.
+
+*/
+
+class ChunkGenerationJobSystem {
+    ChunkGenerationJobSystem(const ChunkGenerationJobSystem&) = delete;
+    ChunkGenerationJobSystem& operator=(const ChunkGenerationJobSystem&) = delete;
+public:
+
+    // "generator" is shared with the workers, so must be safe to call concurrently (TerrainGenerator::Generate() is)
+    ChunkGenerationJobSystem(std::shared_ptr<const terrain::TerrainGenerator> generator, const size_t num_workers = std::thread::hardware_concurrency());
+    ~ChunkGenerationJobSystem();
+
+    // Call from the main thread. Does nothing if the chunk is already waiting on, or being, generated.
+    void Submit(const glm::ivec2& grid_position);
+    // Call from the main thread. The chunk won't be handed out by DrainCompleted(), unless it's submitted again.
+    void Cancel(const glm::ivec2& grid_position);
+    // Call once per frame, from the main thread. "view_direction" is along (x, z), and may be zero for no preference.
+    void Schedule(const glm::ivec2& camera_chunk_pos, const glm::vec2& view_direction);
+
+    // Call once per frame, from the main thread. Invokes "fn(const glm::ivec2& grid_position, ChunkComponent& chunk)" for
+    // finished chunks until "budget_ms" has passed, always handing out at least one. Returns the number handed out.
+    template<typename Fn>
+    size_t DrainCompleted(Fn&& fn, const double budget_ms);
+
+    // Chunks submitted and not yet handed out or cancelled
+    size_t PendingJobs() const noexcept;
+    size_t NumWorkers() const noexcept;
+
+private:
+
+    struct generationJob {
+        glm::ivec2 GridPosition;
+        uint64_t JobID;
+        std::atomic<bool> Cancelled{ false };
+    };
+
+    struct completedJob {
+        glm::ivec2 GridPosition;
+        uint64_t JobID;
+        ChunkComponent Chunk;
+    };
+
+    struct workerQueue {
+        std::mutex Mutex;
+        std::deque<std::shared_ptr<generationJob>> Jobs;
+    };
+
+    void workerFunction(const size_t worker_idx);
+    // Front of the worker's own queue, else the back of another's
+    std::shared_ptr<generationJob> takeJob(const size_t worker_idx);
+    // True if "job_id" is still the latest job for the chunk at "grid_position". Main thread only.
+    bool isCurrent(const glm::ivec2& grid_position, const uint64_t job_id) const;
+
+    std::shared_ptr<const terrain::TerrainGenerator> generator;
+    // Fixed before any worker starts: workers can't read "workers" while it's still being filled in
+    size_t numWorkers;
+    // Jobs handed out at once, across all workers
+    size_t maxDispatched;
+
+    std::unique_ptr<workerQueue[]> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable cVar;
+    // Jobs sitting in worker queues
+    std::atomic<size_t> available{ 0 };
+    std::atomic<bool> shutdown{ false };
+
+    mpsc_queue_t<completedJob> completed;
+    // Only accessed from the main thread. Latest job for each chunk not yet handed out or cancelled.
+    std::unordered_map<glm::ivec2, uint64_t> currentJobs;
+    // Submitted, waiting on Schedule(). May hold cancelled jobs, dropped at the next Schedule().
+    std::vector<std::pair<glm::ivec2, uint64_t>> waiting;
+    // Handed to a worker, not finished
+    std::unordered_map<glm::ivec2, std::shared_ptr<generationJob>> dispatched;
+    // Finished, waiting on the frame budget
+    std::deque<completedJob> finished;
+    size_t nextWorker{ 0 };
+    uint64_t nextJobID{ 0 };
+
+};
+
+template<typename Fn>
+inline size_t ChunkGenerationJobSystem::DrainCompleted(Fn&& fn, const double budget_ms) {
+    completed.consume_all([this](completedJob&& job) {
+        auto iter = dispatched.find(job.GridPosition);
+        if (iter != dispatched.end() && iter->second->JobID == job.JobID) {
+            dispatched.erase(iter);
+        }
+        finished.emplace_back(std::move(job));
+    });
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    size_t num_drained = 0;
+    while (!finished.empty()) {
+        if (num_drained != 0 && std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= budget_ms) {
+            break;
+        }
+        completedJob job = std::move(finished.front());
+        finished.pop_front();
+        // Cancelled, or superseded by a later Submit(), after it was handed out
+        if (!isCurrent(job.GridPosition, job.JobID)) {
+            continue;
+        }
+        currentJobs.erase(job.GridPosition);
+        fn(static_cast<const glm::ivec2&>(job.GridPosition), job.Chunk);
+        ++num_drained;
+    }
+    return num_drained;
+}
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_GENERATION_JOBS_HPP
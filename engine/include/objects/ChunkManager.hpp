@@ -2,15 +2,27 @@
 #ifndef HEPHAESTUS_ENGINE_CHUNK_MANAGER_HPP
 #define HEPHAESTUS_ENGINE_CHUNK_MANAGER_HPP
 #include "Chunk.hpp"
+#include "ChunkGenerationJobs.hpp"
+#include "ChunkMeshingJobs.hpp"
+#include "io/ChunkIOService.hpp"
 #include "glm/vec3.hpp"
 #include "glm/vec2.hpp"
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include "glm/gtx/hash.hpp"
 #include <unordered_map>
+#include <unordered_set>
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 class ChunkManager {
 public:
 
-	ChunkManager(const size_t& init_view_radius);
+	// Chunks are saved to, and loaded from, region files in "save_directory", on a background I/O thread
+	ChunkManager(const size_t& init_view_radius, const std::string& save_directory = "world");
 	~ChunkManager();
 
 	ecs::entity_t CreateChunk(const glm::ivec2& grid_position);
@@ -22,16 +34,74 @@ public:
 	void SetRenderDistance(const size_t & render_distance);
 	size_t GetRenderDistance() const noexcept;
 
-	void Update(const glm::vec3& update_position);
-	// Cleans up inactive chunks in "pruneChunks" by compressing and then saving their data.
+	// "view_direction" decides which chunks get generated first, among those equally close. May be zero.
+	void Update(const glm::vec3& update_position, const glm::vec3& view_direction = glm::vec3(0.0f));
+	// Cleans up inactive chunks in "pruneChunks" by queueing them to be saved, then destroying them. Doesn't wait on the
+	// disk: chunks that don't fit in the I/O queue stay in "pruneChunks" until the next call. A chunk coming back into view
+	// before it's been pruned is moved back into the world as it is, edits and all.
 	void Prune();
+	// Called once per Update() with the state of the chunk I/O queue
+	void SetIOStatsCallback(std::function<void(const ChunkIOStats&)> callback);
+	// Time each Update() may spend moving newly generated chunks into the world. At least one is moved in per frame.
+	void SetGenerationBudget(const double& budget_ms);
+
+	// Loaded chunks bordering "grid_position". Missing neighbours are left as INVALID_ENTITY.
+	ChunkNeighbors GetNeighbors(const glm::ivec2& grid_position) const;
+	// True for chunks whose saved copy can't be used: saved against a different generator version, or in a region file
+	// that couldn't be read (both are counted in ChunkIOStats). They hold freshly generated terrain, and are never saved
+	// so the copy on disk keeps its edits. Edits to them are lost when they leave view, so check before editing.
+	bool IsReadOnly(const glm::ivec2& grid_position) const;
+	// Queues the whole chunk at "grid_position" to be re-meshed during the next Update()
+	void MarkForRemesh(const glm::ivec2& grid_position);
+	// Call after changing the block at "block" (in chunk-local coordinates) of the chunk at "grid_position". Only the mesh
+	// sections around the block get re-meshed, in that chunk and in any neighbour the block borders. Throws
+	// std::out_of_range if "block" isn't inside a chunk.
+	void MarkBlockChanged(const glm::ivec2& grid_position, const glm::ivec3& block);
 
 private:
 
+	// Faces on a chunk's border are culled against its neighbours, so a newly loaded chunk
+	// also invalidates the meshes of the loaded chunks around it.
+	void onChunkLoaded(const glm::ivec2& grid_position);
+	// Moves chunks loaded by the I/O thread into their entities, and queues the rest to be generated. Chunks whose saved
+	// copy can't be used are generated too, but as read-only placeholders.
+	void applyLoadedChunks();
+	// Moves generated chunks into their entities, within the generation budget.
+	void applyGeneratedChunks();
+	// Submits queued chunks for meshing, and moves finished meshes into the registry.
+	void updateMeshes();
+	// While the camera keeps moving the same way, asks the I/O thread to read in the chunks that will come into view next
+	void prefetchAhead(const glm::ivec2& camera_chunk_pos);
+
 	// Radius, in chunks, to render
 	size_t renderRadius;
 	// Main container of chunk data, map allows for searching based on the chunks position.
 	std::unordered_map<glm::ivec2, ecs::entity_t> chunkMap;
+	// Chunks that have left the render area, waiting on Prune(). Keyed by position, like chunkMap, so a chunk coming back
+	// into view is found here rather than loaded again from a copy on disk that doesn't have its edits yet.
+	std::unordered_map<glm::ivec2, ecs::entity_t> pruneChunks;
+	// Shared with the I/O thread, which regenerates chunks' terrain to save them as deltas against it
+	std::shared_ptr<terrain::TerrainGenerator> terrainGenerator;
+	std::unique_ptr<ChunkIOService> chunkIO;
+	// Loads requested but not yet applied, per position. Only the latest load of a position is applied.
+	std::unordered_map<glm::ivec2, uint32_t> loadingChunks;
+	// Chunks whose load hasn't been applied yet. They're still placeholders, not worth saving.
+	std::unordered_set<ecs::entity_t> loadingEntities;
+	glm::ivec2 lastCameraChunk{ 0, 0 };
+	// Direction, as -1, 0 or 1 along each axis, of the camera's last move into a new chunk
+	glm::ivec2 lastMoveDirection{ 0, 0 };
+	// Chunks whose blocks or neighbours changed since they were last meshed
+	std::unordered_set<glm::ivec2> remeshChunks;
+	std::unique_ptr<ChunkGenerationJobSystem> generationJobs;
+	// Chunks waiting on their terrain. Like loading chunks, they're placeholders: dropped rather than saved when pruned.
+	std::unordered_set<ecs::entity_t> generatingChunks;
+	// Chunks whose saved copy was saved against a different generator version, or couldn't be read. See IsReadOnly().
+	std::unordered_set<ecs::entity_t> readOnlyChunks;
+	double generationBudgetMs{ 2.0 };
+	std::unique_ptr<ChunkMeshingJobSystem> meshingJobs;
+	// Sections covered by each chunk's meshing job in flight (empty for the whole chunk). A newer job for the same chunk
+	// supersedes it, so has to include them.
+	std::unordered_map<ecs::entity_t, std::vector<uint32_t>> meshingSections;
 
 };
 
@@ -3,12 +3,69 @@
 #define H_ENGINE_CHUNK_MESH_HPP
 #include "common/Constants.hpp"
 #include "Block.hpp"
+#include "ChunkFaceMasks.hpp"
+#include "PackedChunkVertex.hpp"
+#include "ChunkMeshArena.hpp"
 #include "ecs/entity.hpp"
+#include "util/span.hpp"
 #include "glm/vec3.hpp"
 #include <vulkan/vulkan.h>
+#include <chrono>
 #include <vector>
 
 struct VulkanResource;
+struct ChunkMeshData;
+
+enum class MeshingMode : uint8_t {
+    NAIVE, // One quad per visible block face
+    GREEDY, // Coplanar faces sharing a texture are merged into maximal rectangles, per slice
+};
+
+enum class ChunkVertexFormat : uint8_t {
+    FULL, // ChunkMeshComponent::vertex_t, 40 bytes
+    PACKED, // packed_chunk_vertex_t, 8 bytes
+};
+
+enum class ChunkIndexMode : uint8_t {
+    PER_CHUNK, // Indices are generated into ChunkMeshComponent::Indices
+    SHARED_QUADS, // No per-chunk indices: draw with the shared QuadIndexPattern buffer
+};
+
+// Returned by GenerateMesh so that meshing modes can be compared on identical chunks
+struct MeshingStats {
+    size_t VertexCount{ 0 };
+    size_t IndexCount{ 0 };
+    // Size of the vertex and index data, in bytes
+    size_t VertexDataSize{ 0 };
+    size_t IndexDataSize{ 0 };
+    // Arena space reserved for the output, from the upper bound on its size
+    size_t ReservedDataSize{ 0 };
+    double MeshingTimeMs{ 0.0 };
+};
+
+// Entities of the chunks bordering a chunk along x and z. INVALID_ENTITY if that neighbour isn't loaded.
+struct ChunkNeighbors {
+    ecs::entity_t PosX{ ecs::INVALID_ENTITY };
+    ecs::entity_t NegX{ ecs::INVALID_ENTITY };
+    ecs::entity_t PosZ{ ecs::INVALID_ENTITY };
+    ecs::entity_t NegZ{ ecs::INVALID_ENTITY };
+};
+
+// Chunk meshes are split into vertical sections of this many layers, so that an edit only has to re-mesh the
+// sections around it. Must divide CHUNK_SIZE_Y.
+constexpr static uint32_t DEFAULT_MESH_SECTION_HEIGHT = 16;
+
+// Immutable copy of everything needed to mesh a chunk, so that meshing can run without touching the registry
+struct ChunkMeshSnapshot {
+    // BLOCKS_PER_CHUNK block types, laid out as per GetBlockIndex(). Only the layers needed to mesh "Sections"
+    // are copied, the rest are left as air.
+    std::vector<BlockType> Blocks;
+    // Opacity of the neighbouring chunks' border slices, for the same layers as "Blocks"
+    ChunkBorderMasks Borders;
+    uint32_t SectionHeight{ DEFAULT_MESH_SECTION_HEIGHT };
+    // Sections to mesh. Empty to mesh the whole chunk.
+    std::vector<uint32_t> Sections;
+};
 
 struct ChunkMeshComponent {
 
@@ -16,39 +73,154 @@ struct ChunkMeshComponent {
         glm::vec3 Position;
         glm::vec3 Normal;
         glm::vec3 UV;
+        // Ambient occlusion level, 0 (fully occluded) to 3
+        float AO;
+    };
+
+    // Meshing settings, used by ChunkMeshingSystem::GenerateMesh/UpdateMesh. See ChunkMeshData.
+    ChunkVertexFormat VertexFormat{ ChunkVertexFormat::FULL };
+    ChunkIndexMode IndexMode{ ChunkIndexMode::PER_CHUNK };
+    bool AmbientOcclusion{ true };
+
+    // Vertices and indices are grouped by section, bottom to top, with no gaps between sections.
+    struct section_t {
+        uint32_t FirstVertex{ 0 };
+        uint32_t VertexCount{ 0 };
+        uint32_t FirstIndex{ 0 };
+        uint32_t IndexCount{ 0 };
+        // Set while the section's geometry is out of date, or wasn't part of the last meshing pass
+        bool Dirty{ true };
     };
 
+    // Set by meshing, from the snapshot used
+    uint32_t SectionHeight{ DEFAULT_MESH_SECTION_HEIGHT };
+    std::vector<section_t> Sections;
     std::vector<uint32_t> Indices;
     std::vector<vertex_t> Vertices;
+    std::vector<packed_chunk_vertex_t> PackedVertices;
     VulkanResource* VBO{ nullptr };
     VulkanResource* EBO{ nullptr };
 
+    size_t VertexCount() const noexcept;
+    size_t VertexDataSize() const noexcept;
+    uint32_t QuadCount() const noexcept;
+
+    // Marks the sections whose geometry depends on a block at height "y": the one holding it, plus the one above
+    // or below when "y" is on a section's edge. Call on neighbouring chunks too when the block is on the chunk's border.
+    // Throws std::out_of_range if "y" is past the top of the chunk.
+    void MarkBlockDirty(const uint32_t y);
+    void MarkAllDirty();
+    // Returns the indices of the dirty sections, and clears their flags.
+    std::vector<uint32_t> TakeDirtySections();
+    // Copies meshing output in, replacing the current geometry and sections. Reuses the existing storage where it's large enough.
+    void Assign(const ChunkMeshData& src);
+    // Replaces this mesh's geometry for each section "src" holds an up-to-date copy of. "src" must come from
+    // meshing a snapshot of the same chunk, with the same section height and vertex/index settings.
+    void MergeSections(const ChunkMeshData& src);
+
     constexpr static VkVertexInputBindingDescription binding{ 0, sizeof(vertex_t), VK_VERTEX_INPUT_RATE_VERTEX };
-    constexpr static VkVertexInputAttributeDescription attributes[3]{ 
+    constexpr static VkVertexInputAttributeDescription attributes[4]{ 
         VkVertexInputAttributeDescription{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
         VkVertexInputAttributeDescription{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, sizeof(glm::vec3) },
-        VkVertexInputAttributeDescription{ 2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 2 * sizeof(glm::vec3) }
+        VkVertexInputAttributeDescription{ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, 2 * sizeof(glm::vec3) },
+        VkVertexInputAttributeDescription{ 3, 0, VK_FORMAT_R32_SFLOAT, 3 * sizeof(glm::vec3) }
     };
 
+};
+
+// Output of a meshing pass. Points into the ChunkMeshArena it was meshed with, so it is only valid until that arena is reset.
+struct ChunkMeshData {
+    // Set before meshing: decides which of Vertices or PackedVertices GenerateMesh fills.
+    ChunkVertexFormat VertexFormat{ ChunkVertexFormat::FULL };
+    // Also set before meshing: with SHARED_QUADS, Indices stays empty.
+    ChunkIndexMode IndexMode{ ChunkIndexMode::PER_CHUNK };
+    // Also set before meshing: bakes per-vertex ambient occlusion. When off, every corner is unoccluded.
+    bool AmbientOcclusion{ true };
+
+    uint32_t SectionHeight{ DEFAULT_MESH_SECTION_HEIGHT };
+    span_t<ChunkMeshComponent::section_t> Sections;
+    // Sized to what was written, which is at most the upper bound reserved in the arena
+    span_t<uint32_t> Indices;
+    span_t<ChunkMeshComponent::vertex_t> Vertices;
+    span_t<packed_chunk_vertex_t> PackedVertices;
+
+    size_t VertexCount() const noexcept;
+    size_t VertexDataSize() const noexcept;
+
 private:
     friend class ChunkMeshingSystem;
-    uint32_t addVertex(vertex_t&& v);
+    uint32_t addVertex(const ChunkMeshComponent::vertex_t& v) noexcept;
+    uint32_t addVertex(const packed_chunk_vertex_t v) noexcept;
+    void addQuadIndices(const uint32_t i0, const uint32_t i1, const uint32_t i2, const uint32_t i3) noexcept;
+    // Vertex number of the first vertex in the spans, while filling a single section's range
+    uint32_t vertexBase{ 0 };
+};
+
+// Output of the counting pass of two-pass meshing, see ChunkMeshingSystem::PlanMesh(). Holds the culling masks of the
+// sections being meshed, and each section's output range is reserved in the ChunkMeshData it was planned for. Sections
+// can then be filled in any order, from any number of threads. Points into the arena it was planned with.
+struct ChunkMeshPlan {
+    const ChunkMeshSnapshot* Snapshot{ nullptr };
+    MeshingMode Mode{ MeshingMode::NAIVE };
+    const ChunkOpacityMask* Opacity{ nullptr };
+    const ChunkFaceMasks* Faces{ nullptr };
+    // Indices of the sections to fill, in ascending order
+    span_t<uint32_t> Sections;
+    // Visible faces in all of those sections, which bounds the number of quads meshing them produces
+    size_t ReservedQuads{ 0 };
+    std::chrono::high_resolution_clock::time_point Start;
 };
 
 class ChunkMeshingSystem {
 public:
 
-    static void GenerateMesh(const ecs::entity_t ent, ChunkMeshComponent& mesh);
+    // Clears and regenerates the mesh for the chunk entity "ent". Meshes into an arena owned by the calling thread, then
+    // copies the result into "mesh".
+    static MeshingStats GenerateMesh(const ecs::entity_t ent, ChunkMeshComponent& mesh, const MeshingMode mode = MeshingMode::NAIVE);
+    // Re-meshes only the dirty sections of "mesh", or all of it if it hasn't been meshed yet.
+    static MeshingStats UpdateMesh(const ecs::entity_t ent, const ChunkNeighbors& neighbors, ChunkMeshComponent& mesh, const MeshingMode mode = MeshingMode::NAIVE);
+    // Copies the blocks of "ent" and the border slices of its neighbours out of the registry, for the layers that
+    // "sections" (or the whole chunk, if empty) need. Must be called from the thread that owns the registry.
+    static ChunkMeshSnapshot CreateSnapshot(const ecs::entity_t ent, const ChunkNeighbors& neighbors = ChunkNeighbors(),
+        const std::vector<uint32_t>& sections = std::vector<uint32_t>(), const uint32_t section_height = DEFAULT_MESH_SECTION_HEIGHT);
+    // Same as above, into "snapshot", reusing the storage it already has
+    static void CreateSnapshot(const ecs::entity_t ent, const ChunkNeighbors& neighbors, const std::vector<uint32_t>& sections, const uint32_t section_height,
+        ChunkMeshSnapshot& snapshot);
+    // Meshes the snapshot's sections into "result", allocating the output from "arena" in one go. Sections left out stay
+    // empty and dirty, so the result can be passed to ChunkMeshComponent::MergeSections(). Only reads from "snapshot",
+    // so it is safe to call from any thread as long as each thread has its own arena. Same as PlanMesh(), then
+    // FillSection() for each planned section, then FinishMesh().
+    static MeshingStats GenerateMesh(const ChunkMeshSnapshot& snapshot, ChunkMeshArena& arena, ChunkMeshData& result, const MeshingMode mode = MeshingMode::NAIVE);
+
+    // Two-pass meshing, for splitting one chunk across threads. PlanMesh() counts the visible faces of each section
+    // with popcounts and reserves the whole output from "arena" at once, so the final size is known before any vertex
+    // is written. "snapshot" has to outlive the plan.
+    static ChunkMeshPlan PlanMesh(const ChunkMeshSnapshot& snapshot, ChunkMeshArena& arena, ChunkMeshData& result, const MeshingMode mode = MeshingMode::NAIVE);
+    // Meshes one of the plan's sections into its reserved range. Different sections may be filled concurrently.
+    static void FillSection(const ChunkMeshPlan& plan, const uint32_t section, ChunkMeshData& result);
+    // Call once every planned section has been filled. Closes up the space greedy meshing didn't use, and sizes
+    // the spans of "result" to the data written.
+    static MeshingStats FinishMesh(const ChunkMeshPlan& plan, ChunkMeshData& result);
 
 private:
-    // void setBlockLightingData(const uint32_t& x, const uint32_t& y, const uint32_t& z, std::array<BlockType, 27>& neighbor_blocks, std::array<float, 27>& neighbor_shades) const;
-
-    static void getFaceVertices(const BlockFace& face, ChunkMeshComponent::vertex_t& v0, ChunkMeshComponent::vertex_t& v1, ChunkMeshComponent::vertex_t& v2, ChunkMeshComponent::vertex_t& v3,
-        const size_t& texture_idx);
-    static void createBlockFace(const BlockFace& face, const size_t& uv_idx, const glm::vec3 & pos, ChunkMeshComponent& cmp);
-    static void createCube(const size_t & x, const size_t & y, const size_t & z, const bool & front_face, const bool & right_face, const bool & top_face, 
-        const bool & left_face,  const bool & bottom_face, const bool & back_face, const size_t & uv_idx, ChunkMeshComponent& cmp);
-        
+
+    // Culling and AO data shared by the meshing passes
+    struct meshingMasks {
+        const ChunkOpacityMask& Opacity;
+        const ChunkBorderMasks& Borders;
+        const ChunkFaceMasks& Faces;
+        // Scratch space for one slice of greedy meshing, all zeroes between uses
+        uint32_t* SliceMask;
+    };
+
+    static void createBlockFace(const BlockFace& face, const size_t& uv_idx, const glm::vec3 & pos, const FaceAO ao, ChunkMeshData& cmp);
+    // Same as above, but the face is stretched to cover "extent" blocks along the two axes of the face's plane
+    static void createMergedFace(const BlockFace& face, const size_t& uv_idx, const glm::vec3& pos, const glm::ivec3& extent, const FaceAO ao, ChunkMeshData& cmp);
+    static void createPackedFace(const BlockFace& face, const size_t& uv_idx, const glm::ivec3& block, const glm::ivec3& extent, const FaceAO ao, ChunkMeshData& cmp);
+    // Both only mesh layers y_begin to y_end - 1
+    static void generateNaive(const BlockType* blocks, const meshingMasks& masks, const uint32_t y_begin, const uint32_t y_end, ChunkMeshData& mesh);
+    static void generateGreedy(const BlockType* blocks, const meshingMasks& masks, const uint32_t y_begin, const uint32_t y_end, ChunkMeshData& mesh);
+
 };
 
 #endif //!H_ENGINE_CHUNK_MESH_HPP
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_MESH_ARENA_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_MESH_ARENA_HPP
+#include "util/span.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+
+    ChunkMeshArena
+
+    Bump allocator for meshing output. Allocating is just moving an offset forward,
+    and nothing is freed individually: Reset() releases everything at once but keeps
+    the blocks, so once an arena has grown to cover its workload it never touches
+    the heap again. Each meshing thread owns one, so no locking is needed.
+
+*/
+
+class ChunkMeshArena {
+    ChunkMeshArena(const ChunkMeshArena&) = delete;
+    ChunkMeshArena& operator=(const ChunkMeshArena&) = delete;
+public:
+
+    // Enough for the upper bound of a fairly busy chunk, in full-size vertices
+    constexpr static size_t DEFAULT_BLOCK_SIZE = 8u * 1024u * 1024u;
+
+    ChunkMeshArena(const size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    // Uninitialized storage for "count" objects of type T. Only valid until the next Reset().
+    template<typename T>
+    span_t<T> Allocate(const size_t count);
+
+    // Invalidates every allocation made since the last reset.
+    void Reset() noexcept;
+
+    size_t BytesUsed() const noexcept;
+    size_t Capacity() const noexcept;
+
+private:
+
+    void* allocateBytes(const size_t size, const size_t alignment);
+
+    struct block_t {
+        std::unique_ptr<std::byte[]> Data;
+        size_t Size;
+    };
+
+    size_t blockSize;
+    std::vector<block_t> blocks;
+    size_t currentBlock{ 0 };
+    size_t offset{ 0 };
+    // Bytes used by the blocks before the current one
+    size_t usedBefore{ 0 };
+
+};
+
+template<typename T>
+inline span_t<T> ChunkMeshArena::Allocate(const size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value, "Arena allocations are never destroyed, so T must be trivially destructible");
+    if (count == 0) {
+        return span_t<T>();
+    }
+    return span_t<T>(static_cast<T*>(allocateBytes(sizeof(T) * count, alignof(T))), count);
+}
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_MESH_ARENA_HPP
@@ -0,0 +1,151 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_CHUNK_MESHING_JOBS_HPP
+#define HEPHAESTUS_ENGINE_CHUNK_MESHING_JOBS_HPP
+#include "ChunkMesh.hpp"
+#include "util/mpsc_queue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+
+    ChunkMeshingJobSystem
+
+    Meshes chunks on a pool of worker threads. Jobs are submitted as immutable
+    ChunkMeshSnapshots (taken on the main thread, via ChunkMeshingSystem::CreateSnapshot),
+    so workers never touch the registry. Finished meshes are pushed onto a lock-free
+    completion queue, which the main thread drains once per frame.
+
+    Chunks are meshed in two passes (see ChunkMeshingSystem::PlanMesh): the worker
+    that picks up a job counts its faces and reserves the output, then its sections
+    are shared out to any idle workers, which fill them in parallel.
+
+    Each worker plans meshes into its own ChunkMeshArena. Completed meshes point into that
+    arena until drained, so a worker only resets it once everything it produced has
+    been consumed. Jobs are pooled, and go through intrusive queues, and snapshots taken
+    with AcquireSnapshot() reuse the block storage of drained jobs. Once the pools and
+    arenas have grown to the load, submitting, meshing and draining don't touch the heap.
+
+*/
+
+class ChunkMeshingJobSystem {
+    ChunkMeshingJobSystem(const ChunkMeshingJobSystem&) = delete;
+    ChunkMeshingJobSystem& operator=(const ChunkMeshingJobSystem&) = delete;
+public:
+
+    ChunkMeshingJobSystem(const size_t num_workers = std::thread::hardware_concurrency(), const MeshingMode mode = MeshingMode::NAIVE,
+        const ChunkVertexFormat vertex_format = ChunkVertexFormat::FULL, const ChunkIndexMode index_mode = ChunkIndexMode::PER_CHUNK,
+        const bool ambient_occlusion = true);
+    ~ChunkMeshingJobSystem();
+
+    // Call from the main thread. Returns a snapshot holding the storage of one from an already drained job, if there
+    // is one, to be filled in by ChunkMeshingSystem::CreateSnapshot() and submitted.
+    ChunkMeshSnapshot AcquireSnapshot();
+    // Call from the main thread. Re-submitting a chunk supersedes any job for it that hasn't been drained yet.
+    void Submit(const ecs::entity_t chunk, ChunkMeshSnapshot&& snapshot);
+
+    // Call once per frame, from the main thread. Invokes "fn(const ecs::entity_t chunk, const ChunkMeshData& mesh, const MeshingStats& stats)"
+    // for every mesh completed since the last call, skipping results superseded by a later Submit(). "mesh" is only valid for the duration
+    // of the call, so copy it out (ChunkMeshComponent::Assign() or MergeSections()). Returns the number of meshes handed out.
+    template<typename Fn>
+    size_t DrainCompleted(Fn&& fn);
+
+    // Blocks until every submitted job has finished meshing.
+    void WaitIdle();
+
+    size_t PendingJobs() const noexcept;
+    size_t NumWorkers() const noexcept;
+
+private:
+
+    struct workerArena {
+        ChunkMeshArena Arena;
+        // Completed meshes in this arena that haven't been drained yet
+        std::atomic<size_t> Outstanding{ 0 };
+    };
+
+    // One submitted chunk, from Submit() until it's drained. Once planned, its sections are claimed one at a time by
+    // whichever workers are free. Pooled: tasks are reused for later jobs rather than freed.
+    struct sectionTask {
+        ecs::entity_t Chunk;
+        ChunkMeshSnapshot Snapshot;
+        ChunkMeshData Mesh;
+        ChunkMeshPlan Plan;
+        MeshingStats Stats;
+        workerArena* Source{ nullptr };
+        // Index into Plan.Sections of the next section to claim
+        std::atomic<size_t> NextSection{ 0 };
+        // Sections not yet filled. Whoever fills the last one finishes the mesh.
+        std::atomic<size_t> Remaining{ 0 };
+        // Set by a later Submit() for the same chunk. Main thread only.
+        bool Superseded{ false };
+        // Workers holding the task, plus one until it's drained. Returned to the pool at zero. Guarded by queueMutex.
+        size_t References{ 0 };
+        // Link in whichever of the job queue, the completion queue and the free list the task is on
+        sectionTask* Next{ nullptr };
+    };
+
+    void workerFunction(const size_t worker_idx);
+    void fillSections(sectionTask& task);
+    void finishTask(sectionTask& task);
+    // Drops tasks with no sections left to claim. Call with queueMutex held.
+    void pruneSectionTasks();
+    // Drops a reference to "task", returning it to the pool if it was the last. Call with queueMutex held.
+    void releaseTask(sectionTask* task);
+
+    MeshingMode mode;
+    ChunkVertexFormat vertexFormat;
+    ChunkIndexMode indexMode;
+    bool ambientOcclusion;
+
+    // Submitted jobs not yet picked up, oldest first, linked through sectionTask::Next
+    sectionTask* jobsHead{ nullptr };
+    sectionTask* jobsTail{ nullptr };
+    // Planned tasks with sections left to claim. Holds no more than one task per worker, so it's reserved up front.
+    std::vector<sectionTask*> sectionTasks;
+    // Every task ever created, and the ones not in use
+    std::vector<std::unique_ptr<sectionTask>> taskStorage;
+    sectionTask* freeTasks{ nullptr };
+    std::mutex queueMutex;
+    std::condition_variable cVar;
+    std::condition_variable idleCVar;
+    std::atomic<bool> shutdown{ false };
+    std::atomic<size_t> pendingJobs{ 0 };
+    std::vector<std::thread> workers;
+    std::unique_ptr<workerArena[]> arenas;
+
+    intrusive_mpsc_queue_t<sectionTask, &sectionTask::Next> completed;
+    // Only accessed from the main thread. Latest job submitted for each chunk that hasn't been drained yet: searched
+    // linearly, as it only holds the jobs in flight.
+    std::vector<sectionTask*> latestJobs;
+    // Snapshots of drained jobs, for AcquireSnapshot(). Main thread only.
+    std::vector<ChunkMeshSnapshot> spareSnapshots;
+
+};
+
+template<typename Fn>
+inline size_t ChunkMeshingJobSystem::DrainCompleted(Fn&& fn) {
+    size_t num_drained = 0;
+    completed.consume_all([&](sectionTask* task) {
+        if (!task->Superseded) {
+            auto iter = std::find(latestJobs.begin(), latestJobs.end(), task);
+            *iter = latestJobs.back();
+            latestJobs.pop_back();
+            fn(task->Chunk, static_cast<const ChunkMeshData&>(task->Mesh), static_cast<const MeshingStats&>(task->Stats));
+            ++num_drained;
+        }
+        // Otherwise it was superseded by a newer submission for the same chunk. Either way we're done with
+        // this mesh, and its worker may reuse the memory once it has no others waiting.
+        task->Source->Outstanding.fetch_sub(1, std::memory_order_release);
+        spareSnapshots.emplace_back(std::move(task->Snapshot));
+        std::lock_guard<std::mutex> guard(queueMutex);
+        releaseTask(task);
+    });
+    return num_drained;
+}
+
+#endif //!HEPHAESTUS_ENGINE_CHUNK_MESHING_JOBS_HPP
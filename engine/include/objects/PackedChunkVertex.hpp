@@ -0,0 +1,138 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_PACKED_CHUNK_VERTEX_HPP
+#define HEPHAESTUS_ENGINE_PACKED_CHUNK_VERTEX_HPP
+#include "common/Constants.hpp"
+#include "glm/vec3.hpp"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+/*
+
+    Packed 8-byte chunk vertex
+
+    Positions inside a 32x128x32 chunk, the six axis-aligned normals and a texture
+    layer all fit in 64 bits. Instead of the corner position, we store the block the
+    face belongs to plus which face and which corner of that face this is: the shader
+    (assets/shaders/terrain/block_packed.vert) rebuilds the position, normal and UV,
+    exactly as DecodePackedChunkVertex() does below.
+
+    Data0:
+        bits  0-4   block x
+        bits  5-11  block y
+        bits 12-16  block z
+        bits 17-19  face (BlockFace)
+        bits 20-21  corner of the face, see packed_vertex::corner_offsets
+        bits 22-23  ambient occlusion (0 = fully occluded, 3 = unoccluded)
+        bits 24-27  block light
+        bits 28-31  sunlight
+
+    Data1:
+        bits  0-11  texture array layer
+        bits 12-18  quad width - 1, along the direction UV.x increases in
+        bits 19-25  quad height - 1, along the direction UV.y increases in
+        bits 26-31  unused
+
+    Quad width/height allow merged (greedy) faces to use the same format: both are 1
+    for single block faces.
+
+*/
+
+struct packed_chunk_vertex_t {
+    uint32_t Data0;
+    uint32_t Data1;
+
+    constexpr static VkVertexInputBindingDescription binding{ 0, sizeof(uint32_t) * 2, VK_VERTEX_INPUT_RATE_VERTEX };
+    constexpr static VkVertexInputAttributeDescription attributes[1]{
+        VkVertexInputAttributeDescription{ 0, 0, VK_FORMAT_R32G32_UINT, 0 }
+    };
+};
+
+static_assert(sizeof(packed_chunk_vertex_t) == 8, "Packed chunk vertex must be 8 bytes");
+static_assert(CHUNK_SIZE <= 32 && CHUNK_SIZE_Y <= 128, "Chunk dimensions no longer fit the packed vertex position fields");
+
+namespace packed_vertex {
+
+    constexpr static uint32_t X_SHIFT = 0, Y_SHIFT = 5, Z_SHIFT = 12, FACE_SHIFT = 17, CORNER_SHIFT = 20, AO_SHIFT = 22, LIGHT_SHIFT = 24, SUNLIGHT_SHIFT = 28;
+    constexpr static uint32_t LAYER_SHIFT = 0, WIDTH_SHIFT = 12, HEIGHT_SHIFT = 19;
+
+    constexpr static uint32_t X_MASK = 0x1F, Y_MASK = 0x7F, Z_MASK = 0x1F, FACE_MASK = 0x7, CORNER_MASK = 0x3, AO_MASK = 0x3, LIGHT_MASK = 0xF;
+    constexpr static uint32_t LAYER_MASK = 0xFFF, EXTENT_MASK = 0x7F;
+
+    // For each face and corner: whether that corner lies on the positive side of the block along x, y and z.
+    // Indexed by BlockFace. Unpacked vertex_t faces are built from the same tables, in ChunkMesh.cpp.
+    constexpr static uint8_t corner_offsets[6][4][3]{
+        { { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } }, // front
+        { { 1, 0, 1 }, { 1, 0, 0 }, { 1, 1, 0 }, { 1, 1, 1 } }, // right
+        { { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 }, { 0, 1, 0 } }, // top
+        { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 } }, // left
+        { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 } }, // bottom
+        { { 1, 0, 0 }, { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 } }, // back
+    };
+
+    constexpr static int normals[6][3]{
+        { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 }, { -1, 0, 0 }, { 0, -1, 0 }, { 0, 0, -1 }
+    };
+
+    constexpr static uint8_t corner_uvs[4][2]{ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+
+    // Axis that UV.x (element 0) and UV.y (element 1) increase along, for each face
+    constexpr static uint8_t uv_axes[6][2]{ { 0, 1 }, { 2, 1 }, { 0, 2 }, { 2, 1 }, { 0, 2 }, { 0, 1 } };
+
+}
+
+struct decoded_chunk_vertex_t {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec3 UV;
+    uint32_t AO;
+    uint32_t Light;
+    uint32_t Sunlight;
+};
+
+// "block" is the position of the block the face belongs to, inside the chunk. For merged faces, the block with
+// the smallest coordinates. "width" and "height" are in blocks, along the UV.x and UV.y directions of the face.
+inline packed_chunk_vertex_t PackChunkVertex(const glm::ivec3& block, const BlockFace face, const uint32_t corner, const uint32_t layer,
+    const uint32_t width = 1, const uint32_t height = 1, const uint32_t ao = 3, const uint32_t light = 0, const uint32_t sunlight = SUNLIGHT_LEVEL) noexcept {
+    using namespace packed_vertex;
+    packed_chunk_vertex_t result;
+    result.Data0 = ((static_cast<uint32_t>(block.x) & X_MASK) << X_SHIFT) | ((static_cast<uint32_t>(block.y) & Y_MASK) << Y_SHIFT) |
+        ((static_cast<uint32_t>(block.z) & Z_MASK) << Z_SHIFT) | ((static_cast<uint32_t>(face) & FACE_MASK) << FACE_SHIFT) |
+        ((corner & CORNER_MASK) << CORNER_SHIFT) | ((ao & AO_MASK) << AO_SHIFT) | ((light & LIGHT_MASK) << LIGHT_SHIFT) |
+        ((sunlight & LIGHT_MASK) << SUNLIGHT_SHIFT);
+    result.Data1 = ((layer & LAYER_MASK) << LAYER_SHIFT) | (((width - 1) & EXTENT_MASK) << WIDTH_SHIFT) | (((height - 1) & EXTENT_MASK) << HEIGHT_SHIFT);
+    return result;
+}
+
+// CPU reference for the unpacking done in block_packed.vert. Produces the same position, normal and UV that
+// the unpacked vertex_t path would for the same face.
+inline decoded_chunk_vertex_t DecodePackedChunkVertex(const packed_chunk_vertex_t& v) noexcept {
+    using namespace packed_vertex;
+    const uint32_t face = (v.Data0 >> FACE_SHIFT) & FACE_MASK;
+    const uint32_t corner = (v.Data0 >> CORNER_SHIFT) & CORNER_MASK;
+    const int block[3]{
+        static_cast<int>((v.Data0 >> X_SHIFT) & X_MASK),
+        static_cast<int>((v.Data0 >> Y_SHIFT) & Y_MASK),
+        static_cast<int>((v.Data0 >> Z_SHIFT) & Z_MASK)
+    };
+
+    int extent[3]{ 1, 1, 1 };
+    const int width = static_cast<int>((v.Data1 >> WIDTH_SHIFT) & EXTENT_MASK) + 1;
+    const int height = static_cast<int>((v.Data1 >> HEIGHT_SHIFT) & EXTENT_MASK) + 1;
+    extent[uv_axes[face][0]] = width;
+    extent[uv_axes[face][1]] = height;
+
+    decoded_chunk_vertex_t result;
+    for (int a = 0; a < 3; ++a) {
+        // Block centers are at integer coordinates, so block faces lie on the half-integers.
+        result.Position[a] = static_cast<float>(block[a]) - 0.50f + static_cast<float>(corner_offsets[face][corner][a] * extent[a]);
+        result.Normal[a] = static_cast<float>(normals[face][a]);
+    }
+    result.UV = glm::vec3(static_cast<float>(corner_uvs[corner][0] * width), static_cast<float>(corner_uvs[corner][1] * height),
+        static_cast<float>((v.Data1 >> LAYER_SHIFT) & LAYER_MASK));
+    result.AO = (v.Data0 >> AO_SHIFT) & AO_MASK;
+    result.Light = (v.Data0 >> LIGHT_SHIFT) & LIGHT_MASK;
+    result.Sunlight = (v.Data0 >> SUNLIGHT_SHIFT) & LIGHT_MASK;
+    return result;
+}
+
+#endif //!HEPHAESTUS_ENGINE_PACKED_CHUNK_VERTEX_HPP
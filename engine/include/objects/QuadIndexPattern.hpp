@@ -0,0 +1,49 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_QUAD_INDEX_PATTERN_HPP
+#define HEPHAESTUS_ENGINE_QUAD_INDEX_PATTERN_HPP
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+struct VulkanResource;
+
+/*
+
+    QuadIndexPattern
+
+    Every quad the chunk mesher emits is 4 consecutive vertices, triangulated as
+    0,1,2 / 0,2,3. So instead of each chunk mesh carrying its own index buffer, all
+    chunks share one pre-built buffer holding that pattern repeated for as many quads
+    as 16-bit indices can address. Meshes with more quads than that are drawn in
+    batches, with each batch's vertexOffset pointing at its first vertex.
+
+*/
+
+class QuadIndexPattern {
+public:
+
+    constexpr static uint32_t VERTICES_PER_QUAD = 4;
+    constexpr static uint32_t INDICES_PER_QUAD = 6;
+    // 16384 quads use vertices 0 through 65535: the most a 16-bit index can address
+    constexpr static uint32_t MAX_QUADS_PER_DRAW = 16384;
+    constexpr static VkIndexType INDEX_TYPE = VK_INDEX_TYPE_UINT16;
+
+    struct draw_batch_t {
+        uint32_t IndexCount;
+        int32_t VertexOffset;
+    };
+
+    // Built once, on first use.
+    static const std::vector<uint16_t>& Indices();
+    // Creates the device-local index buffer on first call: requires the ResourceContext to be constructed.
+    static VulkanResource* Buffer();
+    static void Destroy();
+
+    static std::vector<draw_batch_t> GetDrawBatches(const uint32_t quad_count, const uint32_t first_vertex = 0);
+    // Binds the shared index buffer and records the indexed draws for "quad_count" quads, whose vertex
+    // buffer must already be bound.
+    static void RecordDraws(VkCommandBuffer cmd, const uint32_t quad_count, const uint32_t first_vertex = 0);
+
+};
+
+#endif //!HEPHAESTUS_ENGINE_QUAD_INDEX_PATTERN_HPP
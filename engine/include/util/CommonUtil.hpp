@@ -2,6 +2,10 @@
 #ifndef COMMON_UTIL_H
 #define COMMON_UTIL_H
 #include "common/Constants.hpp"
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 // Same as above, with individual positions
 static constexpr inline size_t GetBlockIndex(const size_t& x, const size_t& y, const size_t& z) {
@@ -28,5 +32,24 @@ inline void SetBack4(uint8_t& dest, const int val) {
 	dest = (dest & 0xF0) | val;
 }
 
+// Index of the lowest set bit. Result is undefined if val == 0
+inline uint32_t CountTrailingZeros(const uint32_t val) {
+#ifdef _MSC_VER
+	unsigned long result;
+	_BitScanForward(&result, val);
+	return static_cast<uint32_t>(result);
+#else
+	return static_cast<uint32_t>(__builtin_ctz(val));
+#endif
+}
+
+// Number of set bits in val
+inline uint32_t PopCount(const uint32_t val) {
+#ifdef _MSC_VER
+	return static_cast<uint32_t>(__popcnt(val));
+#else
+	return static_cast<uint32_t>(__builtin_popcount(val));
+#endif
+}
 
 #endif // !COMMON_UTIL_H
@@ -2,46 +2,281 @@
 #ifndef MORTON_CODING_UTILITIES_HPP
 #define MORTON_CODING_UTILITIES_HPP
 #include <cstdint>
-#include <immintrin.h>
+#include <cstddef>
 #include <array>
 #include <type_traits>
 
+/*
+
+    Morton (Z-order) coding of 3D coordinates
+
+    Bits of z go to bits 0, 3, 6... of the code, y to 1, 4, 7... and x to 2, 5, 8...
+    Codes are 32 or 64 bits, holding 10 or 21 bits of each coordinate: higher bits of
+    the inputs are discarded.
+
+    Three implementations, picked with the Method parameter:
+    - Bmi2: _pdep/_pext. Only on x86 builds, and microcoded (hundreds of cycles) on
+      AMD before Zen 3, so it is only worth it on CPUs that do it in hardware.
+    - Lut: table lookups, a byte of each coordinate at a time when encoding and a
+      9 bit group of the code when decoding. Tables are built at compile time.
+    - MagicBits: shifts and masks only.
+    Lut and MagicBits are constexpr. Auto checks once, at runtime, whether pdep and
+    pext are fast on this CPU and uses them if so, otherwise Lut.
+
+*/
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HEPHAESTUS_MORTON_BMI2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC exposes BMI2 intrinsics whatever /arch is set to
+#define HEPHAESTUS_MORTON_TARGET_BMI2
+#else
+#include <cpuid.h>
+#define HEPHAESTUS_MORTON_TARGET_BMI2 __attribute__((target("bmi2")))
+#endif
+#else
+#define HEPHAESTUS_MORTON_BMI2 0
+#endif
+
+enum class morton_method_t : uint8_t {
+    Auto,
+    Bmi2,
+    Lut,
+    MagicBits
+};
+
 namespace detail {
 
     template<typename T>
-    constexpr static T BMI_X_MASK = T(0x9249249249249249);
+    constexpr static T BMI_X_MASK = T(0x4924924924924924);
     template<typename T>
     constexpr static T BMI_Y_MASK = T(0x2492492492492492);
     template<typename T>
-    constexpr static T BMI_Z_MASK = T(0x4924924924924924);
+    constexpr static T BMI_Z_MASK = T(0x9249249249249249);
+
+    template<typename T>
+    constexpr void check_morton_type() noexcept {
+        static_assert(std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>, "Morton coding type must be u32 or u64");
+    }
+
+    // Bits of each coordinate a code of type T holds
+    template<typename T>
+    constexpr static uint32_t MORTON_BITS = std::is_same_v<T, uint32_t> ? 10u : 21u;
+
+    template<typename T>
+    constexpr static T MORTON_COORD_MASK = T((uint64_t(1) << MORTON_BITS<T>) - 1u);
+
+    // Spreads the low 21 bits of "v" out to every third bit
+    constexpr uint64_t morton_spread_magic(uint64_t v) noexcept {
+        v &= 0x1fffffu;
+        v = (v | (v << 32)) & 0x001f00000000ffffull;
+        v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+        v = (v | (v << 8)) & 0x100f00f00f00f00full;
+        v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+        v = (v | (v << 2)) & 0x1249249249249249ull;
+        return v;
+    }
+
+    // Inverse of morton_spread_magic: gathers every third bit of "v", starting at bit 0
+    constexpr uint64_t morton_compact_magic(uint64_t v) noexcept {
+        v &= 0x1249249249249249ull;
+        v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+        v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+        v = (v ^ (v >> 8)) & 0x001f0000ff0000ffull;
+        v = (v ^ (v >> 16)) & 0x001f00000000ffffull;
+        v = (v ^ (v >> 32)) & 0x1fffffu;
+        return v;
+    }
+
+    constexpr std::array<uint32_t, 256> build_morton_spread_table() noexcept {
+        std::array<uint32_t, 256> result{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            result[i] = static_cast<uint32_t>(morton_spread_magic(i));
+        }
+        return result;
+    }
+
+    // Entry "i" holds the three bits of each coordinate in 9 bits of code "i": z in bits 0-2, y in 3-5, x in 6-8
+    constexpr std::array<uint16_t, 512> build_morton_compact_table() noexcept {
+        std::array<uint16_t, 512> result{};
+        for (uint32_t i = 0; i < 512; ++i) {
+            result[i] = static_cast<uint16_t>(morton_compact_magic(i) | (morton_compact_magic(i >> 1) << 3) | (morton_compact_magic(i >> 2) << 6));
+        }
+        return result;
+    }
+
+    constexpr static std::array<uint32_t, 256> MORTON_SPREAD_LUT = build_morton_spread_table();
+    constexpr static std::array<uint16_t, 512> MORTON_COMPACT_LUT = build_morton_compact_table();
+
+    constexpr uint64_t morton_spread_lut(const uint64_t v) noexcept {
+        return uint64_t(MORTON_SPREAD_LUT[v & 0xffu]) | (uint64_t(MORTON_SPREAD_LUT[(v >> 8) & 0xffu]) << 24) |
+            (uint64_t(MORTON_SPREAD_LUT[(v >> 16) & 0x1fu]) << 48);
+    }
+
+#if HEPHAESTUS_MORTON_BMI2
+
+    template<typename T>
+    HEPHAESTUS_MORTON_TARGET_BMI2 T morton_encode_bmi2(const T x, const T y, const T z) noexcept {
+        if constexpr (std::is_same_v<T, uint32_t>) {
+            return _pdep_u32(x, BMI_X_MASK<T>) | _pdep_u32(y, BMI_Y_MASK<T>) | _pdep_u32(z, BMI_Z_MASK<T>);
+        }
+        else {
+            return _pdep_u64(x, BMI_X_MASK<T>) | _pdep_u64(y, BMI_Y_MASK<T>) | _pdep_u64(z, BMI_Z_MASK<T>);
+        }
+    }
+
+    template<typename T>
+    HEPHAESTUS_MORTON_TARGET_BMI2 void morton_decode_bmi2(const T code, T& x, T& y, T& z) noexcept {
+        if constexpr (std::is_same_v<T, uint32_t>) {
+            x = _pext_u32(code, BMI_X_MASK<T>);
+            y = _pext_u32(code, BMI_Y_MASK<T>);
+            z = _pext_u32(code, BMI_Z_MASK<T>);
+        }
+        else {
+            x = _pext_u64(code, BMI_X_MASK<T>);
+            y = _pext_u64(code, BMI_Y_MASK<T>);
+            z = _pext_u64(code, BMI_Z_MASK<T>);
+        }
+    }
+
+    inline void morton_cpuid(int* regs, const int leaf, const int subleaf) noexcept {
+#if defined(_MSC_VER)
+        __cpuidex(regs, leaf, subleaf);
+#else
+        unsigned int a = 0, b = 0, c = 0, d = 0;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        regs[0] = int(a); regs[1] = int(b); regs[2] = int(c); regs[3] = int(d);
+#endif
+    }
+
+    // Whether the CPU has BMI2 and implements pdep/pext in hardware rather than microcode
+    inline bool morton_detect_fast_bmi2() noexcept {
+        int regs[4] = { 0, 0, 0, 0 };
+        morton_cpuid(regs, 0, 0);
+        if (regs[0] < 7) {
+            return false;
+        }
+        const bool is_amd = regs[1] == 0x68747541 && regs[3] == 0x69746e65 && regs[2] == 0x444d4163; // "AuthenticAMD"
+        morton_cpuid(regs, 7, 0);
+        if ((regs[1] & (1 << 8)) == 0) {
+            return false;
+        }
+        if (!is_amd) {
+            return true;
+        }
+        // Zen 3 (family 19h) and later are fast, earlier AMD parts are not
+        morton_cpuid(regs, 1, 0);
+        const uint32_t base_family = (uint32_t(regs[0]) >> 8) & 0xfu;
+        const uint32_t family = base_family == 0xfu ? base_family + ((uint32_t(regs[0]) >> 20) & 0xffu) : base_family;
+        return family >= 0x19u;
+    }
+
+    inline bool morton_fast_bmi2() noexcept {
+        static const bool result = morton_detect_fast_bmi2();
+        return result;
+    }
+
+#endif
+
+    inline morton_method_t morton_resolve_method() noexcept {
+#if HEPHAESTUS_MORTON_BMI2
+        if (morton_fast_bmi2()) {
+            return morton_method_t::Bmi2;
+        }
+#endif
+        return morton_method_t::Lut;
+    }
 
 }
 
-template<typename T>
-static uint32_t morton_encode(const T x, const T y, const T z) {
-    static_assert(std::is_integral_v<T> && std::is_unsigned_v<T>, "Morton encoding type must be unsigned int type! (u32/u64)");
-    if constexpr (std::is_same_v<T, uint32_t>) {
-        return _pdep_u32(z, detail::BMI_X_MASK<T>) | _pdep_u32(y, detail::BMI_Y_MASK<T>) | _pdep_u32(x, detail::BMI_Z_MASK<T>);
+// Lut and MagicBits can be evaluated at compile time, e.g. to build lookup tables
+template<morton_method_t Method = morton_method_t::Auto, typename T>
+constexpr T morton_encode(T x, T y, T z) noexcept {
+    detail::check_morton_type<T>();
+    x &= detail::MORTON_COORD_MASK<T>;
+    y &= detail::MORTON_COORD_MASK<T>;
+    z &= detail::MORTON_COORD_MASK<T>;
+    if constexpr (Method == morton_method_t::Auto) {
+#if HEPHAESTUS_MORTON_BMI2
+        if (detail::morton_fast_bmi2()) {
+            return detail::morton_encode_bmi2<T>(x, y, z);
+        }
+#endif
+        return morton_encode<morton_method_t::Lut>(x, y, z);
+    }
+    else if constexpr (Method == morton_method_t::Bmi2) {
+        static_assert(HEPHAESTUS_MORTON_BMI2 && sizeof(T) != 0, "BMI2 Morton coding is only available on x86");
+#if HEPHAESTUS_MORTON_BMI2
+        return detail::morton_encode_bmi2<T>(x, y, z);
+#endif
     }
-    else if constexpr (std::is_same_v<T, uint64_t>) {
-        return _pdep_u64(z, detail::BMI_X_MASK<T>) | _pdep_u64(y, detail::BMI_Y_MASK<T>) | _pdep_u64(x, detail::BMI_Z_MASK<T>);
+    else if constexpr (Method == morton_method_t::Lut) {
+        return T((detail::morton_spread_lut(x) << 2) | (detail::morton_spread_lut(y) << 1) | detail::morton_spread_lut(z));
+    }
+    else {
+        return T((detail::morton_spread_magic(x) << 2) | (detail::morton_spread_magic(y) << 1) | detail::morton_spread_magic(z));
     }
 }
 
-template<typename T>
-static void morton_decode(const T input_code, T& result_x, T& result_y, T& result_z) {
-    static_assert(std::is_integral_v<T> && std::is_unsigned_v<T>, "Morton decoding type must be unsigned int type! (u32/u64)");
-    if constexpr (std::is_same_v<T, uint32_t>) {
-        result_x = _pext_u32(input_code, detail::BMI_X_MASK<T>);
-        result_y = _pext_u32(input_code, detail::BMI_Y_MASK<T>);
-        result_z = _pext_u32(input_code, detail::BMI_Z_MASK<T>);
+template<morton_method_t Method = morton_method_t::Auto, typename T>
+constexpr void morton_decode(const T input_code, T& result_x, T& result_y, T& result_z) noexcept {
+    detail::check_morton_type<T>();
+    if constexpr (Method == morton_method_t::Auto) {
+#if HEPHAESTUS_MORTON_BMI2
+        if (detail::morton_fast_bmi2()) {
+            detail::morton_decode_bmi2<T>(input_code, result_x, result_y, result_z);
+            return;
+        }
+#endif
+        morton_decode<morton_method_t::Lut>(input_code, result_x, result_y, result_z);
+    }
+    else if constexpr (Method == morton_method_t::Bmi2) {
+        static_assert(HEPHAESTUS_MORTON_BMI2 && sizeof(T) != 0, "BMI2 Morton coding is only available on x86");
+#if HEPHAESTUS_MORTON_BMI2
+        detail::morton_decode_bmi2<T>(input_code, result_x, result_y, result_z);
+#endif
+    }
+    else if constexpr (Method == morton_method_t::Lut) {
+        T x = 0, y = 0, z = 0;
+        for (uint32_t group = 0; group * 9 < sizeof(T) * 8; ++group) {
+            const uint32_t bits = detail::MORTON_COMPACT_LUT[(uint64_t(input_code) >> (group * 9)) & 0x1ffu];
+            z |= T(bits & 7u) << (group * 3);
+            y |= T((bits >> 3) & 7u) << (group * 3);
+            x |= T(bits >> 6) << (group * 3);
+        }
+        result_x = x & detail::MORTON_COORD_MASK<T>;
+        result_y = y & detail::MORTON_COORD_MASK<T>;
+        result_z = z & detail::MORTON_COORD_MASK<T>;
     }
-    else if constexpr (std::is_same_v<T, uint64_t>) {
-        result_x = _pext_u64(input_code, detail::BMI_X_MASK<T>);
-        result_y = _pext_u64(input_code, detail::BMI_Y_MASK<T>);
-        result_z = _pext_u64(input_code, detail::BMI_Z_MASK<T>);
+    else {
+        result_x = T(detail::morton_compact_magic(uint64_t(input_code) >> 2)) & detail::MORTON_COORD_MASK<T>;
+        result_y = T(detail::morton_compact_magic(uint64_t(input_code) >> 1)) & detail::MORTON_COORD_MASK<T>;
+        result_z = T(detail::morton_compact_magic(uint64_t(input_code))) & detail::MORTON_COORD_MASK<T>;
     }
 }
 
+// Encodes "count" coordinates along a row, (x_begin + i, y, z), into "dest". y and z are spread once for the whole
+// row, and Auto picks its method once rather than per coordinate.
+template<morton_method_t Method = morton_method_t::Auto, typename T>
+void morton_encode_row(const T x_begin, const T y, const T z, const size_t count, T* dest) noexcept {
+    detail::check_morton_type<T>();
+    if constexpr (Method == morton_method_t::Auto) {
+#if HEPHAESTUS_MORTON_BMI2
+        if (detail::morton_resolve_method() == morton_method_t::Bmi2) {
+            morton_encode_row<morton_method_t::Bmi2>(x_begin, y, z, count, dest);
+            return;
+        }
+#endif
+        morton_encode_row<morton_method_t::Lut>(x_begin, y, z, count, dest);
+    }
+    else {
+        const T yz = morton_encode<Method>(T(0), y, z);
+        for (size_t i = 0; i < count; ++i) {
+            dest[i] = yz | morton_encode<Method>(T(x_begin + i), T(0), T(0));
+        }
+    }
+}
 
 #endif //!MORTON_CODING_UTILITIES_HPP
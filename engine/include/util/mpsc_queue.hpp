@@ -0,0 +1,123 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_MPSC_QUEUE_HPP
+#define HEPHAESTUS_ENGINE_MPSC_QUEUE_HPP
+#include <atomic>
+#include <utility>
+#include <cstddef>
+
+/*
+    Lock-free multiple-producer, single-consumer queue. Producers push onto an
+    intrusive stack with a CAS loop: the consumer takes the whole stack with one
+    exchange, then reverses it so items come out in the order they were pushed.
+    Suited to handing results from worker threads back to the main thread, which
+    drains everything once per frame.
+*/
+template<typename T>
+class mpsc_queue_t {
+    mpsc_queue_t(const mpsc_queue_t&) = delete;
+    mpsc_queue_t& operator=(const mpsc_queue_t&) = delete;
+
+    struct node_t {
+        T value;
+        node_t* next;
+    };
+
+public:
+
+    mpsc_queue_t() noexcept = default;
+
+    ~mpsc_queue_t() {
+        consume_all([](T&&) {});
+    }
+
+    // Safe to call from any number of threads at once
+    void push(T&& value) {
+        node_t* node = new node_t{ std::move(value), head.load(std::memory_order_relaxed) };
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    bool empty() const noexcept {
+        return head.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // Only one thread may consume at a time. Calls "fn" with each item in FIFO order, returns number consumed.
+    template<typename Fn>
+    size_t consume_all(Fn&& fn) {
+        node_t* list = head.exchange(nullptr, std::memory_order_acquire);
+
+        node_t* reversed = nullptr;
+        while (list != nullptr) {
+            node_t* next = list->next;
+            list->next = reversed;
+            reversed = list;
+            list = next;
+        }
+
+        size_t count = 0;
+        while (reversed != nullptr) {
+            node_t* next = reversed->next;
+            fn(std::move(reversed->value));
+            delete reversed;
+            reversed = next;
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::atomic<node_t*> head{ nullptr };
+};
+
+/*
+    Same queue, but the caller owns the nodes: "T" provides the link, as the member
+    "Next" points to. Pushing never allocates, so items can be pooled and recycled
+    once consumed. An item may only be in the queue once at a time.
+*/
+template<typename T, T* T::*Next>
+class intrusive_mpsc_queue_t {
+    intrusive_mpsc_queue_t(const intrusive_mpsc_queue_t&) = delete;
+    intrusive_mpsc_queue_t& operator=(const intrusive_mpsc_queue_t&) = delete;
+public:
+
+    intrusive_mpsc_queue_t() noexcept = default;
+
+    // Safe to call from any number of threads at once
+    void push(T* item) noexcept {
+        item->*Next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(item->*Next, item, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    bool empty() const noexcept {
+        return head.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // Only one thread may consume at a time. Calls "fn" with each item in FIFO order, returns number consumed.
+    // Items are unlinked before "fn" sees them, so "fn" may push them again or hand them back to a pool.
+    template<typename Fn>
+    size_t consume_all(Fn&& fn) {
+        T* list = head.exchange(nullptr, std::memory_order_acquire);
+
+        T* reversed = nullptr;
+        while (list != nullptr) {
+            T* next = list->*Next;
+            list->*Next = reversed;
+            reversed = list;
+            list = next;
+        }
+
+        size_t count = 0;
+        while (reversed != nullptr) {
+            T* next = reversed->*Next;
+            reversed->*Next = nullptr;
+            fn(reversed);
+            reversed = next;
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::atomic<T*> head{ nullptr };
+};
+
+#endif //!HEPHAESTUS_ENGINE_MPSC_QUEUE_HPP
@@ -1,116 +1,231 @@
 #pragma once
 #ifndef RUN_LENGTH_ENCODING_HPP
 #define RUN_LENGTH_ENCODING_HPP
-#include <vector>
+#include "util/span.hpp"
+#include "util/CommonUtil.hpp"
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#if defined(__AVX2__)
+#define HEPHAESTUS_RLE_SIMD 2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEPHAESTUS_RLE_SIMD 1
+#include <immintrin.h>
+#else
+#define HEPHAESTUS_RLE_SIMD 0
+#endif
+
+/*
+
+    Run-length encoding of unsigned integers, e.g. chunk block data.
+
+    Encoded data is a sequence of tokens, each one T wide. A token with REPETITION_BIT
+    set is followed by a single value, repeated (token & COUNTER_MASK) times. Without
+    it, the token is followed by that many values to copy as-is. Counts are never 0.
+    Only runs of MIN_RUN or more values are encoded as repetitions, as shorter ones
+    take as much space either way, so output is never more than max_encoded_size().
+
+    Both directions work on caller-provided buffers. Run boundaries are found with
+    vector compares, a register of values at a time, on x86 for T up to 32 bits.
+
+*/
 
 template<typename T>
 struct rle_system {
 
     static_assert(std::is_integral_v<T> && std::is_unsigned_v<T>, "Type used for run-length encoding must be an unsigned int type!");
 
-    using data_container = std::vector<T>;
-    using data_iterator = data_container::const_iterator;
+    constexpr static T COUNTER_MASK = std::numeric_limits<T>::max() / T(2);
+    constexpr static T REPETITION_BIT = T(~COUNTER_MASK);
+    constexpr static size_t MIN_RUN = 3;
 
-    constexpr static T COUNTER_BITS = std::numeric_limits<T>::max() / T(2);
-    constexpr static T REPETITION_BIT = ~COUNTER_BITS;
+    // Upper bound on the encoded size of "count" values, in T
+    constexpr static size_t max_encoded_size(const size_t count) noexcept {
+        return count + count / COUNTER_MASK + 2;
+    }
 
-    constexpr static auto count_repetitions(data_iterator iter, data_iterator end) noexcept {
-        const auto first = iter;
+    // Encodes "input" into "output", which must hold at least max_encoded_size(input.size()) values. Returns the
+    // number of values written.
+    static size_t encode(const span_t<const T> input, const span_t<T> output) {
+        if (output.size() < max_encoded_size(input.size())) {
+            throw std::length_error("Output buffer too small for run-length encoding");
+        }
 
-        do {
-            ++iter;
-        } while (iter != end && *iter == *first);
+        const T* in = input.data();
+        const size_t size = input.size();
+        T* out = output.data();
+        size_t read = 0;
+        size_t written = 0;
+        while (read < size) {
+            const size_t max_count = std::min<size_t>(size - read, COUNTER_MASK);
+            const size_t run = count_repetitions(in + read, max_count);
+            if (run >= MIN_RUN) {
+                out[written++] = T(REPETITION_BIT | T(run));
+                out[written++] = in[read];
+                read += run;
+                continue;
+            }
 
-        return std::distance(first, iter);
+            // No run starts here, so this is at least one value long
+            const size_t uniques = count_uniques(in + read, max_count);
+            out[written++] = T(uniques);
+            std::memcpy(out + written, in + read, uniques * sizeof(T));
+            written += uniques;
+            read += uniques;
+        }
+        return written;
     }
 
-    constexpr static auto count_uniques(data_iterator iter, data_iterator end) noexcept {
-        const auto first = iter;
+    // Decodes "input" into "output", returning the number of values written. Throws if "input" is malformed or would
+    // decode to more than output.size() values.
+    static size_t decode(const span_t<const T> input, const span_t<T> output) {
+        const T* in = input.data();
+        const size_t size = input.size();
+        T* out = output.data();
+        size_t read = 0;
+        size_t written = 0;
+        while (read < size) {
+            const T token = in[read++];
+            const size_t count = token & COUNTER_MASK;
+            const bool repeat = (token & REPETITION_BIT) != 0;
+            if (count == 0 || read + (repeat ? 1 : count) > size) {
+                throw std::runtime_error("Malformed run-length encoded data");
+            }
+            if (count > output.size() - written) {
+                throw std::length_error("Run-length encoded data decodes to more values than the output buffer holds");
+            }
 
-        while ((iter + 1) != end && *(iter + 1) != *iter) {
-            ++iter;
+            if (repeat) {
+                std::fill_n(out + written, count, in[read]);
+                ++read;
+            }
+            else {
+                std::memcpy(out + written, in + read, count * sizeof(T));
+                read += count;
+            }
+            written += count;
         }
-
-        return std::distance(first, iter);
+        return written;
     }
 
-    // This divides our N-items into chunks of the maximum size permitted by counter bits
-    template<typename SplitFn>
-    static auto split(std::ptrdiff_t num, SplitFn&& t) {
-        static_assert(std::is_invocable_v<decltype(t), T>, "Second parameter to split() must be an invocable object, e.g a lambda function!");
-        do {
-            // Our count is the smallest of these two. This is only okay because we always know 
-            // our count can never be negative. At worst, it'll be 0 or 1.
-            T count = std::min(static_cast<T>(num), COUNTER_BITS);
-            t(count);
-            num -= count;
-        } while (num > 0);
+    // Length of the run of values equal to data[0], at most "max_count"
+    static size_t count_repetitions(const T* data, const size_t max_count) noexcept {
+        const T value = data[0];
+        size_t i = 1;
+#if HEPHAESTUS_RLE_SIMD
+        if constexpr (sizeof(T) <= 4) {
+            const vector_t splat = splat_value(value);
+            for (; i + LANES <= max_count; i += LANES) {
+                const uint32_t equal = equal_mask(load(data + i), splat);
+                if (equal != VECTOR_MASK) {
+                    return i + CountTrailingZeros(~equal) / sizeof(T);
+                }
+            }
+        }
+#endif
+        while (i < max_count && data[i] == value) {
+            ++i;
+        }
+        return i;
     }
 
-    static data_container encode(const data_container& input) {
-        data_container out;
-        out.reserve(input.size());
-
-        for (auto iter = input.cbegin(); iter != input.cend();) {
-            // First attempt at checking for repetitions
-            auto num = count_repetitions(iter, input.cend());
-            // If there's more than one repetition, we have a run
-            if (num > 1) {
-                split(num, [&](T count) {
-                    // Repetition bit plus the count
-                    out.emplace_back(REPETITION_BIT | count);
-                    // Insert the value that's being repeated
-                    out.emplace_back(*iter);
-                });
-                // Iterate iter by the number of repetitions of *iter
-                iter += num;
+    // Number of values before the first run of MIN_RUN or more, at most "max_count"
+    static size_t count_uniques(const T* data, const size_t max_count) noexcept {
+        size_t i = 0;
+#if HEPHAESTUS_RLE_SIMD
+        if constexpr (sizeof(T) <= 4) {
+            for (; i + LANES + 2 <= max_count; i += LANES) {
+                const vector_t current = load(data + i);
+                const uint32_t run_starts = equal_mask(current, load(data + i + 1)) & equal_mask(current, load(data + i + 2));
+                if (run_starts != 0) {
+                    return i + CountTrailingZeros(run_starts) / sizeof(T);
+                }
             }
-            else {
-                // Count amount of non-repeated characters in a row/run (unique chars)
-                auto num = count_uniques(iter, input.cend());
-                split(num, [&](T count) {
-                    // No repetition bit, just counter
-                    out.emplace_back(count);
-                    std::copy(iter, iter + count, std::back_inserter(out));
-                    iter += count;
-                });
+        }
+#endif
+        for (; i + 2 < max_count; ++i) {
+            if (data[i] == data[i + 1] && data[i] == data[i + 2]) {
+                return i;
             }
         }
-
-        out.shrink_to_fit();
-        return out;
+        return max_count;
     }
 
-    static data_container decode(const data_container& compressed_input) {
-        data_container out;
-        // Over-estimate potential size
-        out.reserve(compressed_input.size() * 4);
+private:
 
-        for (auto iter = compressed_input.cbegin(); iter != compressed_input.cend();) {
+#if HEPHAESTUS_RLE_SIMD == 2
+    using vector_t = __m256i;
+    constexpr static uint32_t VECTOR_MASK = 0xffffffffu;
 
-            bool repeat = (*iter & REPETITION_BIT) > 0;
+    static vector_t load(const T* data) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    }
 
-            auto count = *iter & COUNTER_BITS;
+    static vector_t splat_value(const T value) noexcept {
+        if constexpr (sizeof(T) == 1) {
+            return _mm256_set1_epi8(static_cast<char>(value));
+        }
+        else if constexpr (sizeof(T) == 2) {
+            return _mm256_set1_epi16(static_cast<short>(value));
+        }
+        else {
+            return _mm256_set1_epi32(static_cast<int>(value));
+        }
+    }
 
-            if (repeat) {
-                for (auto i = 0; i < count;) {
-                    out.emplace_back(*iter);
-                }
-                ++iter;
-            }
-            else {
-                ++iter;
-                for (; count > 1; count--) {
-                    out.emplace_back(*++iter);
-                }
-            }
+    // One bit per byte: all sizeof(T) bits of an element are set if it is equal in "a" and "b"
+    static uint32_t equal_mask(const vector_t a, const vector_t b) noexcept {
+        if constexpr (sizeof(T) == 1) {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+        }
+        else if constexpr (sizeof(T) == 2) {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(a, b)));
+        }
+        else {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b)));
+        }
+    }
+#elif HEPHAESTUS_RLE_SIMD == 1
+    using vector_t = __m128i;
+    constexpr static uint32_t VECTOR_MASK = 0xffffu;
+
+    static vector_t load(const T* data) noexcept {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    }
 
+    static vector_t splat_value(const T value) noexcept {
+        if constexpr (sizeof(T) == 1) {
+            return _mm_set1_epi8(static_cast<char>(value));
+        }
+        else if constexpr (sizeof(T) == 2) {
+            return _mm_set1_epi16(static_cast<short>(value));
+        }
+        else {
+            return _mm_set1_epi32(static_cast<int>(value));
         }
+    }
 
-        out.shrink_to_fit();
-        return out;
+    static uint32_t equal_mask(const vector_t a, const vector_t b) noexcept {
+        if constexpr (sizeof(T) == 1) {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+        }
+        else if constexpr (sizeof(T) == 2) {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(a, b)));
+        }
+        else {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi32(a, b)));
+        }
     }
+#endif
+
+#if HEPHAESTUS_RLE_SIMD
+    constexpr static size_t LANES = sizeof(vector_t) / sizeof(T);
+#endif
 
 };
 
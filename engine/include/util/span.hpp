@@ -0,0 +1,23 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_SPAN_HPP
+#define HEPHAESTUS_ENGINE_SPAN_HPP
+#include <cstddef>
+
+// Non-owning view of "size" contiguous elements, until we can use std::span.
+template<typename T>
+struct span_t {
+    T* ptr{ nullptr };
+    size_t count{ 0 };
+
+    constexpr span_t() noexcept = default;
+    constexpr span_t(T* data, const size_t size) noexcept : ptr(data), count(size) {}
+
+    constexpr T* data() const noexcept { return ptr; }
+    constexpr size_t size() const noexcept { return count; }
+    constexpr bool empty() const noexcept { return count == 0; }
+    constexpr T* begin() const noexcept { return ptr; }
+    constexpr T* end() const noexcept { return ptr + count; }
+    constexpr T& operator[](const size_t idx) const noexcept { return ptr[idx]; }
+};
+
+#endif //!HEPHAESTUS_ENGINE_SPAN_HPP
@@ -0,0 +1,119 @@
+#pragma once
+#ifndef HEPHAESTUS_ENGINE_VOXEL_CHUNK_HPP
+#define HEPHAESTUS_ENGINE_VOXEL_CHUNK_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+
+    VoxelChunk
+
+    One brick of a VoxelVolume: a cube of (1 << SizeLog2)^3 voxels. Most bricks in a
+    world are entirely air or entirely stone, so a brick starts out "uniform", holding
+    just the one value all its voxels share, and only allocates dense storage once a
+    voxel is set to something else. Compact() collapses it back when possible.
+
+    Voxels are laid out y-major, then x, then z, like blocks in GetBlockIndex().
+
+*/
+
+template<typename VoxelType, uint32_t SizeLog2 = 3>
+class VoxelChunk {
+public:
+
+    constexpr static uint32_t SIZE_LOG2 = SizeLog2;
+    constexpr static uint32_t SIZE = 1u << SizeLog2;
+    constexpr static size_t VOXEL_COUNT = size_t(SIZE) * SIZE * SIZE;
+
+    explicit VoxelChunk(const VoxelType& fill = VoxelType()) : uniformValue(fill) {}
+
+    VoxelChunk(const VoxelChunk& other) : uniformValue(other.uniformValue) {
+        if (other.voxels) {
+            voxels = std::make_unique<VoxelType[]>(VOXEL_COUNT);
+            std::copy(other.voxels.get(), other.voxels.get() + VOXEL_COUNT, voxels.get());
+        }
+    }
+
+    VoxelChunk& operator=(const VoxelChunk& other) {
+        if (this != &other) {
+            VoxelChunk copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    VoxelChunk(VoxelChunk&&) noexcept = default;
+    VoxelChunk& operator=(VoxelChunk&&) noexcept = default;
+
+    // Coordinates are local to the brick, each in [0, SIZE)
+    const VoxelType& Get(const uint32_t x, const uint32_t y, const uint32_t z) const noexcept {
+        return voxels ? voxels[GetIndex(x, y, z)] : uniformValue;
+    }
+
+    void Set(const uint32_t x, const uint32_t y, const uint32_t z, const VoxelType& value) {
+        if (!voxels) {
+            if (value == uniformValue) {
+                return;
+            }
+            expand();
+        }
+        voxels[GetIndex(x, y, z)] = value;
+    }
+
+    // Sets every voxel in the brick, releasing dense storage
+    void Fill(const VoxelType& value) noexcept {
+        // "value" may be one of our own voxels, so copy it before releasing them
+        uniformValue = value;
+        voxels.reset();
+    }
+
+    // Collapses the brick back to a single value if all its voxels are equal. Returns true if the brick is uniform afterwards.
+    bool Compact() {
+        if (!voxels) {
+            return true;
+        }
+        const VoxelType& first = voxels[0];
+        if (!std::all_of(voxels.get() + 1, voxels.get() + VOXEL_COUNT, [&first](const VoxelType& v) { return v == first; })) {
+            return false;
+        }
+        Fill(first);
+        return true;
+    }
+
+    bool IsUniform() const noexcept {
+        return !voxels;
+    }
+
+    // Only meaningful while IsUniform()
+    const VoxelType& UniformValue() const noexcept {
+        return uniformValue;
+    }
+
+    // Dense voxel storage, laid out as per GetIndex(). nullptr while the brick is uniform.
+    const VoxelType* Data() const noexcept {
+        return voxels.get();
+    }
+
+    size_t MemoryUsage() const noexcept {
+        return voxels ? VOXEL_COUNT * sizeof(VoxelType) : 0;
+    }
+
+    constexpr static size_t GetIndex(const uint32_t x, const uint32_t y, const uint32_t z) noexcept {
+        return (size_t(y) << (2 * SizeLog2)) | (size_t(x) << SizeLog2) | size_t(z);
+    }
+
+private:
+
+    void expand() {
+        voxels = std::make_unique<VoxelType[]>(VOXEL_COUNT);
+        std::fill(voxels.get(), voxels.get() + VOXEL_COUNT, uniformValue);
+    }
+
+    VoxelType uniformValue;
+    std::unique_ptr<VoxelType[]> voxels;
+
+};
+
+#endif //!HEPHAESTUS_ENGINE_VOXEL_CHUNK_HPP
@@ -3,21 +3,147 @@
 #define HEPHAESTUS_ENGINE_VOXEL_SAMPLER_HPP
 #include "glm/vec3.hpp"
 #include "VoxelVolume.hpp"
+#include <cstddef>
 
-template<typename VoxelType>
-struct VoxelSampler {
+/*
 
-    constexpr VoxelSampler() noexcept = default;
-    constexpr ~VoxelSampler() noexcept = default;
-    constexpr VoxelSampler(glm::ivec3 p, VoxelVolume* volume) noexcept : Position{ std::move(p) }, Volume{ volume } {}
+    VoxelSampler
 
-    glm::ivec3 Position{ 0, 0, 0 };
-    VoxelVolume* Volume{ nullptr };
+    Cursor into a VoxelVolume, for code that walks the volume and probes the voxels
+    around it: meshing, lighting and physics all look at 6 or 26 neighbours at a time.
+    The sampler keeps the brick it is in and its index within that brick, so Get() is
+    a single load. Peek<dx, dy, dz>() is resolved at compile time to a constant offset
+    from that index, and only when the neighbour lies in another brick does it fall
+    back to a lookup through the volume. MoveX/MoveY/MoveZ step the cursor, and only
+    look up a new brick when they cross into one.
 
-    VoxelType Get() const;    
-    void Set(VoxelType v) noexcept;
+    The cached brick is invalidated by VoxelVolume::Compact(), and by edits made to the
+    volume other than through this sampler: call SetPosition() to re-seat it after those.
+
+*/
+
+template<typename VoxelType, uint32_t BrickSizeLog2 = 3, uint32_t RegionSizeLog2 = 4>
+class VoxelSampler {
+public:
+
+    using volume_type = VoxelVolume<VoxelType, BrickSizeLog2, RegionSizeLog2>;
+    using brick_type = typename volume_type::brick_type;
+
+    constexpr static int32_t BRICK_SIZE = volume_type::BRICK_SIZE;
+
+    VoxelSampler() noexcept = default;
+    VoxelSampler(const glm::ivec3& p, volume_type* volume) noexcept : volume(volume) {
+        SetPosition(p);
+    }
+
+    VoxelType Get() const noexcept {
+        if (!brick) {
+            return volume->Background();
+        }
+        const VoxelType* data = brick->Data();
+        return data ? data[index] : brick->UniformValue();
+    }
+
+    void Set(const VoxelType& v) {
+        if (brick) {
+            brick->Set(localX, localY, localZ, v);
+            return;
+        }
+        // Region holds only background: let the volume create it, then pick up the new brick
+        volume->Set(position, v);
+        resolveBrick();
+    }
+
+    // Voxel at an offset from the sampler. Offsets must be smaller than a brick, which covers every neighbour probe.
     template<int PeekX, int PeekY, int PeekZ>
-    VoxelType Peek() const;
+    VoxelType Peek() const noexcept {
+        static_assert(PeekX > -BRICK_SIZE && PeekX < BRICK_SIZE && PeekY > -BRICK_SIZE && PeekY < BRICK_SIZE &&
+            PeekZ > -BRICK_SIZE && PeekZ < BRICK_SIZE, "Peek offsets must be smaller than a brick");
+        constexpr ptrdiff_t offset = PeekY * Y_STRIDE + PeekX * X_STRIDE + PeekZ;
+        if (inBrick<PeekX>(localX) && inBrick<PeekY>(localY) && inBrick<PeekZ>(localZ)) {
+            if (!brick) {
+                return volume->Background();
+            }
+            const VoxelType* data = brick->Data();
+            return data ? data[static_cast<ptrdiff_t>(index) + offset] : brick->UniformValue();
+        }
+        return volume->Get(position + glm::ivec3(PeekX, PeekY, PeekZ));
+    }
+
+    void MoveX(const int32_t delta = 1) noexcept {
+        position.x += delta;
+        move(localX, delta, X_STRIDE);
+    }
+
+    void MoveY(const int32_t delta = 1) noexcept {
+        position.y += delta;
+        move(localY, delta, Y_STRIDE);
+    }
+
+    void MoveZ(const int32_t delta = 1) noexcept {
+        position.z += delta;
+        move(localZ, delta, 1);
+    }
+
+    void SetPosition(const glm::ivec3& p) noexcept {
+        position = p;
+        resolveBrick();
+    }
+
+    const glm::ivec3& GetPosition() const noexcept {
+        return position;
+    }
+
+    volume_type* GetVolume() const noexcept {
+        return volume;
+    }
+
+private:
+
+    // Distance between neighbouring voxels along x and y within a brick, as per VoxelChunk::GetIndex()
+    constexpr static ptrdiff_t X_STRIDE = ptrdiff_t(1) << BrickSizeLog2;
+    constexpr static ptrdiff_t Y_STRIDE = ptrdiff_t(1) << (2 * BrickSizeLog2);
+
+    // Whether a neighbour "D" voxels along an axis is still inside the brick, given our coordinate along that axis
+    template<int D>
+    constexpr static bool inBrick(const uint32_t local) noexcept {
+        if constexpr (D > 0) {
+            return local < static_cast<uint32_t>(BRICK_SIZE - D);
+        }
+        else if constexpr (D < 0) {
+            return local >= static_cast<uint32_t>(-D);
+        }
+        else {
+            return true;
+        }
+    }
+
+    void move(uint32_t& local, const int32_t delta, const ptrdiff_t stride) noexcept {
+        const int32_t moved = static_cast<int32_t>(local) + delta;
+        if (moved >= 0 && moved < BRICK_SIZE) {
+            local = static_cast<uint32_t>(moved);
+            index = static_cast<size_t>(static_cast<ptrdiff_t>(index) + delta * stride);
+            return;
+        }
+        resolveBrick();
+    }
+
+    void resolveBrick() noexcept {
+        brick = volume->GetBrick(volume_type::GetBrickCoord(position));
+        localX = static_cast<uint32_t>(position.x) & (BRICK_SIZE - 1);
+        localY = static_cast<uint32_t>(position.y) & (BRICK_SIZE - 1);
+        localZ = static_cast<uint32_t>(position.z) & (BRICK_SIZE - 1);
+        index = brick_type::GetIndex(localX, localY, localZ);
+    }
+
+    volume_type* volume{ nullptr };
+    glm::ivec3 position{ 0, 0, 0 };
+    // nullptr while in a region holding only background
+    brick_type* brick{ nullptr };
+    uint32_t localX{ 0 };
+    uint32_t localY{ 0 };
+    uint32_t localZ{ 0 };
+    size_t index{ 0 };
 
 };
 
@@ -1,14 +1,223 @@
 #pragma once
 #ifndef HEPHAESTUS_ENGINE_VOXEL_VOLUME_HPP
 #define HEPHAESTUS_ENGINE_VOXEL_VOLUME_HPP
+#include "VoxelChunk.hpp"
+#include "glm/vec3.hpp"
 #include <type_traits>
+#include <algorithm>
 #include <array>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
-template<typename VoxelType>
-struct VoxelVolume {
+/*
+
+    VoxelVolume
+
+    Sparse, unbounded volume of voxels, stored as a brick map with a two-level
+    directory. Voxels are grouped into bricks (VoxelChunks) of (1 << BrickSizeLog2)^3
+    voxels, and bricks into regions of (1 << RegionSizeLog2)^3 bricks. Regions live in
+    a hash map keyed by their coordinates; within a region, bricks are a flat array.
+    Any access is a hash lookup, then two shifts and masks, regardless of where chunk
+    borders fall.
+
+    Regions that were never written read as the background value and take no memory.
+    Uniform bricks hold only their single value, so memory grows with the amount of
+    surface detail in the world rather than with its volume. Compact() collapses
+    bricks that have become uniform again, and drops regions left all background.
+
+*/
+
+template<typename VoxelType, uint32_t BrickSizeLog2 = 3, uint32_t RegionSizeLog2 = 4>
+class VoxelVolume {
+    static_assert(std::is_copy_assignable<VoxelType>::value, "Voxels must be copyable");
+public:
+
+    using brick_type = VoxelChunk<VoxelType, BrickSizeLog2>;
+
+    constexpr static int32_t BRICK_SIZE = int32_t(1) << BrickSizeLog2;
+    // In bricks, along each axis
+    constexpr static int32_t REGION_SIZE = int32_t(1) << RegionSizeLog2;
+    constexpr static size_t BRICKS_PER_REGION = size_t(REGION_SIZE) * REGION_SIZE * REGION_SIZE;
+
+    explicit VoxelVolume(const VoxelType& background = VoxelType()) : background(background) {}
+
+    const VoxelType& Get(const glm::ivec3& p) const noexcept {
+        const region_t* region = findRegion(getRegionCoord(p));
+        if (!region) {
+            return background;
+        }
+        return region->Bricks[getBrickSlot(p)].Get(localCoord(p.x), localCoord(p.y), localCoord(p.z));
+    }
+
+    void Set(const glm::ivec3& p, const VoxelType& value) {
+        const glm::ivec3 region_coord = getRegionCoord(p);
+        region_t* region = findRegion(region_coord);
+        if (!region) {
+            if (value == background) {
+                return;
+            }
+            region = createRegion(region_coord);
+        }
+        region->Bricks[getBrickSlot(p)].Set(localCoord(p.x), localCoord(p.y), localCoord(p.z), value);
+    }
+
+    // Sets every voxel in the box from "min" to "max", inclusive. Bricks the box covers entirely are collapsed
+    // to "value" without touching their voxels.
+    void Fill(const glm::ivec3& min, const glm::ivec3& max, const VoxelType& value) {
+        const glm::ivec3 brick_min = GetBrickCoord(min);
+        const glm::ivec3 brick_max = GetBrickCoord(max);
+        for (int32_t by = brick_min.y; by <= brick_max.y; ++by) {
+            for (int32_t bx = brick_min.x; bx <= brick_max.x; ++bx) {
+                for (int32_t bz = brick_min.z; bz <= brick_max.z; ++bz) {
+                    const glm::ivec3 brick_origin(bx * BRICK_SIZE, by * BRICK_SIZE, bz * BRICK_SIZE);
+                    const glm::ivec3 brick_end = brick_origin + glm::ivec3(BRICK_SIZE - 1);
+                    const glm::ivec3 lo(std::max(min.x, brick_origin.x), std::max(min.y, brick_origin.y), std::max(min.z, brick_origin.z));
+                    const glm::ivec3 hi(std::min(max.x, brick_end.x), std::min(max.y, brick_end.y), std::min(max.z, brick_end.z));
+                    const bool whole_brick = (lo == brick_origin) && (hi == brick_end);
+
+                    const glm::ivec3 region_coord = getRegionCoord(brick_origin);
+                    region_t* region = findRegion(region_coord);
+                    if (!region) {
+                        if (value == background) {
+                            continue;
+                        }
+                        region = createRegion(region_coord);
+                    }
+                    brick_type& brick = region->Bricks[getBrickSlot(brick_origin)];
+                    if (whole_brick) {
+                        brick.Fill(value);
+                        continue;
+                    }
+                    for (int32_t y = lo.y; y <= hi.y; ++y) {
+                        for (int32_t x = lo.x; x <= hi.x; ++x) {
+                            for (int32_t z = lo.z; z <= hi.z; ++z) {
+                                brick.Set(localCoord(x), localCoord(y), localCoord(z), value);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Brick holding voxels "brick_coord" * BRICK_SIZE onwards, or nullptr if its region holds only background
+    const brick_type* GetBrick(const glm::ivec3& brick_coord) const noexcept {
+        const glm::ivec3 p = brick_coord * BRICK_SIZE;
+        const region_t* region = findRegion(getRegionCoord(p));
+        return region ? &region->Bricks[getBrickSlot(p)] : nullptr;
+    }
+
+    brick_type* GetBrick(const glm::ivec3& brick_coord) noexcept {
+        return const_cast<brick_type*>(static_cast<const VoxelVolume*>(this)->GetBrick(brick_coord));
+    }
+
+    // Collapses bricks whose voxels are all equal, and frees regions left holding nothing but background.
+    void Compact() {
+        for (auto iter = regions.begin(); iter != regions.end();) {
+            bool all_background = true;
+            for (auto& brick : iter->second->Bricks) {
+                if (!brick.Compact() || !(brick.UniformValue() == background)) {
+                    all_background = false;
+                }
+            }
+            iter = all_background ? regions.erase(iter) : std::next(iter);
+        }
+    }
+
+    const VoxelType& Background() const noexcept {
+        return background;
+    }
+
+    size_t RegionCount() const noexcept {
+        return regions.size();
+    }
+
+    size_t DenseBrickCount() const noexcept {
+        size_t count = 0;
+        for (const auto& region : regions) {
+            for (const auto& brick : region.second->Bricks) {
+                count += brick.IsUniform() ? 0 : 1;
+            }
+        }
+        return count;
+    }
+
+    // Approximate bytes of heap memory used, not counting the hash map's own bookkeeping
+    size_t MemoryUsage() const noexcept {
+        size_t result = regions.size() * sizeof(region_t);
+        for (const auto& region : regions) {
+            for (const auto& brick : region.second->Bricks) {
+                result += brick.MemoryUsage();
+            }
+        }
+        return result;
+    }
+
+    // Floor division by the brick size, so negative coordinates land in the right brick
+    static glm::ivec3 GetBrickCoord(const glm::ivec3& p) noexcept {
+        return glm::ivec3(floorShift(p.x, BrickSizeLog2), floorShift(p.y, BrickSizeLog2), floorShift(p.z, BrickSizeLog2));
+    }
+
+private:
+
+    struct region_t {
+        region_t(const VoxelType& fill) {
+            Bricks.fill(brick_type(fill));
+        }
+        std::array<brick_type, BRICKS_PER_REGION> Bricks;
+    };
+
+    // Arithmetic shift of a signed value: rounds towards negative infinity
+    static int32_t floorShift(const int32_t val, const uint32_t shift) noexcept {
+        return val >= 0 ? (val >> shift) : -((-(val + 1)) >> shift) - 1;
+    }
+
+    static uint32_t localCoord(const int32_t val) noexcept {
+        return static_cast<uint32_t>(val) & (BRICK_SIZE - 1);
+    }
+
+    static glm::ivec3 getRegionCoord(const glm::ivec3& p) noexcept {
+        constexpr uint32_t shift = BrickSizeLog2 + RegionSizeLog2;
+        return glm::ivec3(floorShift(p.x, shift), floorShift(p.y, shift), floorShift(p.z, shift));
+    }
+
+    // Index of the brick holding voxel "p" within its region
+    static size_t getBrickSlot(const glm::ivec3& p) noexcept {
+        constexpr uint32_t mask = REGION_SIZE - 1;
+        const uint32_t bx = (static_cast<uint32_t>(p.x) >> BrickSizeLog2) & mask;
+        const uint32_t by = (static_cast<uint32_t>(p.y) >> BrickSizeLog2) & mask;
+        const uint32_t bz = (static_cast<uint32_t>(p.z) >> BrickSizeLog2) & mask;
+        return (size_t(by) << (2 * RegionSizeLog2)) | (size_t(bx) << RegionSizeLog2) | size_t(bz);
+    }
+
+    // 21 bits per axis is plenty: regions are at least 16 voxels across
+    static uint64_t getRegionKey(const glm::ivec3& region) noexcept {
+        constexpr uint64_t mask = (uint64_t(1) << 21) - 1;
+        return ((static_cast<uint64_t>(static_cast<uint32_t>(region.x)) & mask) << 42) |
+            ((static_cast<uint64_t>(static_cast<uint32_t>(region.y)) & mask) << 21) |
+            (static_cast<uint64_t>(static_cast<uint32_t>(region.z)) & mask);
+    }
+
+    const region_t* findRegion(const glm::ivec3& region_coord) const noexcept {
+        auto iter = regions.find(getRegionKey(region_coord));
+        return iter != regions.end() ? iter->second.get() : nullptr;
+    }
+
+    region_t* findRegion(const glm::ivec3& region_coord) noexcept {
+        auto iter = regions.find(getRegionKey(region_coord));
+        return iter != regions.end() ? iter->second.get() : nullptr;
+    }
+
+    region_t* createRegion(const glm::ivec3& region_coord) {
+        auto& region = regions[getRegionKey(region_coord)];
+        region = std::make_unique<region_t>(background);
+        return region.get();
+    }
+
+    VoxelType background;
+    std::unordered_map<uint64_t, std::unique_ptr<region_t>> regions;
 
-    
 };
 
 #endif //!HEPHAESTUS_ENGINE_VOXEL_VOLUME_HPP
@@ -0,0 +1,107 @@
+#include "generation/DensityField.hpp"
+#include "util/CommonUtil.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace terrain {
+
+	constexpr static size_t LAYER_SIZE = CHUNK_SIZE * CHUNK_SIZE;
+	constexpr static float INV_SPACING = 1.0f / static_cast<float>(DensityField::LATTICE_SPACING);
+
+	static inline size_t latticeIndex(const size_t& x, const size_t& y, const size_t& z) {
+		return (y * DensityField::LATTICE_X + x) * DensityField::LATTICE_Z + z;
+	}
+
+	void DensityField::SampleLattice(const noise::NoiseGenerator& noise, const glm::ivec2& grid_position) {
+		const float origin_x = static_cast<float>(grid_position.x) * static_cast<float>(CHUNK_SIZE);
+		const float origin_z = static_cast<float>(grid_position.y) * static_cast<float>(CHUNK_SIZE);
+		for (size_t y = 0; y < LATTICE_Y; ++y) {
+			for (size_t x = 0; x < LATTICE_X; ++x) {
+				for (size_t z = 0; z < LATTICE_Z; ++z) {
+					const glm::vec3 pos(origin_x + static_cast<float>(x * LATTICE_SPACING), static_cast<float>(y * LATTICE_SPACING),
+						origin_z + static_cast<float>(z * LATTICE_SPACING));
+					lattice[latticeIndex(x, y, z)] = noise.Sample(pos);
+				}
+			}
+		}
+	}
+
+	void DensityField::AddHeightGradient(const float& base_height, const float& falloff) {
+		for (size_t y = 0; y < LATTICE_Y; ++y) {
+			const float offset = (base_height - static_cast<float>(y * LATTICE_SPACING)) * falloff;
+			float* layer = lattice.data() + latticeIndex(0, y, 0);
+			for (size_t i = 0; i < LATTICE_X * LATTICE_Z; ++i) {
+				layer[i] += offset;
+			}
+		}
+	}
+
+	void DensityField::Interpolate(float* dest) const {
+		// Layers of blocks are contiguous in GetBlockIndex() order, so interpolate lattice layers out to whole block layers
+		// first, then each block layer is a lerp between the two lattice layers around it.
+		float layers[2][LAYER_SIZE];
+		float* below = layers[0];
+		float* above = layers[1];
+		interpolateLayer(0, below);
+		for (size_t ly = 0; ly + 1 < LATTICE_Y; ++ly) {
+			interpolateLayer(ly + 1, above);
+			for (size_t dy = 0; dy < LATTICE_SPACING; ++dy) {
+				const float t = static_cast<float>(dy) * INV_SPACING;
+				float* layer = dest + GetBlockIndex(0, ly * LATTICE_SPACING + dy, 0);
+				for (size_t i = 0; i < LAYER_SIZE; ++i) {
+					layer[i] = below[i] + (above[i] - below[i]) * t;
+				}
+			}
+			std::swap(below, above);
+		}
+	}
+
+	float DensityField::GetLatticeValue(const size_t& x, const size_t& y, const size_t& z) const {
+		return lattice[latticeIndex(x, y, z)];
+	}
+
+	void DensityField::interpolateLayer(const size_t& y, float* dest) const {
+		// Along z first, for each lattice row along x, then between those rows
+		float rows[LATTICE_X][CHUNK_SIZE];
+		for (size_t lx = 0; lx < LATTICE_X; ++lx) {
+			const float* row = lattice.data() + latticeIndex(lx, y, 0);
+			for (size_t z = 0; z < CHUNK_SIZE; ++z) {
+				const size_t lz = z / LATTICE_SPACING;
+				const float t = static_cast<float>(z % LATTICE_SPACING) * INV_SPACING;
+				rows[lx][z] = row[lz] + (row[lz + 1] - row[lz]) * t;
+			}
+		}
+		for (size_t x = 0; x < CHUNK_SIZE; ++x) {
+			const size_t lx = x / LATTICE_SPACING;
+			const float t = static_cast<float>(x % LATTICE_SPACING) * INV_SPACING;
+			float* column = dest + x * CHUNK_SIZE;
+			for (size_t z = 0; z < CHUNK_SIZE; ++z) {
+				column[z] = rows[lx][z] + (rows[lx + 1][z] - rows[lx][z]) * t;
+			}
+		}
+	}
+
+	void GenerateDensityTerrain(const noise::NoiseGenerator& noise, const DensityTerrainParams& params, ChunkComponent& chunk) {
+		// Per-thread, as chunks are generated on worker threads
+		thread_local DensityField field;
+		thread_local std::vector<float> density(BLOCKS_PER_CHUNK);
+		thread_local std::vector<uint16_t> entries(BLOCKS_PER_CHUNK);
+
+		field.SampleLattice(noise, chunk.GridPosition);
+		field.AddHeightGradient(params.BaseHeight, params.HeightFalloff);
+		field.Interpolate(density.data());
+
+		// Palette entries: 0 air, 1 stone, 2 bedrock
+		for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+			entries[i] = density[i] > 0.0f ? uint16_t(1) : uint16_t(0);
+		}
+		std::fill(entries.begin(), entries.begin() + LAYER_SIZE, uint16_t(2));
+
+		BlockComponent palette[3];
+		palette[0].Type = static_cast<uint16_t>(BlockTypes::AIR);
+		palette[1].Type = static_cast<uint16_t>(BlockTypes::STONE);
+		palette[2].Type = static_cast<uint16_t>(BlockTypes::BEDROCK);
+		chunk.Blocks.ImportEntries(palette, 3, entries.data());
+	}
+
+}
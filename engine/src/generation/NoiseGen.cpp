@@ -1,21 +1,31 @@
-#include "stdafx.h"
-#include "engine/generation/NoiseGen.hpp"
+#include "generation/NoiseGen.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 
 namespace noise {
 
-	NoiseCfg NoiseGenerator::NoiseConfig = NoiseCfg();
-
-	NoiseGenerator::NoiseGenerator() {
-		std::random_device rd;
-		std::mt19937 rng(rd());
-		rng.seed(NoiseConfig.Seed);
-		std::accumulate(perm.begin(), perm.begin() + 256, 0);
-		std::accumulate(perm.begin() + 256, perm.end(), 0);
+	NoiseGenerator::NoiseGenerator(const NoiseCfg& cfg) : config(cfg) {
+		// Local to the generator, so generators can be built concurrently
+		std::mt19937 rng(static_cast<std::mt19937::result_type>(config.Seed));
+		// Two runs of 0-255, shuffled together
+		std::iota(perm.begin(), perm.begin() + 256, 0);
+		std::iota(perm.begin() + 256, perm.end(), 0);
 		std::shuffle(perm.begin(), perm.end(), rng);
+		std::copy(perm.begin(), perm.end(), permWide.begin());
+	}
+
+	const NoiseCfg& NoiseGenerator::GetConfig() const noexcept {
+		return config;
 	}
 
 	float NoiseGenerator::Sample(const double & x, const double & z) const {
-		switch (NoiseConfig.FractalType) {
+		switch (config.FractalType) {
 		case fractalType::FBM:
 			return fbm(x, z);
 		default:
@@ -136,7 +146,7 @@ namespace noise {
 
 	double NoiseGenerator::valueNoise(const double & x, const double & z) const {
 		auto noise_1 = [&](const int& _n) { 
-			int n = _n + NoiseConfig.Seed;
+			int n = _n + config.Seed;
 			n = (n << 13) ^ n;
 			int nn = (n * (n*n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
 			return (1.0 - (static_cast<double>(nn) / 1073741824.0));
@@ -163,11 +173,11 @@ namespace noise {
 		double sum = 0;
 		double amplitude = 1.0;
 		glm::dvec2 f; 
-		f.x = x * NoiseConfig.Frequency;
-		f.y = y * NoiseConfig.Frequency;
-		for (size_t i = 0; i < NoiseConfig.Octaves; ++i) {
+		f.x = x * config.Frequency;
+		f.y = y * config.Frequency;
+		for (size_t i = 0; i < config.Octaves; ++i) {
 			double n = 0.0;
-			switch (NoiseConfig.NoiseType) {
+			switch (config.NoiseType) {
 			case noiseType::VALUE:
 				n = valueNoise(f.x, f.y);
 				break;
@@ -176,11 +186,431 @@ namespace noise {
 				break;
 			}
 			sum += n*amplitude;
-			f *= NoiseConfig.Lacunarity;
-			amplitude *= NoiseConfig.Persistence;
+			f *= config.Lacunarity;
+			amplitude *= config.Persistence;
+		}
+		return sum;
+	}
+
+	float NoiseGenerator::Sample(const glm::vec3& pos) const {
+		switch (config.FractalType) {
+		case fractalType::FBM:
+			return static_cast<float>(fbm3(pos.x, pos.y, pos.z));
+		default:
+			return 0.0f;
+		}
+	}
+
+	float NoiseGenerator::Sample(const size_t& x, const size_t& y, const size_t& z) const {
+		return Sample(glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)));
+	}
+
+	// Edges of a cube: gradients for 3D simplex noise
+	static constexpr int GRAD3[12][3] = {
+		{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+		{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+		{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 }
+	};
+
+	double NoiseGenerator::simplex3(const double& x, const double& y, const double& z) const {
+		constexpr double F3 = 1.0 / 3.0;
+		constexpr double G3 = 1.0 / 6.0;
+
+		// Skew into the cubic lattice to find the cell, then back to find the offset from its origin
+		const double s = (x + y + z) * F3;
+		const int i = fastfloor(x + s);
+		const int j = fastfloor(y + s);
+		const int k = fastfloor(z + s);
+		const double t = static_cast<double>(i + j + k) * G3;
+		const double x0 = x - (i - t);
+		const double y0 = y - (j - t);
+		const double z0 = z - (k - t);
+
+		// The cell splits into six tetrahedra: offsets of the second and third corners of ours, by ordering x0, y0, z0
+		int i1, j1, k1, i2, j2, k2;
+		if (x0 >= y0) {
+			if (y0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+			else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+			else { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+		}
+		else {
+			if (y0 < z0) { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+			else if (x0 < z0) { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+			else { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+		}
+
+		const double x1 = x0 - i1 + G3, y1 = y0 - j1 + G3, z1 = z0 - k1 + G3;
+		const double x2 = x0 - i2 + 2.0 * G3, y2 = y0 - j2 + 2.0 * G3, z2 = z0 - k2 + 2.0 * G3;
+		const double x3 = x0 - 1.0 + 3.0 * G3, y3 = y0 - 1.0 + 3.0 * G3, z3 = z0 - 1.0 + 3.0 * G3;
+
+		// Lookups stay below 512: each adds at most 256 to a value from perm
+		const int ii = i & 255;
+		const int jj = j & 255;
+		const int kk = k & 255;
+		auto corner = [this](const int hash, const double cx, const double cy, const double cz) {
+			double t = 0.6 - cx * cx - cy * cy - cz * cz;
+			if (t < 0.0) {
+				return 0.0;
+			}
+			t *= t;
+			const int* g = GRAD3[hash % 12];
+			return t * t * (g[0] * cx + g[1] * cy + g[2] * cz);
+		};
+		const double n0 = corner(perm[ii + perm[jj + perm[kk]]], x0, y0, z0);
+		const double n1 = corner(perm[ii + i1 + perm[jj + j1 + perm[kk + k1]]], x1, y1, z1);
+		const double n2 = corner(perm[ii + i2 + perm[jj + j2 + perm[kk + k2]]], x2, y2, z2);
+		const double n3 = corner(perm[ii + 1 + perm[jj + 1 + perm[kk + 1]]], x3, y3, z3);
+
+		// Scales the result to about [-1, 1]
+		return 32.0 * (n0 + n1 + n2 + n3);
+	}
+
+	double NoiseGenerator::valueNoise3(const double& x, const double& y, const double& z) const {
+		const int fx = fastfloor(x);
+		const int fy = fastfloor(y);
+		const int fz = fastfloor(z);
+		const int seed = static_cast<int>(config.Seed);
+		// The 2D hash, with a third prime for the new axis
+		auto noise_1 = [seed](const int ix, const int iy, const int iz) {
+			int n = ix + iy * 57 + iz * 131 + seed;
+			n = (n << 13) ^ n;
+			const int nn = (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
+			return 1.0 - (static_cast<double>(nn) / 1073741824.0);
+		};
+
+		const double dx = x - fx;
+		const double dy = y - fy;
+		const double dz = z - fz;
+		const double y0 = lerp(lerp(noise_1(fx, fy, fz), noise_1(fx + 1, fy, fz), dx), lerp(noise_1(fx, fy, fz + 1), noise_1(fx + 1, fy, fz + 1), dx), dz);
+		const double y1 = lerp(lerp(noise_1(fx, fy + 1, fz), noise_1(fx + 1, fy + 1, fz), dx),
+			lerp(noise_1(fx, fy + 1, fz + 1), noise_1(fx + 1, fy + 1, fz + 1), dx), dz);
+		return lerp(y0, y1, dy);
+	}
+
+	double NoiseGenerator::fbm3(const double& x, const double& y, const double& z) const {
+		double sum = 0.0;
+		double amplitude = 1.0;
+		glm::dvec3 f = glm::dvec3(x, y, z) * static_cast<double>(config.Frequency);
+		for (size_t i = 0; i < config.Octaves; ++i) {
+			const double n = config.NoiseType == noiseType::VALUE ? valueNoise3(f.x, f.y, f.z) : simplex3(f.x, f.y, f.z);
+			sum += n * amplitude;
+			f *= config.Lacunarity;
+			amplitude *= config.Persistence;
 		}
 		return sum;
 	}
 
+	/*
+		Batch sampling: fbm(), simplex() and valueNoise() again, over vectors of floats. Each Ops struct
+		wraps one instruction set's intrinsics, so the kernels are only written once. Permutation table
+		lookups are gathers on AVX2, and plain scalar loads on SSE4, which has no gather.
+
+		Floats run out of precision quickly far from the origin, and more so at higher octaves. So for
+		each octave, the lattice cell under the first point of a vector is found in double, and the
+		kernels work on integer cell indices relative to it, plus small float offsets from it.
+	*/
+
+#if defined(__AVX2__)
+	struct avx2Ops {
+		using F = __m256;
+		using I = __m256i;
+		constexpr static size_t WIDTH = 8;
+		static F set(const float v) { return _mm256_set1_ps(v); }
+		static I setI(const int32_t v) { return _mm256_set1_epi32(v); }
+		static F load(const float* src) { return _mm256_loadu_ps(src); }
+		static void store(float* dest, const F v) { _mm256_storeu_ps(dest, v); }
+		static F add(const F a, const F b) { return _mm256_add_ps(a, b); }
+		static F sub(const F a, const F b) { return _mm256_sub_ps(a, b); }
+		static F mul(const F a, const F b) { return _mm256_mul_ps(a, b); }
+		static F max(const F a, const F b) { return _mm256_max_ps(a, b); }
+		static F xorF(const F a, const F b) { return _mm256_xor_ps(a, b); }
+		// Lanes of "a" where "mask" is set, else of "b"
+		static F select(const F mask, const F a, const F b) { return _mm256_blendv_ps(b, a, mask); }
+		static F greater(const F a, const F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static F floor(const F v) { return _mm256_floor_ps(v); }
+		static I truncate(const F v) { return _mm256_cvttps_epi32(v); }
+		static F toFloat(const I v) { return _mm256_cvtepi32_ps(v); }
+		static F asFloat(const I v) { return _mm256_castsi256_ps(v); }
+		static I asInt(const F v) { return _mm256_castps_si256(v); }
+		static I addI(const I a, const I b) { return _mm256_add_epi32(a, b); }
+		static I subI(const I a, const I b) { return _mm256_sub_epi32(a, b); }
+		static I mulI(const I a, const I b) { return _mm256_mullo_epi32(a, b); }
+		static I andI(const I a, const I b) { return _mm256_and_si256(a, b); }
+		static I xorI(const I a, const I b) { return _mm256_xor_si256(a, b); }
+		static I absI(const I v) { return _mm256_abs_epi32(v); }
+		static I equalI(const I a, const I b) { return _mm256_cmpeq_epi32(a, b); }
+		template<int Shift>
+		static I shiftLeft(const I v) { return _mm256_slli_epi32(v, Shift); }
+		static I gather(const int32_t* table, const I idx) { return _mm256_i32gather_epi32(table, idx, 4); }
+	};
+#endif
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+	struct sse4Ops {
+		using F = __m128;
+		using I = __m128i;
+		constexpr static size_t WIDTH = 4;
+		static F set(const float v) { return _mm_set1_ps(v); }
+		static I setI(const int32_t v) { return _mm_set1_epi32(v); }
+		static F load(const float* src) { return _mm_loadu_ps(src); }
+		static void store(float* dest, const F v) { _mm_storeu_ps(dest, v); }
+		static F add(const F a, const F b) { return _mm_add_ps(a, b); }
+		static F sub(const F a, const F b) { return _mm_sub_ps(a, b); }
+		static F mul(const F a, const F b) { return _mm_mul_ps(a, b); }
+		static F max(const F a, const F b) { return _mm_max_ps(a, b); }
+		static F xorF(const F a, const F b) { return _mm_xor_ps(a, b); }
+		static F select(const F mask, const F a, const F b) { return _mm_blendv_ps(b, a, mask); }
+		static F greater(const F a, const F b) { return _mm_cmpgt_ps(a, b); }
+		static F floor(const F v) { return _mm_floor_ps(v); }
+		static I truncate(const F v) { return _mm_cvttps_epi32(v); }
+		static F toFloat(const I v) { return _mm_cvtepi32_ps(v); }
+		static F asFloat(const I v) { return _mm_castsi128_ps(v); }
+		static I asInt(const F v) { return _mm_castps_si128(v); }
+		static I addI(const I a, const I b) { return _mm_add_epi32(a, b); }
+		static I subI(const I a, const I b) { return _mm_sub_epi32(a, b); }
+		static I mulI(const I a, const I b) { return _mm_mullo_epi32(a, b); }
+		static I andI(const I a, const I b) { return _mm_and_si128(a, b); }
+		static I xorI(const I a, const I b) { return _mm_xor_si128(a, b); }
+		static I absI(const I v) { return _mm_abs_epi32(v); }
+		static I equalI(const I a, const I b) { return _mm_cmpeq_epi32(a, b); }
+		template<int Shift>
+		static I shiftLeft(const I v) { return _mm_slli_epi32(v, Shift); }
+		static I gather(const int32_t* table, const I idx) {
+			alignas(16) int32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), idx);
+			return _mm_setr_epi32(table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]]);
+		}
+	};
+#endif
+
+	template<typename Ops>
+	static inline typename Ops::F sGradV(const typename Ops::I hash, const typename Ops::F x, const typename Ops::F y) {
+		using F = typename Ops::F;
+		using I = typename Ops::I;
+		const I h = Ops::andI(hash, Ops::setI(7));
+		const F low = Ops::asFloat(Ops::equalI(Ops::andI(h, Ops::setI(4)), Ops::setI(0)));
+		const F u = Ops::select(low, x, y);
+		const F v = Ops::select(low, y, x);
+		// Bits 0 and 1 of h negate u and v: shift them up into the sign bit
+		const F u_sign = Ops::asFloat(Ops::template shiftLeft<31>(h));
+		const F v_sign = Ops::asFloat(Ops::template shiftLeft<30>(Ops::andI(h, Ops::setI(2))));
+		return Ops::add(Ops::xorF(u, u_sign), Ops::xorF(Ops::mul(v, Ops::set(2.0f)), v_sign));
+	}
+
+	constexpr static double SIMPLEX_F2 = 0.366025403;
+	constexpr static double SIMPLEX_G2 = 0.211324865;
+
+	// "x" and "y" are relative to the corner of skewed cell (base_i, base_j). Rounds coordinates on cell edges down rather than
+	// copying fastfloor(), which only differs at exact negative integers. "skew_error" is how far skewing that corner, using the
+	// rounded F2 and G2, lands from (base_i, base_j): simplex() skews absolute coordinates, and the hashes of its corners jump
+	// across cell edges at negative coordinates, so cells have to be picked exactly as it picks them.
+	template<typename Ops>
+	static inline typename Ops::F simplexV(const int32_t* perm, const int32_t base_i, const int32_t base_j, const float skew_error, const typename Ops::F x,
+		const typename Ops::F y) {
+		using F = typename Ops::F;
+		using I = typename Ops::I;
+		constexpr float F2 = static_cast<float>(SIMPLEX_F2);
+		constexpr float G2 = static_cast<float>(SIMPLEX_G2);
+
+		const F s = Ops::add(Ops::mul(Ops::add(x, y), Ops::set(F2)), Ops::set(skew_error));
+		const F cell_i = Ops::floor(Ops::add(x, s));
+		const F cell_j = Ops::floor(Ops::add(y, s));
+		const F t = Ops::mul(Ops::add(cell_i, cell_j), Ops::set(G2));
+		const F x0 = Ops::sub(x, Ops::sub(cell_i, t));
+		const F y0 = Ops::sub(y, Ops::sub(cell_j, t));
+		const I i = Ops::addI(Ops::setI(base_i), Ops::truncate(cell_i));
+		const I j = Ops::addI(Ops::setI(base_j), Ops::truncate(cell_j));
+
+		// (i1, j1) is (1, 0) in the lower triangle, where x0 > y0, else (0, 1)
+		const I i1 = Ops::andI(Ops::asInt(Ops::greater(x0, y0)), Ops::setI(1));
+		const I j1 = Ops::subI(Ops::setI(1), i1);
+		const F x1 = Ops::add(Ops::sub(x0, Ops::toFloat(i1)), Ops::set(G2));
+		const F y1 = Ops::add(Ops::sub(y0, Ops::toFloat(j1)), Ops::set(G2));
+		const F x2 = Ops::add(x0, Ops::set(-1.0f + 2.0f * G2));
+		const F y2 = Ops::add(y0, Ops::set(-1.0f + 2.0f * G2));
+
+		// abs(i % 256), as simplex() wraps them
+		const I ii = Ops::andI(Ops::absI(i), Ops::setI(255));
+		const I jj = Ops::andI(Ops::absI(j), Ops::setI(255));
+		const I one = Ops::setI(1);
+		const I h0 = Ops::gather(perm, Ops::addI(ii, Ops::gather(perm, jj)));
+		const I h1 = Ops::gather(perm, Ops::addI(Ops::addI(ii, i1), Ops::gather(perm, Ops::addI(jj, j1))));
+		const I h2 = Ops::gather(perm, Ops::addI(Ops::addI(ii, one), Ops::gather(perm, Ops::addI(jj, one))));
+
+		// Clamping t at 0 zeroes the contribution of corners out of range, as simplex() does
+		auto corner = [](const F cx, const F cy, const I h) {
+			F t = Ops::max(Ops::sub(Ops::sub(Ops::set(0.5f), Ops::mul(cx, cx)), Ops::mul(cy, cy)), Ops::set(0.0f));
+			t = Ops::mul(t, t);
+			return Ops::mul(Ops::mul(t, t), sGradV<Ops>(h, cx, cy));
+		};
+		const F sum = Ops::add(Ops::add(corner(x0, y0, h0), corner(x1, y1, h1)), corner(x2, y2, h2));
+		return Ops::mul(Ops::set(40.0f), sum);
+	}
+
+	// cos(a) for a in [0, 3.14], the range lerp() uses: sin(pi/2 - a), from its Taylor series to the 11th power
+	template<typename Ops>
+	static inline typename Ops::F cosV(const typename Ops::F a) {
+		using F = typename Ops::F;
+		const F b = Ops::sub(Ops::set(1.57079633f), a);
+		const F b2 = Ops::mul(b, b);
+		F p = Ops::set(-1.0f / 39916800.0f);
+		p = Ops::add(Ops::mul(p, b2), Ops::set(1.0f / 362880.0f));
+		p = Ops::add(Ops::mul(p, b2), Ops::set(-1.0f / 5040.0f));
+		p = Ops::add(Ops::mul(p, b2), Ops::set(1.0f / 120.0f));
+		p = Ops::add(Ops::mul(p, b2), Ops::set(-1.0f / 6.0f));
+		p = Ops::add(Ops::mul(p, b2), Ops::set(1.0f));
+		return Ops::mul(p, b);
+	}
+
+	template<typename Ops>
+	static inline typename Ops::F lerpV(const typename Ops::F a, const typename Ops::F b, const typename Ops::F z) {
+		using F = typename Ops::F;
+		const F mu2 = Ops::mul(Ops::sub(Ops::set(1.0f), cosV<Ops>(Ops::mul(z, Ops::set(3.14f)))), Ops::set(0.5f));
+		return Ops::add(Ops::mul(a, Ops::sub(Ops::set(1.0f), mu2)), Ops::mul(b, mu2));
+	}
+
+	// "x" and "z" are relative to the corner of cell (base_x, base_z). Rounds integral coordinates down, like simplexV(): they only
+	// differ from valueNoise() by how far cos(3.14) is from -1.
+	template<typename Ops>
+	static inline typename Ops::F valueNoiseV(const int32_t seed, const int32_t base_x, const int32_t base_z, const typename Ops::F x, const typename Ops::F z) {
+		using F = typename Ops::F;
+		using I = typename Ops::I;
+		// Integer maths wraps, as it does (on every compiler we use) in valueNoise()
+		auto noise_1 = [seed](I n) {
+			n = Ops::addI(n, Ops::setI(seed));
+			n = Ops::xorI(Ops::template shiftLeft<13>(n), n);
+			const I square_term = Ops::addI(Ops::mulI(Ops::mulI(n, n), Ops::setI(60493)), Ops::setI(19990303));
+			const I nn = Ops::andI(Ops::addI(Ops::mulI(n, square_term), Ops::setI(1376312589)), Ops::setI(0x7fffffff));
+			return Ops::sub(Ops::set(1.0f), Ops::mul(Ops::toFloat(nn), Ops::set(1.0f / 1073741824.0f)));
+		};
+
+		const F cell_x = Ops::floor(x);
+		const F cell_z = Ops::floor(z);
+		const I fx = Ops::addI(Ops::setI(base_x), Ops::truncate(cell_x));
+		const I fz = Ops::addI(Ops::setI(base_z), Ops::truncate(cell_z));
+		const I one = Ops::setI(1);
+		const I row0 = Ops::mulI(fz, Ops::setI(57));
+		const I row1 = Ops::mulI(Ops::addI(fz, one), Ops::setI(57));
+		const F s = noise_1(Ops::addI(fx, row0));
+		const F t = noise_1(Ops::addI(Ops::addI(fx, one), row0));
+		const F u = noise_1(Ops::addI(fx, row1));
+		const F v = noise_1(Ops::addI(Ops::addI(fx, one), row1));
+
+		const F dx = Ops::sub(x, cell_x);
+		const F dz = Ops::sub(z, cell_z);
+		return lerpV<Ops>(lerpV<Ops>(s, t, dx), lerpV<Ops>(u, v, dx), dz);
+	}
+
+	template<typename Ops>
+	void NoiseGenerator::sampleGrid(const double& x, const double& z, const double& step_x, const double& step_z, const size_t& count_x, const size_t& count_z,
+		float* dest, const size_t& stride) const {
+		using F = typename Ops::F;
+		constexpr size_t WIDTH = Ops::WIDTH;
+		const NoiseCfg& cfg = config;
+		const int32_t seed = static_cast<int32_t>(cfg.Seed);
+		const double frequency = cfg.Frequency;
+		double lane_x[WIDTH];
+		alignas(32) float offset_x[WIDTH];
+		alignas(32) float tail[WIDTH];
+
+		for (size_t j = 0; j < count_z; ++j) {
+			const double row_z = (z + static_cast<double>(j) * step_z) * frequency;
+			float* row = dest + j * stride;
+			for (size_t i = 0; i < count_x; i += WIDTH) {
+				for (size_t lane = 0; lane < WIDTH; ++lane) {
+					lane_x[lane] = (x + static_cast<double>(i + lane) * step_x) * frequency;
+				}
+
+				F sum = Ops::set(0.0f);
+				float amplitude = 1.0f;
+				double scale = 1.0;
+				for (size_t octave = 0; octave < cfg.Octaves; ++octave) {
+					const double first_x = lane_x[0] * scale;
+					const double octave_z = row_z * scale;
+					F n;
+					if (cfg.NoiseType == noiseType::VALUE) {
+						const double base_x = std::floor(first_x);
+						const double base_z = std::floor(octave_z);
+						for (size_t lane = 0; lane < WIDTH; ++lane) {
+							offset_x[lane] = static_cast<float>(lane_x[lane] * scale - base_x);
+						}
+						n = valueNoiseV<Ops>(seed, static_cast<int32_t>(base_x), static_cast<int32_t>(base_z), Ops::load(offset_x),
+							Ops::set(static_cast<float>(octave_z - base_z)));
+					}
+					else {
+						// Skewed cell of the first point, and its corner back in unskewed space
+						const double skew = (first_x + octave_z) * SIMPLEX_F2;
+						const double base_i = std::floor(first_x + skew);
+						const double base_j = std::floor(octave_z + skew);
+						const double unskew = (base_i + base_j) * SIMPLEX_G2;
+						const double corner_x = base_i - unskew;
+						const double corner_z = base_j - unskew;
+						const double skew_error = (base_i + base_j) * (SIMPLEX_F2 * (1.0 - 2.0 * SIMPLEX_G2) - SIMPLEX_G2);
+						for (size_t lane = 0; lane < WIDTH; ++lane) {
+							offset_x[lane] = static_cast<float>(lane_x[lane] * scale - corner_x);
+						}
+						n = simplexV<Ops>(permWide.data(), static_cast<int32_t>(base_i), static_cast<int32_t>(base_j), static_cast<float>(skew_error), Ops::load(offset_x),
+							Ops::set(static_cast<float>(octave_z - corner_z)));
+					}
+					sum = Ops::add(sum, Ops::mul(n, Ops::set(amplitude)));
+					amplitude *= cfg.Persistence;
+					scale *= cfg.Lacunarity;
+				}
+
+				if (count_x - i >= WIDTH) {
+					Ops::store(row + i, sum);
+				}
+				else {
+					Ops::store(tail, sum);
+					std::copy(tail, tail + (count_x - i), row + i);
+				}
+			}
+		}
+	}
+
+	void NoiseGenerator::SampleGrid(const double& x, const double& z, const double& step_x, const double& step_z, const size_t& count_x, const size_t& count_z,
+		float* dest, const size_t& stride, const simdLevel level) const {
+		if (config.FractalType != fractalType::FBM) {
+			// As Sample() does
+			for (size_t j = 0; j < count_z; ++j) {
+				std::fill(dest + j * stride, dest + j * stride + count_x, 0.0f);
+			}
+			return;
+		}
+
+		const simdLevel best = BestSimdLevel();
+		const simdLevel selected = (level == simdLevel::AUTO || level > best) ? best : level;
+		switch (selected) {
+#if defined(__AVX2__)
+		case simdLevel::AVX2:
+			sampleGrid<avx2Ops>(x, z, step_x, step_z, count_x, count_z, dest, stride);
+			return;
+#endif
+#if defined(__AVX2__) || defined(__SSE4_1__)
+		case simdLevel::SSE4:
+			sampleGrid<sse4Ops>(x, z, step_x, step_z, count_x, count_z, dest, stride);
+			return;
+#endif
+		default:
+			break;
+		}
+
+		for (size_t j = 0; j < count_z; ++j) {
+			float* row = dest + j * stride;
+			for (size_t i = 0; i < count_x; ++i) {
+				row[i] = Sample(x + static_cast<double>(i) * step_x, z + static_cast<double>(j) * step_z);
+			}
+		}
+	}
+
+	simdLevel NoiseGenerator::BestSimdLevel() noexcept {
+#if defined(__AVX2__)
+		return simdLevel::AVX2;
+#elif defined(__SSE4_1__)
+		return simdLevel::SSE4;
+#else
+		return simdLevel::SCALAR;
+#endif
+	}
 
-}
\ No newline at end of file
+}
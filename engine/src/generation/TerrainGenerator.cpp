@@ -0,0 +1,401 @@
+#include "generation/TerrainGenerator.hpp"
+#include "common/BlockTypes.hpp"
+#include "util/CommonUtil.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace terrain {
+
+	// Indices into GetPalette()
+	enum paletteEntry : uint16_t {
+		ENTRY_AIR,
+		ENTRY_BEDROCK,
+		ENTRY_STONE,
+		ENTRY_DIRT,
+		ENTRY_GRASS,
+		ENTRY_TALL_GRASS,
+		ENTRY_FIRST_FLOWER,
+	};
+
+	constexpr static BlockTypes FLOWERS[] = {
+		BlockTypes::YELLOW_FLOWER, BlockTypes::RED_FLOWER, BlockTypes::PURPLE_FLOWER,
+		BlockTypes::SUN_FLOWER, BlockTypes::WHITE_FLOWER, BlockTypes::BLUE_FLOWER
+	};
+	constexpr static size_t NUM_FLOWERS = sizeof(FLOWERS) / sizeof(FLOWERS[0]);
+
+	// Where flat terrain lies, with HEIGHT switched off
+	constexpr static uint8_t DEFAULT_HEIGHT = 64;
+	constexpr static uint8_t MAX_HEIGHT = static_cast<uint8_t>(CHUNK_SIZE_Y - 2);
+
+	static inline size_t stageIndex(const terrainStage stage) {
+		return static_cast<size_t>(stage);
+	}
+
+	static inline uint8_t toBlocks(const float& value, const int& min_value, const int& max_value) {
+		return static_cast<uint8_t>(std::min(std::max(static_cast<int>(std::lround(value)), min_value), max_value));
+	}
+
+	// Integer hash of a world column, for placing decorations
+	static inline uint32_t hashColumn(const int32_t& x, const int32_t& z, const uint32_t& seed) {
+		uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(z) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// Mixes "value" into a 32 bit FNV-1a hash, a byte at a time
+	template<typename T>
+	static inline void hashValue(uint32_t& hash, const T& value) {
+		unsigned char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		for (const unsigned char byte : bytes) {
+			hash = (hash ^ byte) * 16777619u;
+		}
+	}
+
+	static inline void hashSampler(uint32_t& hash, const TerrainSampler& sampler) {
+		// Field by field, so padding doesn't end up in the hash, and widened so 32 and 64 bit builds agree
+		hashValue(hash, sampler.Noise.Frequency);
+		hashValue(hash, sampler.Noise.Lacunarity);
+		hashValue(hash, sampler.Noise.Persistence);
+		hashValue(hash, static_cast<uint64_t>(sampler.Noise.Octaves));
+		hashValue(hash, static_cast<uint64_t>(sampler.Noise.Seed));
+		hashValue(hash, static_cast<uint32_t>(sampler.Noise.FractalType));
+		hashValue(hash, static_cast<uint32_t>(sampler.Noise.NoiseType));
+		hashValue(hash, sampler.Min);
+		hashValue(hash, sampler.Max);
+	}
+
+	TerrainGenerator::TerrainGenerator(const TerrainCfg& _cfg) : cfg(_cfg), heightBase(_cfg.HeightBase.Noise), heightScale(_cfg.HeightScale.Noise),
+		soilDepth(_cfg.SoilDepth.Noise), grassDepth(_cfg.GrassDepth.Noise), caveStart(_cfg.CaveStart.Noise), caveEnd(_cfg.CaveEnd.Noise),
+		caveWalkVariance(_cfg.CaveWalkVariance.Noise) {
+		stageEnabled.fill(true);
+		stageCached.fill(false);
+	}
+
+	void TerrainGenerator::Generate(ChunkComponent& chunk) const {
+		// Per thread, as chunks may be generated on worker threads
+		thread_local TerrainScratch scratch;
+		RunStages(chunk.GridPosition, scratch);
+		const std::vector<BlockComponent>& palette = GetPalette();
+		chunk.Blocks.ImportEntries(palette.data(), palette.size(), scratch.Entries.data());
+	}
+
+	void TerrainGenerator::RunStages(const glm::ivec2& grid_position, TerrainScratch& scratch) const {
+		scratch.GridPosition = grid_position;
+		scratch.Height.fill(DEFAULT_HEIGHT);
+		scratch.SoilDepth.fill(3);
+		scratch.GrassDepth.fill(1);
+		scratch.CaveFloor.fill(0);
+		scratch.CaveCeiling.fill(0);
+		if (!stageEnabled[stageIndex(terrainStage::STRATA)]) {
+			std::fill(scratch.Entries.begin(), scratch.Entries.end(), uint16_t(ENTRY_AIR));
+		}
+
+		for (size_t i = 0; i < STAGE_COUNT; ++i) {
+			if (stageEnabled[i]) {
+				runStage(static_cast<terrainStage>(i), scratch);
+			}
+		}
+	}
+
+	void TerrainGenerator::SetStageEnabled(const terrainStage stage, const bool enabled) {
+		stageEnabled[stageIndex(stage)] = enabled;
+	}
+
+	void TerrainGenerator::SetStageCached(const terrainStage stage, const bool cached) {
+		if (stage != terrainStage::HEIGHT && stage != terrainStage::CAVES) {
+			throw std::invalid_argument("Only the HEIGHT and CAVES terrain stages can be cached");
+		}
+		stageCached[stageIndex(stage)] = cached;
+		if (!cached) {
+			stageCache& cache = caches[stageIndex(stage)];
+			std::lock_guard<std::mutex> guard(cache.Mutex);
+			cache.Entries.clear();
+			cache.Order.clear();
+		}
+	}
+
+	bool TerrainGenerator::StageEnabled(const terrainStage stage) const noexcept {
+		return stageEnabled[stageIndex(stage)];
+	}
+
+	bool TerrainGenerator::StageCached(const terrainStage stage) const noexcept {
+		return stageCached[stageIndex(stage)];
+	}
+
+	uint32_t TerrainGenerator::GetVersion() const noexcept {
+		uint32_t hash = 2166136261u;
+		hashValue(hash, VERSION);
+		for (const TerrainSampler* sampler : { &cfg.HeightBase, &cfg.HeightScale, &cfg.SoilDepth, &cfg.GrassDepth, &cfg.CaveStart, &cfg.CaveEnd, &cfg.CaveWalkVariance }) {
+			hashSampler(hash, *sampler);
+		}
+		hashValue(hash, cfg.DecorationSeed);
+		hashValue(hash, cfg.TallGrassChance);
+		hashValue(hash, cfg.FlowerChance);
+		// CacheCapacity doesn't change the terrain, but switching stages on or off does
+		for (const bool enabled : stageEnabled) {
+			hashValue(hash, static_cast<uint8_t>(enabled));
+		}
+		// Heights come from SampleGrid(), whose SIMD kernels only match the scalar path to about 1e-5: enough to round a
+		// column's height the other way. Builds using different kernels don't produce the same terrain.
+		hashValue(hash, static_cast<uint32_t>(noise::NoiseGenerator::BestSimdLevel()));
+		// UINT32_MAX marks saved chunks that aren't deltas (ChunkSerializer::NO_BASELINE)
+		return hash != UINT32_MAX ? hash : hash - 1u;
+	}
+
+	TerrainStageStats TerrainGenerator::GetStageStats(const terrainStage stage) const {
+		const stageCounters& stage_counters = counters[stageIndex(stage)];
+		TerrainStageStats stats;
+		stats.Runs = stage_counters.Runs.load(std::memory_order_relaxed);
+		stats.CacheHits = stage_counters.CacheHits.load(std::memory_order_relaxed);
+		stats.TotalTimeMs = static_cast<double>(stage_counters.Nanoseconds.load(std::memory_order_relaxed)) * 1.0e-6;
+		return stats;
+	}
+
+	void TerrainGenerator::ResetStageStats() {
+		for (stageCounters& stage_counters : counters) {
+			stage_counters.Runs = 0;
+			stage_counters.CacheHits = 0;
+			stage_counters.Nanoseconds = 0;
+		}
+	}
+
+	const std::vector<BlockComponent>& TerrainGenerator::GetPalette() {
+		static const std::vector<BlockComponent> palette = []() {
+			std::vector<BlockComponent> result(ENTRY_FIRST_FLOWER + NUM_FLOWERS);
+			result[ENTRY_AIR].Type = static_cast<uint16_t>(BlockTypes::AIR);
+			result[ENTRY_BEDROCK].Type = static_cast<uint16_t>(BlockTypes::BEDROCK);
+			result[ENTRY_STONE].Type = static_cast<uint16_t>(BlockTypes::STONE);
+			result[ENTRY_DIRT].Type = static_cast<uint16_t>(BlockTypes::DIRT);
+			result[ENTRY_GRASS].Type = static_cast<uint16_t>(BlockTypes::GRASS);
+			result[ENTRY_TALL_GRASS].Type = static_cast<uint16_t>(BlockTypes::TALL_GRASS);
+			for (size_t i = 0; i < NUM_FLOWERS; ++i) {
+				result[ENTRY_FIRST_FLOWER + i].Type = static_cast<uint16_t>(FLOWERS[i]);
+			}
+			return result;
+		}();
+		return palette;
+	}
+
+	void TerrainGenerator::runStage(const terrainStage stage, TerrainScratch& scratch) const {
+		const auto start = std::chrono::high_resolution_clock::now();
+		bool cache_hit = false;
+		switch (stage) {
+		case terrainStage::HEIGHT:
+			cache_hit = runHeight(scratch);
+			break;
+		case terrainStage::STRATA:
+			runStrata(scratch);
+			break;
+		case terrainStage::CAVES:
+			cache_hit = runCaves(scratch);
+			break;
+		case terrainStage::DECORATION:
+			runDecoration(scratch);
+			break;
+		default:
+			break;
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		stageCounters& stage_counters = counters[stageIndex(stage)];
+		++stage_counters.Runs;
+		if (cache_hit) {
+			++stage_counters.CacheHits;
+		}
+		stage_counters.Nanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+
+	bool TerrainGenerator::runHeight(TerrainScratch& scratch) const {
+		if (fetchCached(terrainStage::HEIGHT, scratch)) {
+			return true;
+		}
+
+		float* base = scratch.Samples[0].data();
+		float* hills = scratch.Samples[1].data();
+		sampleColumns(heightBase, cfg.HeightBase, scratch.GridPosition, base);
+		sampleColumns(heightScale, cfg.HeightScale, scratch.GridPosition, hills);
+		for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+			scratch.Height[i] = toBlocks(base[i] + hills[i], 1, MAX_HEIGHT);
+		}
+
+		sampleColumns(soilDepth, cfg.SoilDepth, scratch.GridPosition, base);
+		sampleColumns(grassDepth, cfg.GrassDepth, scratch.GridPosition, hills);
+		for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+			scratch.SoilDepth[i] = toBlocks(base[i], 1, MAX_HEIGHT);
+			// Grass is the top of the soil, not laid over it
+			scratch.GrassDepth[i] = toBlocks(hills[i], 0, scratch.SoilDepth[i]);
+		}
+
+		storeCached(terrainStage::HEIGHT, scratch);
+		return false;
+	}
+
+	void TerrainGenerator::runStrata(TerrainScratch& scratch) const {
+		// A layer at a time, as layers are contiguous in GetBlockIndex() order
+		const uint8_t max_height = *std::max_element(scratch.Height.begin(), scratch.Height.end());
+		for (size_t y = 0; y < CHUNK_SIZE_Y; ++y) {
+			uint16_t* layer = scratch.Entries.data() + GetBlockIndex(0, y, 0);
+			if (y > max_height) {
+				std::fill(layer, layer + COLUMNS_PER_CHUNK, uint16_t(ENTRY_AIR));
+				continue;
+			}
+			const int layer_y = static_cast<int>(y);
+			for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+				// Depth below the surface block, which is depth 0
+				const int depth = static_cast<int>(scratch.Height[i]) - layer_y;
+				uint16_t entry = ENTRY_STONE;
+				entry = depth < scratch.SoilDepth[i] ? uint16_t(ENTRY_DIRT) : entry;
+				entry = depth < scratch.GrassDepth[i] ? uint16_t(ENTRY_GRASS) : entry;
+				entry = depth < 0 ? uint16_t(ENTRY_AIR) : entry;
+				layer[i] = entry;
+			}
+		}
+		std::fill(scratch.Entries.begin(), scratch.Entries.begin() + COLUMNS_PER_CHUNK, uint16_t(ENTRY_BEDROCK));
+	}
+
+	bool TerrainGenerator::runCaves(TerrainScratch& scratch) const {
+		const bool cache_hit = fetchCached(terrainStage::CAVES, scratch);
+		if (!cache_hit) {
+			float* floor = scratch.Samples[0].data();
+			float* samples = scratch.Samples[1].data();
+			sampleColumns(caveStart, cfg.CaveStart, scratch.GridPosition, floor);
+			sampleColumns(caveWalkVariance, cfg.CaveWalkVariance, scratch.GridPosition, samples);
+			for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+				floor[i] += samples[i];
+			}
+			// The ceiling is measured from the wobbled floor, so it wobbles along with it
+			sampleColumns(caveEnd, cfg.CaveEnd, scratch.GridPosition, samples);
+			for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+				scratch.CaveFloor[i] = toBlocks(floor[i], 1, MAX_HEIGHT);
+				scratch.CaveCeiling[i] = samples[i] >= 1.0f ? toBlocks(floor[i] + samples[i], 1, MAX_HEIGHT) : uint8_t(0);
+			}
+			storeCached(terrainStage::CAVES, scratch);
+		}
+
+		// Cached floors and ceilings don't depend on the surface, so keep caves under the soil here
+		uint8_t min_floor = MAX_HEIGHT;
+		uint8_t max_ceiling = 0;
+		std::array<uint8_t, COLUMNS_PER_CHUNK> ceilings;
+		for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+			const int below_soil = static_cast<int>(scratch.Height[i]) - static_cast<int>(scratch.SoilDepth[i]) + 1;
+			ceilings[i] = static_cast<uint8_t>(std::min<int>(scratch.CaveCeiling[i], std::max(below_soil, 0)));
+			if (ceilings[i] > scratch.CaveFloor[i]) {
+				min_floor = std::min(min_floor, scratch.CaveFloor[i]);
+				max_ceiling = std::max(max_ceiling, ceilings[i]);
+			}
+		}
+
+		for (size_t y = min_floor; y < max_ceiling; ++y) {
+			uint16_t* layer = scratch.Entries.data() + GetBlockIndex(0, y, 0);
+			for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+				layer[i] = (y >= scratch.CaveFloor[i] && y < ceilings[i]) ? uint16_t(ENTRY_AIR) : layer[i];
+			}
+		}
+		return cache_hit;
+	}
+
+	void TerrainGenerator::runDecoration(TerrainScratch& scratch) const {
+		const uint32_t seed = cfg.DecorationSeed;
+		const int32_t origin_x = scratch.GridPosition.x * static_cast<int32_t>(CHUNK_SIZE);
+		const int32_t origin_z = scratch.GridPosition.y * static_cast<int32_t>(CHUNK_SIZE);
+		// Chances as thresholds on the top 24 bits of the hash
+		const uint32_t flower_threshold = static_cast<uint32_t>(cfg.FlowerChance * 16777216.0f);
+		const uint32_t grass_threshold = flower_threshold + static_cast<uint32_t>(cfg.TallGrassChance * 16777216.0f);
+
+		for (size_t x = 0; x < CHUNK_SIZE; ++x) {
+			for (size_t z = 0; z < CHUNK_SIZE; ++z) {
+				const size_t y = scratch.Height[x * CHUNK_SIZE + z];
+				if (y + 1 >= CHUNK_SIZE_Y) {
+					continue;
+				}
+				uint16_t& surface = scratch.Entries[GetBlockIndex(x, y, z)];
+				uint16_t& above = scratch.Entries[GetBlockIndex(x, y + 1, z)];
+				if (surface != ENTRY_GRASS || above != ENTRY_AIR) {
+					continue;
+				}
+				const uint32_t hash = hashColumn(origin_x + static_cast<int32_t>(x), origin_z + static_cast<int32_t>(z), seed);
+				const uint32_t roll = hash >> 8;
+				if (roll < flower_threshold) {
+					above = static_cast<uint16_t>(ENTRY_FIRST_FLOWER + (hash & 0xff) % NUM_FLOWERS);
+				}
+				else if (roll < grass_threshold) {
+					above = ENTRY_TALL_GRASS;
+				}
+			}
+		}
+	}
+
+	void TerrainGenerator::sampleColumns(const noise::NoiseGenerator& noise, const TerrainSampler& sampler, const glm::ivec2& grid_position, float* dest) const {
+		const double x = static_cast<double>(grid_position.x) * static_cast<double>(CHUNK_SIZE);
+		const double z = static_cast<double>(grid_position.y) * static_cast<double>(CHUNK_SIZE);
+		// SampleGrid() writes rows along its first axis, so pass z first to get columns in x * CHUNK_SIZE + z order. The noise
+		// doesn't favour either axis, so this is just as good a field.
+		noise.SampleGrid(z, x, 1.0, 1.0, CHUNK_SIZE, CHUNK_SIZE, dest, CHUNK_SIZE);
+		// fBm noise mostly lies within [-2, 2]
+		const float range = sampler.Max - sampler.Min;
+		for (size_t i = 0; i < COLUMNS_PER_CHUNK; ++i) {
+			const float t = std::min(std::max(dest[i] * 0.25f + 0.5f, 0.0f), 1.0f);
+			dest[i] = sampler.Min + range * t;
+		}
+	}
+
+	std::vector<uint8_t*> TerrainGenerator::stageOutputs(const terrainStage stage, TerrainScratch& scratch) {
+		switch (stage) {
+		case terrainStage::HEIGHT:
+			return { scratch.Height.data(), scratch.SoilDepth.data(), scratch.GrassDepth.data() };
+		case terrainStage::CAVES:
+			return { scratch.CaveFloor.data(), scratch.CaveCeiling.data() };
+		default:
+			return {};
+		}
+	}
+
+	bool TerrainGenerator::fetchCached(const terrainStage stage, TerrainScratch& scratch) const {
+		if (!stageCached[stageIndex(stage)]) {
+			return false;
+		}
+		stageCache& cache = caches[stageIndex(stage)];
+		std::lock_guard<std::mutex> guard(cache.Mutex);
+		auto iter = cache.Entries.find(scratch.GridPosition);
+		if (iter == cache.Entries.end()) {
+			return false;
+		}
+		const std::vector<uint8_t*> outputs = stageOutputs(stage, scratch);
+		for (size_t i = 0; i < outputs.size(); ++i) {
+			std::copy_n(iter->second.data() + i * COLUMNS_PER_CHUNK, COLUMNS_PER_CHUNK, outputs[i]);
+		}
+		return true;
+	}
+
+	void TerrainGenerator::storeCached(const terrainStage stage, TerrainScratch& scratch) const {
+		if (!stageCached[stageIndex(stage)] || cfg.CacheCapacity == 0) {
+			return;
+		}
+		const std::vector<uint8_t*> outputs = stageOutputs(stage, scratch);
+		std::vector<uint8_t> entry(outputs.size() * COLUMNS_PER_CHUNK);
+		for (size_t i = 0; i < outputs.size(); ++i) {
+			std::copy_n(outputs[i], COLUMNS_PER_CHUNK, entry.data() + i * COLUMNS_PER_CHUNK);
+		}
+
+		stageCache& cache = caches[stageIndex(stage)];
+		std::lock_guard<std::mutex> guard(cache.Mutex);
+		// Another thread may have generated the same chunk in the meantime
+		if (!cache.Entries.emplace(scratch.GridPosition, std::move(entry)).second) {
+			return;
+		}
+		cache.Order.push_back(scratch.GridPosition);
+		while (cache.Order.size() > cfg.CacheCapacity) {
+			cache.Entries.erase(cache.Order.front());
+			cache.Order.pop_front();
+		}
+	}
+
+}
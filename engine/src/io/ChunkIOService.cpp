@@ -0,0 +1,246 @@
+#include "io/ChunkIOService.hpp"
+#include <algorithm>
+
+ChunkIOService::ChunkIOService(const std::string& directory, TerrainBaseline baseline, const size_t max_queued, const size_t max_batch) :
+    store(directory, std::move(baseline)), maxQueued(std::max<size_t>(max_queued, 1)), maxBatch(std::max<size_t>(max_batch, 1)) {
+    // Started last, so the thread never sees a member that hasn't been constructed yet
+    ioThread = std::thread(&ChunkIOService::ioThreadFunction, this);
+}
+
+ChunkIOService::~ChunkIOService() {
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        shutdown = true;
+    }
+    cVar.notify_all();
+    if (ioThread.joinable()) {
+        ioThread.join();
+    }
+}
+
+bool ChunkIOService::Save(ChunkComponent& chunk) {
+    const glm::ivec2 grid_position = chunk.GridPosition;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        auto iter = writes.find(grid_position);
+        if (iter != writes.end()) {
+            // Keeps its place in writeOrder, so a chunk saved over and over still gets written
+            iter->second = std::move(chunk);
+            ++coalescedWrites;
+            return true;
+        }
+        if (queuedRequests() >= maxQueued) {
+            return false;
+        }
+        writes.emplace(grid_position, std::move(chunk));
+        writeOrder.push_back(grid_position);
+    }
+    cVar.notify_one();
+    return true;
+}
+
+bool ChunkIOService::Load(const glm::ivec2& grid_position) {
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        auto iter = writes.find(grid_position);
+        if (iter != writes.end()) {
+            // Newer than anything on disk. The write stays queued: the copy handed out may be dropped unused.
+            completed.push(loadResult{ grid_position, ChunkLoadStatus::Loaded, iter->second });
+            return true;
+        }
+        if (queuedRequests() >= maxQueued) {
+            return false;
+        }
+        reads.push_back(grid_position);
+        ++pendingReads;
+    }
+    cVar.notify_one();
+    return true;
+}
+
+void ChunkIOService::Prefetch(const glm::ivec2& grid_position) {
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        if (queuedRequests() >= maxQueued || writes.count(grid_position) != 0) {
+            return;
+        }
+        prefetches.push_back(grid_position);
+    }
+    cVar.notify_one();
+}
+
+void ChunkIOService::SetStatsCallback(std::function<void(const ChunkIOStats&)> callback) {
+    statsCallback = std::move(callback);
+}
+
+ChunkIOStats ChunkIOService::GetStats() const {
+    ChunkIOStats stats;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        stats.QueuedReads = reads.size();
+        stats.QueuedWrites = writes.size();
+    }
+    stats.CoalescedWrites = coalescedWrites.load(std::memory_order_relaxed);
+    stats.ChunksRead = chunksRead.load(std::memory_order_relaxed);
+    stats.ChunksWritten = chunksWritten.load(std::memory_order_relaxed);
+    stats.BytesRead = bytesRead.load(std::memory_order_relaxed);
+    stats.BytesWritten = bytesWritten.load(std::memory_order_relaxed);
+    stats.Errors = errors.load(std::memory_order_relaxed);
+    stats.IncompatibleChunks = incompatibleChunks.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ChunkIOService::WaitIdle() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idleCVar.wait(lock, [this]()->bool { return !busy && queuedRequests() == 0; });
+}
+
+void ChunkIOService::ioThreadFunction() {
+    std::vector<ChunkComponent> batch;
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        busy = false;
+        if (queuedRequests() == 0) {
+            idleCVar.notify_all();
+        }
+        cVar.wait(lock, [this]()->bool { return shutdown || queuedRequests() != 0; });
+
+        // Only leave once every queued save has been written
+        if (queuedRequests() == 0) {
+            return;
+        }
+        busy = true;
+
+        if (!reads.empty() || !prefetches.empty()) {
+            lock.unlock();
+            serviceReads(span_t<const ChunkComponent>());
+            continue;
+        }
+
+        batch.clear();
+        const size_t batch_size = std::min(maxBatch, writeOrder.size());
+        for (size_t i = 0; i < batch_size; ++i) {
+            auto iter = writes.find(writeOrder.front());
+            writeOrder.pop_front();
+            batch.emplace_back(std::move(iter->second));
+            writes.erase(iter);
+        }
+        lock.unlock();
+
+        writeBatch(batch);
+    }
+}
+
+void ChunkIOService::serviceReads(const span_t<const ChunkComponent> unwritten) {
+    std::vector<glm::ivec2> read_positions;
+    std::vector<glm::ivec2> prefetch_positions;
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        read_positions.assign(reads.begin(), reads.end());
+        prefetch_positions.assign(prefetches.begin(), prefetches.end());
+        reads.clear();
+        prefetches.clear();
+        pendingReads = 0;
+    }
+
+    for (const glm::ivec2& grid_position : read_positions) {
+        loadResult result{ grid_position, ChunkLoadStatus::NotSaved, ChunkComponent() };
+        // Chunks taken off the queue by the batch being written, but not written yet, aren't on disk
+        auto queued = std::find_if(unwritten.begin(), unwritten.end(), [&grid_position](const ChunkComponent& chunk) {
+            return chunk.GridPosition == grid_position;
+        });
+        if (queued != unwritten.end()) {
+            result.Chunk = *queued;
+            result.Status = ChunkLoadStatus::Loaded;
+        }
+        else {
+            result.Chunk.GridPosition = grid_position;
+            try {
+                result.Status = store.LoadChunk(result.Chunk);
+            }
+            catch (...) {
+                // The file couldn't be read, which says nothing about the copy in it
+                result.Status = ChunkLoadStatus::Failed;
+            }
+        }
+        if (result.Status == ChunkLoadStatus::Loaded) {
+            ++chunksRead;
+        }
+        else if (result.Status == ChunkLoadStatus::Incompatible) {
+            ++incompatibleChunks;
+        }
+        else if (result.Status == ChunkLoadStatus::Corrupt || result.Status == ChunkLoadStatus::Failed) {
+            ++errors;
+        }
+        completed.push(std::move(result));
+    }
+
+    // After the reads, which something is already waiting for
+    for (const glm::ivec2& grid_position : prefetch_positions) {
+        try {
+            store.PrefetchChunk(grid_position);
+        }
+        catch (...) {
+            ++errors;
+        }
+    }
+
+    bytesRead.store(store.BytesRead(), std::memory_order_relaxed);
+}
+
+void ChunkIOService::writeBatch(std::vector<ChunkComponent>& batch) {
+    // Group by region file, then in table order, so each file is visited once and mostly written front to back
+    std::sort(batch.begin(), batch.end(), [](const ChunkComponent& lhs, const ChunkComponent& rhs) {
+        const glm::ivec2 lhs_region = RegionFile::GetRegionCoord(lhs.GridPosition);
+        const glm::ivec2 rhs_region = RegionFile::GetRegionCoord(rhs.GridPosition);
+        if (lhs_region.x != rhs_region.x) {
+            return lhs_region.x < rhs_region.x;
+        }
+        if (lhs_region.y != rhs_region.y) {
+            return lhs_region.y < rhs_region.y;
+        }
+        return RegionFile::GetTableIndex(RegionFile::GetLocalCoord(lhs.GridPosition)) < RegionFile::GetTableIndex(RegionFile::GetLocalCoord(rhs.GridPosition));
+    });
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (pendingReads.load(std::memory_order_relaxed) != 0) {
+            serviceReads(span_t<const ChunkComponent>(batch.data() + i, batch.size() - i));
+        }
+        try {
+            if (store.SaveChunk(batch[i])) {
+                ++chunksWritten;
+            }
+            else {
+                ++incompatibleChunks;
+            }
+        }
+        catch (...) {
+            ++errors;
+        }
+    }
+    store.Flush();
+
+    bytesWritten.store(store.BytesWritten(), std::memory_order_relaxed);
+}
+
+size_t ChunkIOService::queuedRequests() const noexcept {
+    return reads.size() + prefetches.size() + writes.size();
+}
+
+void ChunkIOService::reportStats() {
+    if (!statsCallback) {
+        return;
+    }
+    ChunkIOStats stats = GetStats();
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - lastReport).count();
+    if (elapsed > 0.0) {
+        stats.ReadBytesPerSecond = static_cast<double>(stats.BytesRead - lastBytesRead) / elapsed;
+        stats.WriteBytesPerSecond = static_cast<double>(stats.BytesWritten - lastBytesWritten) / elapsed;
+    }
+    lastReport = now;
+    lastBytesRead = stats.BytesRead;
+    lastBytesWritten = stats.BytesWritten;
+    statsCallback(stats);
+}
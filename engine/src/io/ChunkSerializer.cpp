@@ -0,0 +1,207 @@
+#include "io/ChunkSerializer.hpp"
+#include "util/rle.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static_assert(sizeof(BlockComponent) == 4, "Chunk payload format assumes 4 byte BlockComponents");
+static_assert(sizeof(ChunkSerializer::payload_header_t) == 16, "Chunk payload header size changed");
+
+using entry_codec_t = rle_system<uint16_t>;
+
+// Per-thread scratch space, as chunks may be saved from worker threads
+struct serializer_scratch_t {
+    std::vector<uint16_t> Entries = std::vector<uint16_t>(BLOCKS_PER_CHUNK);
+    std::vector<BlockComponent> Palette;
+    // Only used for delta payloads
+    std::vector<uint16_t> BaselineEntries;
+    std::vector<BlockComponent> BaselinePalette;
+};
+
+static serializer_scratch_t& getScratch() {
+    thread_local serializer_scratch_t scratch;
+    return scratch;
+}
+
+// Header, generator version for delta payloads, palette, then the encoded entries
+static void writePayload(const uint16_t flags, const uint32_t generator_version, const std::vector<BlockComponent>& palette, const uint16_t* entries,
+    std::vector<uint8_t>& payload) {
+    const size_t prefix_bytes = sizeof(ChunkSerializer::payload_header_t) + ((flags & ChunkSerializer::FLAG_DELTA) ? sizeof(uint32_t) : 0);
+    const size_t palette_bytes = palette.size() * sizeof(BlockComponent);
+    const size_t max_encoded = entry_codec_t::max_encoded_size(BLOCKS_PER_CHUNK);
+    payload.resize(prefix_bytes + palette_bytes + max_encoded * sizeof(uint16_t));
+
+    // Encode straight into the payload: its data is suitably aligned for uint16_t, and so are the offsets into it
+    uint16_t* encoded = reinterpret_cast<uint16_t*>(payload.data() + prefix_bytes + palette_bytes);
+    const size_t encoded_size = entry_codec_t::encode(span_t<const uint16_t>(entries, BLOCKS_PER_CHUNK), span_t<uint16_t>(encoded, max_encoded));
+
+    ChunkSerializer::payload_header_t header{ ChunkSerializer::MAGIC, ChunkSerializer::VERSION, flags, static_cast<uint32_t>(palette.size()),
+        static_cast<uint32_t>(encoded_size) };
+    std::memcpy(payload.data(), &header, sizeof(header));
+    if (flags & ChunkSerializer::FLAG_DELTA) {
+        std::memcpy(payload.data() + sizeof(header), &generator_version, sizeof(generator_version));
+    }
+    if (palette_bytes != 0) {
+        std::memcpy(payload.data() + prefix_bytes, palette.data(), palette_bytes);
+    }
+    payload.resize(prefix_bytes + palette_bytes + encoded_size * sizeof(uint16_t));
+}
+
+static ChunkSerializer::payload_header_t readHeader(const span_t<const uint8_t> payload) {
+    ChunkSerializer::payload_header_t header;
+    if (payload.size() < sizeof(header)) {
+        throw std::runtime_error("Chunk payload is truncated");
+    }
+    std::memcpy(&header, payload.data(), sizeof(header));
+    if (header.Magic != ChunkSerializer::MAGIC || header.Version != ChunkSerializer::VERSION || (header.Flags & ~ChunkSerializer::FLAG_DELTA) != 0) {
+        throw std::runtime_error("Chunk payload has an unknown format or version");
+    }
+    return header;
+}
+
+void ChunkSerializer::Serialize(const ChunkComponent& chunk, std::vector<uint8_t>& payload) {
+    serializer_scratch_t& scratch = getScratch();
+    chunk.Blocks.ExportEntries(scratch.Palette, scratch.Entries.data());
+    writePayload(0, 0, scratch.Palette, scratch.Entries.data(), payload);
+}
+
+void ChunkSerializer::SerializeDelta(const ChunkComponent& chunk, const ChunkComponent& baseline, const uint32_t generator_version, std::vector<uint8_t>& payload) {
+    serializer_scratch_t& scratch = getScratch();
+    scratch.BaselineEntries.resize(BLOCKS_PER_CHUNK);
+    chunk.Blocks.ExportEntries(scratch.Palette, scratch.Entries.data());
+    // Delta entries are one more than a palette index, so a full palette's last entry wouldn't fit in 16 bits
+    if (scratch.Palette.size() >= ChunkBlockStorage<>::MAX_PALETTE_SIZE) {
+        writePayload(0, 0, scratch.Palette, scratch.Entries.data(), payload);
+        return;
+    }
+    baseline.Blocks.ExportEntries(scratch.BaselinePalette, scratch.BaselineEntries.data());
+
+    // Baseline entry holding the same block as each chunk entry, or one no baseline block has. Both palettes are
+    // short for generated terrain, so a linear search is fine.
+    std::vector<uint32_t> to_baseline(scratch.Palette.size(), UINT32_MAX);
+    for (size_t i = 0; i < scratch.Palette.size(); ++i) {
+        auto iter = std::find(scratch.BaselinePalette.begin(), scratch.BaselinePalette.end(), scratch.Palette[i]);
+        if (iter != scratch.BaselinePalette.end()) {
+            to_baseline[i] = static_cast<uint32_t>(iter - scratch.BaselinePalette.begin());
+        }
+    }
+
+    // First as one more than the block's index into the chunk's palette, for changed blocks. Kept branchless: a
+    // read-modify-write of a per-entry flag here would chain every block onto the previous one's store.
+    uint16_t* entries = scratch.Entries.data();
+    const uint16_t* baseline_entries = scratch.BaselineEntries.data();
+    size_t num_changed = 0;
+    for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+        const bool changed = to_baseline[entries[i]] != baseline_entries[i];
+        num_changed += changed;
+        entries[i] = changed ? static_cast<uint16_t>(entries[i] + 1) : uint16_t(0);
+    }
+
+    // Mostly changed: a full payload is smaller
+    if (num_changed * 2 >= BLOCKS_PER_CHUNK) {
+        chunk.Blocks.ExportEntries(scratch.Palette, entries);
+        writePayload(0, 0, scratch.Palette, entries, payload);
+        return;
+    }
+
+    // Shrink the palette to the entries changed blocks use
+    std::vector<uint16_t> to_delta(scratch.Palette.size() + 1, 0);
+    for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+        if (entries[i] != 0) {
+            to_delta[entries[i]] = 1;
+        }
+    }
+    std::vector<BlockComponent>& delta_palette = scratch.BaselinePalette;
+    delta_palette.clear();
+    for (size_t i = 0; i < scratch.Palette.size(); ++i) {
+        if (to_delta[i + 1] != 0) {
+            delta_palette.push_back(scratch.Palette[i]);
+            to_delta[i + 1] = static_cast<uint16_t>(delta_palette.size());
+        }
+    }
+    if (delta_palette.size() != scratch.Palette.size()) {
+        for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+            entries[i] = to_delta[entries[i]];
+        }
+    }
+
+    writePayload(FLAG_DELTA, generator_version, delta_palette, entries, payload);
+}
+
+void ChunkSerializer::Deserialize(const span_t<const uint8_t> payload, ChunkComponent& chunk) {
+    const payload_header_t header = readHeader(payload);
+    const bool delta = (header.Flags & FLAG_DELTA) != 0;
+    const size_t prefix_bytes = sizeof(header) + (delta ? sizeof(uint32_t) : 0);
+    const size_t palette_bytes = size_t(header.PaletteSize) * sizeof(BlockComponent);
+    if (payload.size() != prefix_bytes + palette_bytes + size_t(header.EncodedSize) * sizeof(uint16_t)) {
+        throw std::runtime_error("Chunk payload size doesn't match its header");
+    }
+
+    serializer_scratch_t& scratch = getScratch();
+    scratch.Palette.resize(header.PaletteSize);
+    if (palette_bytes != 0) {
+        std::memcpy(scratch.Palette.data(), payload.data() + prefix_bytes, palette_bytes);
+    }
+
+    // The payload may not be 2 byte aligned (e.g. a view into a larger buffer), so don't read it as uint16_t in place
+    const uint8_t* encoded_bytes = payload.data() + prefix_bytes + palette_bytes;
+    const uint16_t* encoded = reinterpret_cast<const uint16_t*>(encoded_bytes);
+    std::vector<uint16_t> aligned;
+    if (reinterpret_cast<uintptr_t>(encoded_bytes) % alignof(uint16_t) != 0) {
+        aligned.resize(header.EncodedSize);
+        std::memcpy(aligned.data(), encoded_bytes, aligned.size() * sizeof(uint16_t));
+        encoded = aligned.data();
+    }
+
+    const size_t decoded = entry_codec_t::decode(span_t<const uint16_t>(encoded, header.EncodedSize), span_t<uint16_t>(scratch.Entries.data(), BLOCKS_PER_CHUNK));
+    if (decoded != BLOCKS_PER_CHUNK) {
+        throw std::runtime_error("Chunk payload holds too few blocks");
+    }
+    if (!delta) {
+        chunk.Blocks.ImportEntries(scratch.Palette.data(), scratch.Palette.size(), scratch.Entries.data());
+        return;
+    }
+
+    // Patch the baseline: merge the delta palette into the baseline's, then take each changed block's entry from it
+    scratch.BaselineEntries.resize(BLOCKS_PER_CHUNK);
+    chunk.Blocks.ExportEntries(scratch.BaselinePalette, scratch.BaselineEntries.data());
+    std::vector<BlockComponent>& merged_palette = scratch.BaselinePalette;
+    std::vector<uint16_t> to_merged(scratch.Palette.size() + 1, 0);
+    for (size_t i = 0; i < scratch.Palette.size(); ++i) {
+        auto iter = std::find(merged_palette.begin(), merged_palette.end(), scratch.Palette[i]);
+        if (iter == merged_palette.end()) {
+            if (merged_palette.size() == ChunkBlockStorage<>::MAX_PALETTE_SIZE) {
+                throw std::length_error("Patched chunk needs more than MAX_PALETTE_SIZE palette entries");
+            }
+            iter = merged_palette.insert(merged_palette.end(), scratch.Palette[i]);
+        }
+        to_merged[i + 1] = static_cast<uint16_t>(iter - merged_palette.begin());
+    }
+
+    uint16_t* entries = scratch.Entries.data();
+    const uint16_t* baseline_entries = scratch.BaselineEntries.data();
+    uint16_t max_entry = 0;
+    for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+        max_entry = std::max(max_entry, entries[i]);
+    }
+    if (max_entry > scratch.Palette.size()) {
+        throw std::out_of_range("Chunk delta entry is outside of the palette");
+    }
+    for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+        entries[i] = entries[i] != 0 ? to_merged[entries[i]] : baseline_entries[i];
+    }
+    chunk.Blocks.ImportEntries(merged_palette.data(), merged_palette.size(), entries);
+}
+
+uint32_t ChunkSerializer::GetBaselineVersion(const span_t<const uint8_t> payload) {
+    const payload_header_t header = readHeader(payload);
+    if ((header.Flags & FLAG_DELTA) == 0) {
+        return NO_BASELINE;
+    }
+    uint32_t generator_version;
+    if (payload.size() < sizeof(header) + sizeof(generator_version)) {
+        throw std::runtime_error("Chunk payload is truncated");
+    }
+    std::memcpy(&generator_version, payload.data() + sizeof(header), sizeof(generator_version));
+    return generator_version;
+}
@@ -0,0 +1,161 @@
+#include "io/MappedFile.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Unmap();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+void MappedFile::Map(const std::string& path) {
+    Unmap();
+    // Share writes, as region files stay open for writing while mapped
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open " + path + " for mapping");
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to get size of " + path);
+    }
+    if (file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        throw std::runtime_error("Failed to create file mapping for " + path);
+    }
+    // The view keeps the mapping object alive
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) {
+        throw std::runtime_error("Failed to map " + path);
+    }
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(file_size.QuadPart);
+}
+
+void MappedFile::Unmap() noexcept {
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+void MappedFile::Advise(const size_t offset, const size_t length, const MappedAccess access) const noexcept {
+    if (!data || access != MappedAccess::WillNeed || offset >= size) {
+        return;
+    }
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t*>(data + offset);
+    range.NumberOfBytes = std::min(length, size - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+void MappedFile::Map(const std::string& path) {
+    Unmap();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + " for mapping");
+    }
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to get size of " + path);
+    }
+    if (file_stat.st_size == 0) {
+        ::close(fd);
+        return;
+    }
+
+    const size_t file_size = static_cast<size_t>(file_stat.st_size);
+    void* mapped = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Failed to map " + path);
+    }
+    data = static_cast<const uint8_t*>(mapped);
+    size = file_size;
+}
+
+void MappedFile::Unmap() noexcept {
+    if (data) {
+        ::munmap(const_cast<uint8_t*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+void MappedFile::Advise(const size_t offset, const size_t length, const MappedAccess access) const noexcept {
+    if (!data || offset >= size) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    switch (access) {
+    case MappedAccess::Sequential:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case MappedAccess::Random:
+        advice = MADV_RANDOM;
+        break;
+    case MappedAccess::WillNeed:
+        advice = MADV_WILLNEED;
+        break;
+    default:
+        break;
+    }
+    // madvise wants a page aligned start
+    static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t begin = offset & ~(page_size - 1);
+    const size_t end = std::min(size, offset + length);
+    ::madvise(const_cast<uint8_t*>(data + begin), end - begin, advice);
+}
+
+#endif
+
+bool MappedFile::IsMapped() const noexcept {
+    return data != nullptr;
+}
+
+const uint8_t* MappedFile::Data() const noexcept {
+    return data;
+}
+
+size_t MappedFile::Size() const noexcept {
+    return size;
+}
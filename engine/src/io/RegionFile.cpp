@@ -0,0 +1,285 @@
+#include "io/RegionFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+constexpr static char REGION_MAGIC[4] = { 'H', 'R', 'G', 'N' };
+
+struct region_header_t {
+    char Magic[4];
+    uint32_t Version;
+    uint32_t SectorSize;
+    uint32_t Reserved;
+};
+
+static_assert(sizeof(region_header_t) == RegionFile::HEADER_BYTES, "Region header size changed");
+static_assert(sizeof(RegionFile::entry_t) == 8, "Region table entries must be 8 bytes");
+
+RegionFile::RegionFile(const std::string& _path) : path(_path), entries(CHUNKS_PER_REGION, entry_t{ 0, 0 }) {
+    file = std::fopen(path.c_str(), "r+b");
+    if (!file) {
+        file = std::fopen(path.c_str(), "w+b");
+        if (!file) {
+            throw std::runtime_error("Failed to open region file " + path);
+        }
+        create();
+        return;
+    }
+
+    try {
+        readTable();
+    }
+    catch (...) {
+        std::fclose(file);
+        throw;
+    }
+}
+
+RegionFile::~RegionFile() {
+    mapping.Unmap();
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool RegionFile::Contains(const glm::ivec2& local) const noexcept {
+    return entries[GetTableIndex(local)].SectorOffset != 0;
+}
+
+bool RegionFile::Read(const glm::ivec2& local, std::vector<uint8_t>& payload) {
+    const entry_t& entry = entries[GetTableIndex(local)];
+    if (entry.SectorOffset == 0) {
+        return false;
+    }
+    payload.resize(entry.ByteLength);
+    seek(uint64_t(entry.SectorOffset) * SECTOR_SIZE);
+    if (std::fread(payload.data(), 1, payload.size(), file) != payload.size()) {
+        throw std::runtime_error("Failed to read chunk from region file " + path);
+    }
+    return true;
+}
+
+span_t<const uint8_t> RegionFile::ReadMapped(const glm::ivec2& local) {
+    const entry_t& entry = entries[GetTableIndex(local)];
+    if (entry.SectorOffset == 0) {
+        return span_t<const uint8_t>();
+    }
+    updateMapping();
+    const size_t offset = size_t(entry.SectorOffset) * SECTOR_SIZE;
+    if (offset + entry.ByteLength > mapping.Size()) {
+        throw std::runtime_error("Chunk lies outside of the mapping of region file " + path);
+    }
+    return span_t<const uint8_t>(mapping.Data() + offset, entry.ByteLength);
+}
+
+void RegionFile::Prefetch(const glm::ivec2& local) {
+    const entry_t& entry = entries[GetTableIndex(local)];
+    if (entry.SectorOffset == 0) {
+        return;
+    }
+    updateMapping();
+    mapping.Advise(size_t(entry.SectorOffset) * SECTOR_SIZE, entry.ByteLength, MappedAccess::WillNeed);
+}
+
+void RegionFile::Write(const glm::ivec2& local, const span_t<const uint8_t> payload) {
+    if (payload.empty()) {
+        Erase(local);
+        return;
+    }
+    if (payload.size() > UINT32_MAX) {
+        throw std::length_error("Chunk payload too large for a region file");
+    }
+
+    const size_t idx = GetTableIndex(local);
+    entry_t& entry = entries[idx];
+    mappingStale = true;
+    const size_t sectors = GetSectorsForBytes(payload.size());
+    const size_t old_sectors = entry.SectorOffset != 0 ? GetSectorsForBytes(entry.ByteLength) : 0;
+
+    uint32_t first_sector = entry.SectorOffset;
+    if (sectors > old_sectors) {
+        // Keep the old sectors allocated until the new payload is written, so a failed write loses nothing
+        first_sector = allocateSectors(sectors);
+    }
+
+    seek(uint64_t(first_sector) * SECTOR_SIZE);
+    const size_t padding = sectors * SECTOR_SIZE - payload.size();
+    static const uint8_t zeroes[SECTOR_SIZE] = {};
+    if (std::fwrite(payload.data(), 1, payload.size(), file) != payload.size() || std::fwrite(zeroes, 1, padding, file) != padding) {
+        if (first_sector != entry.SectorOffset) {
+            markSectors(first_sector, sectors, false);
+        }
+        throw std::runtime_error("Failed to write chunk to region file " + path);
+    }
+
+    if (first_sector != entry.SectorOffset) {
+        if (entry.SectorOffset != 0) {
+            markSectors(entry.SectorOffset, old_sectors, false);
+        }
+    }
+    else if (sectors < old_sectors) {
+        markSectors(first_sector + static_cast<uint32_t>(sectors), old_sectors - sectors, false);
+    }
+    entry.SectorOffset = first_sector;
+    entry.ByteLength = static_cast<uint32_t>(payload.size());
+    writeEntry(idx);
+}
+
+void RegionFile::Erase(const glm::ivec2& local) {
+    const size_t idx = GetTableIndex(local);
+    entry_t& entry = entries[idx];
+    if (entry.SectorOffset == 0) {
+        return;
+    }
+    markSectors(entry.SectorOffset, GetSectorsForBytes(entry.ByteLength), false);
+    entry = entry_t{ 0, 0 };
+    mappingStale = true;
+    writeEntry(idx);
+}
+
+void RegionFile::Flush() {
+    std::fflush(file);
+}
+
+const std::string& RegionFile::GetPath() const noexcept {
+    return path;
+}
+
+size_t RegionFile::SectorCount() const noexcept {
+    return usedSectors.size();
+}
+
+glm::ivec2 RegionFile::GetRegionCoord(const glm::ivec2& grid_position) noexcept {
+    auto floor_div = [](const int32_t val) {
+        return val >= 0 ? val / REGION_SIZE : -((-(val + 1)) / REGION_SIZE) - 1;
+    };
+    return glm::ivec2(floor_div(grid_position.x), floor_div(grid_position.y));
+}
+
+glm::ivec2 RegionFile::GetLocalCoord(const glm::ivec2& grid_position) noexcept {
+    return grid_position - GetRegionCoord(grid_position) * REGION_SIZE;
+}
+
+size_t RegionFile::GetSectorsForBytes(const size_t bytes) noexcept {
+    return (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+}
+
+size_t RegionFile::GetTableIndex(const glm::ivec2& local) noexcept {
+    return static_cast<size_t>(local.y) * REGION_SIZE + static_cast<size_t>(local.x);
+}
+
+void RegionFile::create() {
+    std::vector<uint8_t> header(FIRST_PAYLOAD_SECTOR * SECTOR_SIZE, 0);
+    region_header_t region_header{};
+    std::memcpy(region_header.Magic, REGION_MAGIC, sizeof(REGION_MAGIC));
+    region_header.Version = VERSION;
+    region_header.SectorSize = static_cast<uint32_t>(SECTOR_SIZE);
+    std::memcpy(header.data(), &region_header, sizeof(region_header));
+    if (std::fwrite(header.data(), 1, header.size(), file) != header.size()) {
+        throw std::runtime_error("Failed to write header of region file " + path);
+    }
+    usedSectors.assign(FIRST_PAYLOAD_SECTOR, true);
+}
+
+void RegionFile::readTable() {
+    region_header_t region_header{};
+    seek(0);
+    if (std::fread(&region_header, sizeof(region_header), 1, file) != 1 || std::memcmp(region_header.Magic, REGION_MAGIC, sizeof(REGION_MAGIC)) != 0) {
+        throw std::runtime_error(path + " is not a region file");
+    }
+    if (region_header.Version != VERSION || region_header.SectorSize != SECTOR_SIZE) {
+        throw std::runtime_error("Unsupported version or sector size in region file " + path);
+    }
+
+    seek(TABLE_OFFSET);
+    if (std::fread(entries.data(), sizeof(entry_t), entries.size(), file) != entries.size()) {
+        throw std::runtime_error("Region file " + path + " is truncated");
+    }
+
+    if (std::fseek(file, 0, SEEK_END) != 0) {
+        throw std::runtime_error("Failed to seek in region file " + path);
+    }
+#ifdef _MSC_VER
+    const uint64_t file_size = static_cast<uint64_t>(_ftelli64(file));
+#else
+    const uint64_t file_size = static_cast<uint64_t>(ftello(file));
+#endif
+    usedSectors.assign(std::max<size_t>(FIRST_PAYLOAD_SECTOR, GetSectorsForBytes(static_cast<size_t>(file_size))), false);
+    markSectors(0, FIRST_PAYLOAD_SECTOR, true);
+
+    // Drop entries pointing outside the file or into sectors another chunk already owns: what's left is consistent
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entry_t& entry = entries[i];
+        if (entry.SectorOffset == 0) {
+            continue;
+        }
+        const size_t sectors = GetSectorsForBytes(entry.ByteLength);
+        const bool valid = entry.ByteLength != 0 && entry.SectorOffset >= FIRST_PAYLOAD_SECTOR && entry.SectorOffset + sectors <= usedSectors.size() &&
+            std::none_of(usedSectors.begin() + entry.SectorOffset, usedSectors.begin() + entry.SectorOffset + sectors, [](const bool used) { return used; });
+        if (!valid) {
+            entry = entry_t{ 0, 0 };
+            continue;
+        }
+        markSectors(entry.SectorOffset, sectors, true);
+    }
+}
+
+void RegionFile::writeEntry(const size_t idx) {
+    seek(TABLE_OFFSET + idx * sizeof(entry_t));
+    if (std::fwrite(&entries[idx], sizeof(entry_t), 1, file) != 1) {
+        throw std::runtime_error("Failed to update offset table of region file " + path);
+    }
+}
+
+uint32_t RegionFile::allocateSectors(const size_t count) {
+    size_t run_start = FIRST_PAYLOAD_SECTOR;
+    size_t run_length = 0;
+    for (size_t i = FIRST_PAYLOAD_SECTOR; i < usedSectors.size(); ++i) {
+        if (usedSectors[i]) {
+            run_start = i + 1;
+            run_length = 0;
+            continue;
+        }
+        if (++run_length == count) {
+            markSectors(static_cast<uint32_t>(run_start), count, true);
+            return static_cast<uint32_t>(run_start);
+        }
+    }
+
+    // Extend the file, reusing any free sectors at its end
+    const size_t first = usedSectors.size() - run_length;
+    if (first + count > UINT32_MAX) {
+        throw std::length_error("Region file " + path + " is full");
+    }
+    usedSectors.resize(first + count, false);
+    markSectors(static_cast<uint32_t>(first), count, true);
+    return static_cast<uint32_t>(first);
+}
+
+void RegionFile::markSectors(const uint32_t first, const size_t count, const bool used) {
+    std::fill(usedSectors.begin() + first, usedSectors.begin() + first + count, used);
+}
+
+void RegionFile::seek(const uint64_t offset) {
+#ifdef _MSC_VER
+    const int result = _fseeki64(file, static_cast<__int64>(offset), SEEK_SET);
+#else
+    const int result = fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+    if (result != 0) {
+        throw std::runtime_error("Failed to seek in region file " + path);
+    }
+}
+
+void RegionFile::updateMapping() {
+    if (!mappingStale) {
+        return;
+    }
+    std::fflush(file);
+    if (mapping.Size() < usedSectors.size() * SECTOR_SIZE) {
+        mapping.Map(path);
+        // Chunks are read in whatever order the player walks into them, not file order: don't read ahead blindly
+        mapping.Advise(0, mapping.Size(), MappedAccess::Random);
+    }
+    mappingStale = false;
+}
@@ -0,0 +1,127 @@
+#include "io/RegionStore.hpp"
+#include "io/ChunkSerializer.hpp"
+#include <filesystem>
+#include <stdexcept>
+
+RegionStore::RegionStore(const std::string& _directory, TerrainBaseline _baseline) : directory(_directory), baseline(std::move(_baseline)) {
+    std::filesystem::create_directories(directory);
+}
+
+ChunkLoadStatus RegionStore::LoadChunk(ChunkComponent& chunk) {
+    RegionFile* region = getRegion(RegionFile::GetRegionCoord(chunk.GridPosition), false);
+    if (!region) {
+        return ChunkLoadStatus::NotSaved;
+    }
+    const span_t<const uint8_t> mapped = region->ReadMapped(RegionFile::GetLocalCoord(chunk.GridPosition));
+    if (mapped.empty()) {
+        return ChunkLoadStatus::NotSaved;
+    }
+    // Only the serializer's errors mean the payload itself is bad. Anything thrown reading the file is left to the
+    // caller, as the copy on disk may be fine.
+    uint32_t baseline_version;
+    try {
+        baseline_version = ChunkSerializer::GetBaselineVersion(mapped);
+    }
+    catch (const std::runtime_error&) {
+        return ChunkLoadStatus::Corrupt;
+    }
+    if (incompatible(mapped)) {
+        return ChunkLoadStatus::Incompatible;
+    }
+    if (baseline_version != ChunkSerializer::NO_BASELINE) {
+        chunk.Blocks = ChunkBlockStorage<>();
+        baseline.Generate(chunk);
+    }
+    try {
+        ChunkSerializer::Deserialize(mapped, chunk);
+    }
+    catch (const std::runtime_error&) {
+        return ChunkLoadStatus::Corrupt;
+    }
+    catch (const std::logic_error&) {
+        // Palette indices out of range, or too many palette entries
+        return ChunkLoadStatus::Corrupt;
+    }
+    bytesRead += mapped.size();
+    return ChunkLoadStatus::Loaded;
+}
+
+bool RegionStore::SaveChunk(const ChunkComponent& chunk) {
+    RegionFile* region = getRegion(RegionFile::GetRegionCoord(chunk.GridPosition), true);
+    const glm::ivec2 local = RegionFile::GetLocalCoord(chunk.GridPosition);
+    // Whatever "chunk" holds, it can't have been loaded from the saved copy: keep that copy's edits
+    if (incompatible(region->ReadMapped(local))) {
+        return false;
+    }
+
+    if (baseline.Generate) {
+        baselineChunk.Blocks = ChunkBlockStorage<>();
+        baselineChunk.GridPosition = chunk.GridPosition;
+        baselineChunk.WorldPosition = chunk.WorldPosition;
+        baseline.Generate(baselineChunk);
+        ChunkSerializer::SerializeDelta(chunk, baselineChunk, baseline.GeneratorVersion, payload);
+    }
+    else {
+        ChunkSerializer::Serialize(chunk, payload);
+    }
+    region->Write(local, span_t<const uint8_t>(payload.data(), payload.size()));
+    bytesWritten += payload.size();
+    return true;
+}
+
+void RegionStore::PrefetchChunk(const glm::ivec2& grid_position) {
+    RegionFile* region = getRegion(RegionFile::GetRegionCoord(grid_position), false);
+    if (region) {
+        region->Prefetch(RegionFile::GetLocalCoord(grid_position));
+    }
+}
+
+void RegionStore::Flush() {
+    for (auto& region : regions) {
+        region.second->Flush();
+    }
+}
+
+const std::string& RegionStore::GetDirectory() const noexcept {
+    return directory;
+}
+
+uint64_t RegionStore::BytesRead() const noexcept {
+    return bytesRead;
+}
+
+uint64_t RegionStore::BytesWritten() const noexcept {
+    return bytesWritten;
+}
+
+bool RegionStore::incompatible(const span_t<const uint8_t> payload) const {
+    if (payload.empty()) {
+        return false;
+    }
+    uint32_t baseline_version;
+    try {
+        baseline_version = ChunkSerializer::GetBaselineVersion(payload);
+    }
+    catch (const std::exception&) {
+        // Corrupt rather than incompatible: nothing in it can be saved, so it may be overwritten
+        return false;
+    }
+    return baseline_version != ChunkSerializer::NO_BASELINE && (!baseline.Generate || baseline.GeneratorVersion != baseline_version);
+}
+
+RegionFile* RegionStore::getRegion(const glm::ivec2& region_coord, const bool create) {
+    auto iter = regions.find(region_coord);
+    if (iter != regions.end()) {
+        return iter->second.get();
+    }
+
+    const std::filesystem::path path = std::filesystem::path(directory) /
+        ("r." + std::to_string(region_coord.x) + "." + std::to_string(region_coord.y) + ".hrg");
+    if (!create && !std::filesystem::exists(path)) {
+        return nullptr;
+    }
+    auto region = std::make_unique<RegionFile>(path.string());
+    RegionFile* result = region.get();
+    regions.emplace(region_coord, std::move(region));
+    return result;
+}
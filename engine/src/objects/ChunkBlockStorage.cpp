@@ -0,0 +1,361 @@
+#include "objects/ChunkBlockStorage.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
+// Narrowest supported index width that can address "count" palette entries
+static uint32_t getIndexBits(const size_t count) noexcept {
+    if (count <= 1) {
+        return 0;
+    }
+    uint32_t bits = 1;
+    while ((size_t(1) << bits) < count) {
+        bits *= 2;
+    }
+    return bits;
+}
+
+static uint32_t getLog2(uint32_t val) noexcept {
+    uint32_t result = 0;
+    while (val > 1) {
+        val >>= 1;
+        ++result;
+    }
+    return result;
+}
+
+template<typename Layout>
+ChunkBlockStorage<Layout>::ChunkBlockStorage(const BlockComponent& fill) {
+    Fill(fill);
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::SetBlock(const size_t idx, const BlockComponent& block) {
+    const uint32_t old_entry = getIndex(idx);
+    if (palette[old_entry] == block) {
+        return;
+    }
+
+    // Release the old entry first, so a chunk swapping one block type for another can reuse its slot
+    if (--refCounts[old_entry] == 0) {
+        freeEntries.push_back(old_entry);
+    }
+    const uint32_t new_entry = findOrAddEntry(block);
+    ++refCounts[new_entry];
+    setIndex(idx, new_entry);
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::SetBlock(const size_t x, const size_t y, const size_t z, const BlockComponent& block) {
+    SetBlock(Layout::GetIndex(uint32_t(x), uint32_t(y), uint32_t(z)), block);
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::Fill(const BlockComponent& block) {
+    palette.assign(1, block);
+    refCounts.assign(1, static_cast<uint32_t>(BLOCKS_PER_CHUNK));
+    freeEntries.clear();
+    indices.clear();
+    indices.shrink_to_fit();
+    bitsPerBlock = 0;
+    indicesPerWordShift = 0;
+}
+
+// Fixed widths let the compiler unroll and vectorize the inner loop
+template<uint32_t Bits, typename Lookup>
+static void unpackTypes(const uint64_t* words, const size_t word_count, const Lookup& lookup, BlockType* dest) noexcept {
+    constexpr uint32_t per_word = 64u / Bits;
+    constexpr uint64_t mask = (uint64_t(1) << Bits) - 1u;
+    for (size_t word = 0; word < word_count; ++word) {
+        const uint64_t bits = words[word];
+        for (uint32_t i = 0; i < per_word; ++i) {
+            dest[word * per_word + i] = lookup[(bits >> (i * Bits)) & mask];
+        }
+    }
+}
+
+// Inverse of unpackTypes(), packing "entries" into words of 64 / Bits indices
+template<uint32_t Bits>
+static void packEntries(const uint16_t* entries, uint64_t* words, const size_t word_count) noexcept {
+    constexpr uint32_t per_word = 64u / Bits;
+    for (size_t word = 0; word < word_count; ++word) {
+        uint64_t bits = 0;
+        for (uint32_t i = 0; i < per_word; ++i) {
+            bits |= uint64_t(entries[word * per_word + i]) << (i * Bits);
+        }
+        words[word] = bits;
+    }
+}
+
+// For layouts that interleave layers: walk "dest" in order, fetching each block from wherever the layout put it
+template<typename Layout, uint32_t Bits, typename Lookup>
+static void gatherTypes(const uint64_t* words, const uint32_t y_begin, const uint32_t y_end, const Lookup& lookup, BlockType* dest) noexcept {
+    constexpr uint32_t per_word = 64u / Bits;
+    constexpr uint64_t mask = (uint64_t(1) << Bits) - 1u;
+    dest += GetBlockIndex(0, y_begin, 0);
+    for (uint32_t y = y_begin; y < y_end; ++y) {
+        for (uint32_t x = 0; x < CHUNK_SIZE; ++x) {
+            for (uint32_t z = 0; z < CHUNK_SIZE; ++z) {
+                const size_t idx = Layout::GetIndex(x, y, z);
+                *dest++ = lookup[(words[idx / per_word] >> ((idx % per_word) * Bits)) & mask];
+            }
+        }
+    }
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::CopyTypes(BlockType* dest, const uint32_t y_begin, const uint32_t y_end) const noexcept {
+    if (bitsPerBlock == 0) {
+        std::fill(dest + GetBlockIndex(0, y_begin, 0), dest + GetBlockIndex(0, y_end, 0), palette[0].Type);
+        return;
+    }
+
+    if (bitsPerBlock == 16) {
+        struct {
+            const std::vector<BlockComponent>& Palette;
+            BlockType operator[](const uint64_t idx) const noexcept { return Palette[idx].Type; }
+        } lookup{ palette };
+        copyEntries(dest, y_begin, y_end, lookup);
+        return;
+    }
+
+    // For narrow indices, look types up from a small table rather than going through the larger BlockComponents
+    std::array<BlockType, 256> types;
+    for (size_t i = 0; i < palette.size(); ++i) {
+        types[i] = palette[i].Type;
+    }
+    copyEntries(dest, y_begin, y_end, types);
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::ExportEntries(std::vector<BlockComponent>& palette_out, uint16_t* entries_out) const {
+    // Skip unused entries, so the exported palette is as small as Compact() would make it
+    std::vector<uint16_t> remap(palette.size(), 0);
+    palette_out.clear();
+    for (size_t i = 0; i < palette.size(); ++i) {
+        if (refCounts[i] != 0) {
+            remap[i] = static_cast<uint16_t>(palette_out.size());
+            palette_out.push_back(palette[i]);
+        }
+    }
+
+    if (bitsPerBlock == 0) {
+        std::fill(entries_out, entries_out + BLOCKS_PER_CHUNK, uint16_t(0));
+        return;
+    }
+    copyEntries(entries_out, 0, CHUNK_SIZE_Y, remap);
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::ImportEntries(const BlockComponent* palette_in, const size_t palette_size, const uint16_t* entries) {
+    if (palette_size == 0 || palette_size > MAX_PALETTE_SIZE) {
+        throw std::invalid_argument("Chunk palette must hold between 1 and MAX_PALETTE_SIZE entries");
+    }
+
+    // A plain loop rather than std::max_element, so it vectorizes
+    uint16_t max_entry = 0;
+    for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+        max_entry = std::max(max_entry, entries[i]);
+    }
+    if (max_entry >= palette_size) {
+        throw std::out_of_range("Chunk block entry is outside of the palette");
+    }
+
+    // Chunks are mostly long runs of one entry, and incrementing a single counter block after block is bound by
+    // its latency: spread consecutive blocks over four sets of counters, and sum them afterwards.
+    std::vector<uint32_t> lane_counts(palette_size * 4, 0);
+    for (size_t i = 0; i < BLOCKS_PER_CHUNK; i += 4) {
+        ++lane_counts[entries[i]];
+        ++lane_counts[palette_size + entries[i + 1]];
+        ++lane_counts[palette_size * 2 + entries[i + 2]];
+        ++lane_counts[palette_size * 3 + entries[i + 3]];
+    }
+    std::vector<uint32_t> counts(palette_size);
+    for (size_t i = 0; i < palette_size; ++i) {
+        counts[i] = lane_counts[i] + lane_counts[palette_size + i] + lane_counts[palette_size * 2 + i] + lane_counts[palette_size * 3 + i];
+    }
+
+    palette.assign(palette_in, palette_in + palette_size);
+    refCounts = std::move(counts);
+    freeEntries.clear();
+    for (uint32_t i = 0; i < static_cast<uint32_t>(palette_size); ++i) {
+        if (refCounts[i] == 0) {
+            freeEntries.push_back(i);
+        }
+    }
+
+    const uint32_t bits = getIndexBits(palette_size);
+    indices.clear();
+    bitsPerBlock = bits;
+    indicesPerWordShift = 0;
+    if (bits == 0) {
+        return;
+    }
+    indicesPerWordShift = 6 - getLog2(bits);
+    indices.assign(BLOCKS_PER_CHUNK * bits / 64, 0);
+    if constexpr (Layout::CONTIGUOUS_LAYERS) {
+        auto pack = [&](auto width) {
+            packEntries<decltype(width)::value>(entries, indices.data(), indices.size());
+        };
+        switch (bits) {
+        case 1:
+            pack(std::integral_constant<uint32_t, 1>());
+            break;
+        case 2:
+            pack(std::integral_constant<uint32_t, 2>());
+            break;
+        case 4:
+            pack(std::integral_constant<uint32_t, 4>());
+            break;
+        case 8:
+            pack(std::integral_constant<uint32_t, 8>());
+            break;
+        default:
+            pack(std::integral_constant<uint32_t, 16>());
+            break;
+        }
+    }
+    else {
+        for (uint32_t y = 0; y < CHUNK_SIZE_Y; ++y) {
+            for (uint32_t x = 0; x < CHUNK_SIZE; ++x) {
+                for (uint32_t z = 0; z < CHUNK_SIZE; ++z) {
+                    setIndex(Layout::GetIndex(x, y, z), entries[GetBlockIndex(x, y, z)]);
+                }
+            }
+        }
+    }
+}
+
+template<typename Layout>
+template<typename Lookup>
+void ChunkBlockStorage<Layout>::copyEntries(uint16_t* dest, const uint32_t y_begin, const uint32_t y_end, const Lookup& lookup) const noexcept {
+    auto copy = [&](auto bits) {
+        constexpr uint32_t Bits = decltype(bits)::value;
+        if constexpr (Layout::CONTIGUOUS_LAYERS) {
+            // A whole layer is a multiple of 64 bits at any width, so the range starts and ends on word boundaries
+            const size_t first = GetBlockIndex(0, y_begin, 0);
+            const size_t last = GetBlockIndex(0, y_end, 0);
+            const uint64_t* words = indices.data() + (Layout::GetIndex(0, y_begin, 0) >> indicesPerWordShift);
+            unpackTypes<Bits>(words, (last - first) >> indicesPerWordShift, lookup, dest + first);
+        }
+        else {
+            gatherTypes<Layout, Bits>(indices.data(), y_begin, y_end, lookup, dest);
+        }
+    };
+
+    switch (bitsPerBlock) {
+    case 1:
+        copy(std::integral_constant<uint32_t, 1>());
+        break;
+    case 2:
+        copy(std::integral_constant<uint32_t, 2>());
+        break;
+    case 4:
+        copy(std::integral_constant<uint32_t, 4>());
+        break;
+    case 8:
+        copy(std::integral_constant<uint32_t, 8>());
+        break;
+    default:
+        copy(std::integral_constant<uint32_t, 16>());
+        break;
+    }
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::Compact() {
+    std::vector<uint32_t> remap(palette.size(), 0);
+    std::vector<BlockComponent> live_entries;
+    std::vector<uint32_t> live_counts;
+    for (size_t i = 0; i < palette.size(); ++i) {
+        if (refCounts[i] != 0) {
+            remap[i] = static_cast<uint32_t>(live_entries.size());
+            live_entries.push_back(palette[i]);
+            live_counts.push_back(refCounts[i]);
+        }
+    }
+    if (live_entries.size() == palette.size()) {
+        return;
+    }
+
+    repack(getIndexBits(live_entries.size()), remap);
+    palette = std::move(live_entries);
+    refCounts = std::move(live_counts);
+    freeEntries.clear();
+}
+
+template<typename Layout>
+uint32_t ChunkBlockStorage<Layout>::BitsPerBlock() const noexcept {
+    return bitsPerBlock;
+}
+
+template<typename Layout>
+size_t ChunkBlockStorage<Layout>::PaletteSize() const noexcept {
+    return palette.size() - freeEntries.size();
+}
+
+template<typename Layout>
+size_t ChunkBlockStorage<Layout>::MemoryUsage() const noexcept {
+    return palette.capacity() * sizeof(BlockComponent) + refCounts.capacity() * sizeof(uint32_t) + freeEntries.capacity() * sizeof(uint32_t) +
+        indices.capacity() * sizeof(uint64_t);
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::setIndex(const size_t idx, const uint32_t value) noexcept {
+    const size_t word = idx >> indicesPerWordShift;
+    const uint32_t shift = static_cast<uint32_t>(idx & ((size_t(1) << indicesPerWordShift) - 1)) * bitsPerBlock;
+    const uint64_t mask = ((uint64_t(1) << bitsPerBlock) - 1u) << shift;
+    indices[word] = (indices[word] & ~mask) | (static_cast<uint64_t>(value) << shift);
+}
+
+template<typename Layout>
+uint32_t ChunkBlockStorage<Layout>::findOrAddEntry(const BlockComponent& block) {
+    // Palettes are small in practice, and a linear scan over 4 byte entries is cheap
+    for (size_t i = 0; i < palette.size(); ++i) {
+        if (refCounts[i] != 0 && palette[i] == block) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+
+    if (!freeEntries.empty()) {
+        const uint32_t entry = freeEntries.back();
+        freeEntries.pop_back();
+        palette[entry] = block;
+        return entry;
+    }
+
+    if (palette.size() == MAX_PALETTE_SIZE) {
+        throw std::length_error("Chunk has more distinct blocks than ChunkBlockStorage can index");
+    }
+    palette.push_back(block);
+    refCounts.push_back(0);
+    if (palette.size() > (size_t(1) << bitsPerBlock)) {
+        repack(getIndexBits(palette.size()), std::vector<uint32_t>());
+    }
+    return static_cast<uint32_t>(palette.size() - 1);
+}
+
+template<typename Layout>
+void ChunkBlockStorage<Layout>::repack(const uint32_t bits, const std::vector<uint32_t>& remap) {
+    std::vector<uint64_t> packed;
+    if (bits != 0) {
+        packed.assign(BLOCKS_PER_CHUNK * bits / 64, 0);
+        const uint32_t per_word_shift = 6 - getLog2(bits);
+        for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+            const uint32_t old_entry = getIndex(i);
+            const uint64_t entry = remap.empty() ? old_entry : remap[old_entry];
+            packed[i >> per_word_shift] |= entry << ((i & ((size_t(1) << per_word_shift) - 1)) * bits);
+        }
+        indicesPerWordShift = per_word_shift;
+    }
+    else {
+        indicesPerWordShift = 0;
+    }
+    indices = std::move(packed);
+    bitsPerBlock = bits;
+}
+
+template class ChunkBlockStorage<LinearChunkLayout>;
+template class ChunkBlockStorage<MortonChunkLayout>;
+template class ChunkBlockStorage<TiledChunkLayout>;
@@ -0,0 +1,254 @@
+#include "objects/ChunkFaceMasks.hpp"
+#include "objects/PackedChunkVertex.hpp"
+#include "util/CommonUtil.hpp"
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Stands in for the rows above and below the chunk: everything outside vertically is solid.
+constexpr static uint32_t SOLID_ROW = 0xFFFFFFFFu;
+// Bit that a row shifted towards +x/-x needs filled in from the neighbouring chunk
+constexpr static uint32_t POS_X_BORDER_SHIFT = CHUNK_SIZE - 1;
+
+void BuildOpacityMask(const BlockType* blocks, ChunkOpacityMask& result, const uint32_t y_begin, const uint32_t y_end) noexcept {
+    std::fill(result.Rows.begin() + GetRowIndex(y_begin, 0), result.Rows.begin() + GetRowIndex(y_end, 0), 0u);
+    // Walk blocks in memory order: z is the fastest-changing index in GetBlockIndex()
+    for (size_t y = y_begin; y < y_end; ++y) {
+        for (size_t x = 0; x < CHUNK_SIZE; ++x) {
+            const BlockType* column = blocks + GetBlockIndex(x, y, 0);
+            for (size_t z = 0; z < CHUNK_SIZE; ++z) {
+                if (column[z] != static_cast<BlockType>(BlockTypes::AIR)) {
+                    result.Rows[GetRowIndex(y, z)] |= (1u << x);
+                }
+            }
+        }
+    }
+}
+
+#if defined(__AVX2__)
+
+static void buildFaceMasksAVX2(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, ChunkFaceMasks& result, const uint32_t y_begin, const uint32_t y_end) noexcept {
+    constexpr size_t LANES = 8;
+    constexpr size_t VECTORS_PER_LAYER = CHUNK_SIZE / LANES;
+
+    const __m256i solid = _mm256_set1_epi32(static_cast<int>(SOLID_ROW));
+    const __m256i one = _mm256_set1_epi32(1);
+    // z coordinate of each lane, within a group of 8 rows
+    const __m256i lane_z = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    // Rotate lanes by one, so lane i holds lane i + 1 (or i - 1) of the input. Used for z neighbours.
+    const __m256i rotate_next = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    const __m256i rotate_prev = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+
+    auto load_layer = [&opacity](const size_t y, __m256i* dest) {
+        const uint32_t* layer = opacity.Rows.data() + GetRowIndex(y, 0);
+        for (size_t k = 0; k < VECTORS_PER_LAYER; ++k) {
+            dest[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(layer + k * LANES));
+        }
+    };
+
+    auto store = [&result](const BlockFace face, const size_t row, const __m256i& value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(result.Faces[static_cast<size_t>(face)].data() + row), value);
+    };
+
+    __m256i below[VECTORS_PER_LAYER], curr[VECTORS_PER_LAYER], above[VECTORS_PER_LAYER];
+    if (y_begin > 0) {
+        load_layer(y_begin - 1, below);
+    }
+    else {
+        for (size_t k = 0; k < VECTORS_PER_LAYER; ++k) {
+            below[k] = solid;
+        }
+    }
+    load_layer(y_begin, curr);
+
+    for (size_t y = y_begin; y < y_end; ++y) {
+        if (y + 1 < CHUNK_SIZE_Y) {
+            load_layer(y + 1, above);
+        }
+        else {
+            for (size_t k = 0; k < VECTORS_PER_LAYER; ++k) {
+                above[k] = solid;
+            }
+        }
+
+        const __m256i pos_x_column = _mm256_set1_epi32(static_cast<int>(borders.PosX[y]));
+        const __m256i neg_x_column = _mm256_set1_epi32(static_cast<int>(borders.NegX[y]));
+
+        for (size_t k = 0; k < VECTORS_PER_LAYER; ++k) {
+            const __m256i s = curr[k];
+            // Past the last row of the layer is the +z neighbour's row (only lane 0 gets used), before the first the -z one's (only lane 7).
+            const __m256i next_vec = (k + 1 < VECTORS_PER_LAYER) ? curr[k + 1] : _mm256_set1_epi32(static_cast<int>(borders.PosZ[y]));
+            const __m256i prev_vec = (k > 0) ? curr[k - 1] : _mm256_set1_epi32(static_cast<int>(borders.NegZ[y]));
+            // Lane i of "next_z" is row z + 1, taking lane 7 from the first lane of the following vector
+            const __m256i next_z = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(s, rotate_next), _mm256_permutevar8x32_epi32(next_vec, rotate_next), 0x80);
+            const __m256i prev_z = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(s, rotate_prev), _mm256_permutevar8x32_epi32(prev_vec, rotate_prev), 0x01);
+
+            // Each lane takes bit z of the neighbour's border column, moved to the bit just past this row's edge
+            const __m256i z_index = _mm256_add_epi32(lane_z, _mm256_set1_epi32(static_cast<int>(k * LANES)));
+            const __m256i pos_x_border = _mm256_slli_epi32(_mm256_and_si256(_mm256_srlv_epi32(pos_x_column, z_index), one), POS_X_BORDER_SHIFT);
+            const __m256i neg_x_border = _mm256_and_si256(_mm256_srlv_epi32(neg_x_column, z_index), one);
+            const __m256i next_x = _mm256_or_si256(_mm256_srli_epi32(s, 1), pos_x_border);
+            const __m256i prev_x = _mm256_or_si256(_mm256_slli_epi32(s, 1), neg_x_border);
+
+            const size_t row = GetRowIndex(y, k * LANES);
+            // andnot(a, b) == ~a & b: solid blocks whose neighbour in that direction isn't solid.
+            store(BlockFace::FRONT, row, _mm256_andnot_si256(next_z, s));
+            store(BlockFace::RIGHT, row, _mm256_andnot_si256(next_x, s));
+            store(BlockFace::TOP, row, _mm256_andnot_si256(above[k], s));
+            store(BlockFace::LEFT, row, _mm256_andnot_si256(prev_x, s));
+            store(BlockFace::BOTTOM, row, _mm256_andnot_si256(below[k], s));
+            store(BlockFace::BACK, row, _mm256_andnot_si256(prev_z, s));
+        }
+
+        for (size_t k = 0; k < VECTORS_PER_LAYER; ++k) {
+            below[k] = curr[k];
+            curr[k] = above[k];
+        }
+    }
+}
+
+#endif
+
+void BuildFaceMasksScalar(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, ChunkFaceMasks& result, const uint32_t y_begin, const uint32_t y_end) noexcept {
+    const auto& rows = opacity.Rows;
+    for (size_t y = y_begin; y < y_end; ++y) {
+        for (size_t z = 0; z < CHUNK_SIZE; ++z) {
+            const size_t row = GetRowIndex(y, z);
+            const uint32_t s = rows[row];
+            const uint32_t next_z = (z + 1 < CHUNK_SIZE) ? rows[GetRowIndex(y, z + 1)] : borders.PosZ[y];
+            const uint32_t prev_z = (z > 0) ? rows[GetRowIndex(y, z - 1)] : borders.NegZ[y];
+            const uint32_t next_x = (s >> 1) | (((borders.PosX[y] >> z) & 1u) << POS_X_BORDER_SHIFT);
+            const uint32_t prev_x = (s << 1) | ((borders.NegX[y] >> z) & 1u);
+            const uint32_t above = (y + 1 < CHUNK_SIZE_Y) ? rows[GetRowIndex(y + 1, z)] : SOLID_ROW;
+            const uint32_t below = (y > 0) ? rows[GetRowIndex(y - 1, z)] : SOLID_ROW;
+
+            result.Faces[static_cast<size_t>(BlockFace::FRONT)][row] = s & ~next_z;
+            result.Faces[static_cast<size_t>(BlockFace::RIGHT)][row] = s & ~next_x;
+            result.Faces[static_cast<size_t>(BlockFace::TOP)][row] = s & ~above;
+            result.Faces[static_cast<size_t>(BlockFace::LEFT)][row] = s & ~prev_x;
+            result.Faces[static_cast<size_t>(BlockFace::BOTTOM)][row] = s & ~below;
+            result.Faces[static_cast<size_t>(BlockFace::BACK)][row] = s & ~prev_z;
+        }
+    }
+}
+
+void BuildFaceMasks(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, ChunkFaceMasks& result, const uint32_t y_begin, const uint32_t y_end) noexcept {
+    if (y_begin >= y_end) {
+        return;
+    }
+#if defined(__AVX2__)
+    buildFaceMasksAVX2(opacity, borders, result, y_begin, y_end);
+#else
+    BuildFaceMasksScalar(opacity, borders, result, y_begin, y_end);
+#endif
+}
+
+/*
+    AO works on the 3x3 blocks in front of a face, as a 9 bit "neighbourhood" code: bit (r + 1) * 3 + (b + 1) is
+    set if the block offset by r along the face's row axis and b along its bit axis is solid. The bit axis is the
+    one the opacity rows run along (x) where possible, so most faces need only three row fetches.
+*/
+
+// Row and bit axes of each face's neighbourhood (x = 0, y = 1, z = 2), indexed by BlockFace
+constexpr static int ao_row_axis[6]{ 1, 1, 2, 1, 2, 1 };
+constexpr static int ao_bit_axis[6]{ 0, 2, 0, 2, 0, 0 };
+
+constexpr static uint32_t neighborhoodBit(const int r, const int b) {
+    return 1u << static_cast<uint32_t>((r + 1) * 3 + (b + 1));
+}
+
+constexpr static std::array<std::array<FaceAO, 512>, 6> buildAOTable() {
+    std::array<std::array<FaceAO, 512>, 6> result{};
+    for (size_t f = 0; f < 6; ++f) {
+        for (uint32_t code = 0; code < 512; ++code) {
+            uint32_t ao = 0;
+            for (uint32_t corner = 0; corner < 4; ++corner) {
+                const int r = packed_vertex::corner_offsets[f][corner][ao_row_axis[f]] ? 1 : -1;
+                const int b = packed_vertex::corner_offsets[f][corner][ao_bit_axis[f]] ? 1 : -1;
+                const uint32_t side0 = (code & neighborhoodBit(r, 0)) ? 1 : 0;
+                const uint32_t side1 = (code & neighborhoodBit(0, b)) ? 1 : 0;
+                const uint32_t diagonal = (code & neighborhoodBit(r, b)) ? 1 : 0;
+                const uint32_t level = (side0 && side1) ? 0 : 3 - (side0 + side1 + diagonal);
+                ao |= level << (corner * 2);
+            }
+            result[f][code] = static_cast<FaceAO>(ao);
+        }
+    }
+    return result;
+}
+
+constexpr static std::array<std::array<FaceAO, 512>, 6> ao_table = buildAOTable();
+
+// Row (y, z) widened to CHUNK_SIZE + 2 bits: bit x + 1 is block x, so bits 0 and CHUNK_SIZE + 1 hold the x borders.
+// Takes rows up to one block outside the chunk: above/below it and diagonally adjacent chunks are air.
+static uint64_t extendedRow(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, const int y, const int z) noexcept {
+    if (y < 0 || y >= static_cast<int>(CHUNK_SIZE_Y)) {
+        return 0;
+    }
+    else if (z < 0) {
+        return static_cast<uint64_t>(borders.NegZ[y]) << 1;
+    }
+    else if (z >= static_cast<int>(CHUNK_SIZE)) {
+        return static_cast<uint64_t>(borders.PosZ[y]) << 1;
+    }
+    const uint64_t neg_x = (borders.NegX[y] >> z) & 1u;
+    const uint64_t pos_x = (borders.PosX[y] >> z) & 1u;
+    return (static_cast<uint64_t>(opacity.Rows[GetRowIndex(y, z)]) << 1) | neg_x | (pos_x << (CHUNK_SIZE + 1));
+}
+
+void LoadFaceAORow(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, const uint32_t y, const uint32_t z, const BlockFace face, FaceAORow& result) noexcept {
+    const int* n = packed_vertex::normals[static_cast<size_t>(face)];
+    // Row in front of the faces
+    const int fy = static_cast<int>(y) + n[1];
+    const int fz = static_cast<int>(z) + n[2];
+
+    result.Face = face;
+    result.Shift = static_cast<uint32_t>(n[0] + 1);
+    switch (face) {
+    case BlockFace::FRONT:
+    case BlockFace::BACK:
+        // Neighbourhood rows along y
+        for (int r = -1; r <= 1; ++r) {
+            result.Rows[r + 1] = extendedRow(opacity, borders, fy + r, fz);
+        }
+        break;
+    case BlockFace::TOP:
+    case BlockFace::BOTTOM:
+        // Neighbourhood rows along z
+        for (int r = -1; r <= 1; ++r) {
+            result.Rows[r + 1] = extendedRow(opacity, borders, fy, fz + r);
+        }
+        break;
+    default:
+        // Left and right take a single bit from each of the nine rows around (y, z)
+        for (int r = -1; r <= 1; ++r) {
+            for (int b = -1; b <= 1; ++b) {
+                result.Rows[(r + 1) * 3 + (b + 1)] = extendedRow(opacity, borders, fy + r, fz + b);
+            }
+        }
+        break;
+    }
+}
+
+FaceAO ComputeFaceAO(const FaceAORow& row, const uint32_t x) noexcept {
+    uint32_t code = 0;
+    if (row.Face == BlockFace::LEFT || row.Face == BlockFace::RIGHT) {
+        const uint32_t bit = x + row.Shift;
+        for (uint32_t i = 0; i < 9; ++i) {
+            code |= static_cast<uint32_t>((row.Rows[i] >> bit) & 1) << i;
+        }
+    }
+    else {
+        // Bits x - 1 to x + 1 of the three rows, which are bits x to x + 2 of the widened rows
+        code = static_cast<uint32_t>((row.Rows[0] >> x) & 0x7) | (static_cast<uint32_t>((row.Rows[1] >> x) & 0x7) << 3) |
+            (static_cast<uint32_t>((row.Rows[2] >> x) & 0x7) << 6);
+    }
+    return ao_table[static_cast<size_t>(row.Face)][code];
+}
+
+FaceAO ComputeFaceAO(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, const uint32_t x, const uint32_t y, const uint32_t z, const BlockFace face) noexcept {
+    FaceAORow row;
+    LoadFaceAORow(opacity, borders, y, z, face, row);
+    return ComputeFaceAO(row, x);
+}
@@ -0,0 +1,174 @@
+#include "objects/ChunkGenerationJobs.hpp"
+#include "glm/geometric.hpp"
+#include <algorithm>
+
+// How strongly Schedule() favours chunks in view: a chunk straight ahead ranks as if it were this much closer, and
+// one straight behind as if it were this much further away
+constexpr static float VIEW_WEIGHT = 0.5f;
+// Jobs handed out at once, per worker
+constexpr static size_t JOBS_PER_WORKER = 2;
+
+ChunkGenerationJobSystem::ChunkGenerationJobSystem(std::shared_ptr<const terrain::TerrainGenerator> _generator, const size_t num_workers) :
+    generator(std::move(_generator)) {
+    // hardware_concurrency() is allowed to return 0
+    numWorkers = num_workers == 0 ? 1 : num_workers;
+    maxDispatched = numWorkers * JOBS_PER_WORKER;
+    queues = std::make_unique<workerQueue[]>(numWorkers);
+    workers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) {
+        workers.emplace_back(&ChunkGenerationJobSystem::workerFunction, this, i);
+    }
+}
+
+ChunkGenerationJobSystem::~ChunkGenerationJobSystem() {
+    {
+        std::lock_guard<std::mutex> guard(sleepMutex);
+        shutdown = true;
+    }
+    cVar.notify_all();
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void ChunkGenerationJobSystem::Submit(const glm::ivec2& grid_position) {
+    if (currentJobs.count(grid_position) != 0) {
+        return;
+    }
+    const uint64_t job_id = nextJobID++;
+    currentJobs.emplace(grid_position, job_id);
+    waiting.emplace_back(grid_position, job_id);
+}
+
+void ChunkGenerationJobSystem::Cancel(const glm::ivec2& grid_position) {
+    currentJobs.erase(grid_position);
+    auto iter = dispatched.find(grid_position);
+    if (iter != dispatched.end()) {
+        // Workers skip it if they haven't started on it yet
+        iter->second->Cancelled.store(true, std::memory_order_relaxed);
+        dispatched.erase(iter);
+    }
+}
+
+void ChunkGenerationJobSystem::Schedule(const glm::ivec2& camera_chunk_pos, const glm::vec2& view_direction) {
+    waiting.erase(std::remove_if(waiting.begin(), waiting.end(), [this](const std::pair<glm::ivec2, uint64_t>& job) {
+        return !isCurrent(job.first, job.second);
+    }), waiting.end());
+    if (waiting.empty() || dispatched.size() >= maxDispatched) {
+        return;
+    }
+
+    const float view_length = glm::length(view_direction);
+    const glm::vec2 view = view_length > 0.0f ? view_direction / view_length : glm::vec2(0.0f);
+    auto priority = [&camera_chunk_pos, &view](const glm::ivec2& grid_position) {
+        const glm::vec2 offset = glm::vec2(grid_position - camera_chunk_pos);
+        const float distance = glm::length(offset);
+        if (distance == 0.0f) {
+            return 0.0f;
+        }
+        return distance * (1.0f - VIEW_WEIGHT * glm::dot(offset / distance, view));
+    };
+
+    const size_t num_dispatched = std::min(maxDispatched - dispatched.size(), waiting.size());
+    std::vector<std::pair<float, size_t>> ranked(waiting.size());
+    for (size_t i = 0; i < waiting.size(); ++i) {
+        ranked[i] = std::make_pair(priority(waiting[i].first), i);
+    }
+    std::partial_sort(ranked.begin(), ranked.begin() + num_dispatched, ranked.end());
+    std::vector<bool> taken(waiting.size(), false);
+
+    for (size_t i = 0; i < num_dispatched; ++i) {
+        const std::pair<glm::ivec2, uint64_t>& next = waiting[ranked[i].second];
+        taken[ranked[i].second] = true;
+        auto job = std::make_shared<generationJob>();
+        job->GridPosition = next.first;
+        job->JobID = next.second;
+        dispatched[next.first] = job;
+
+        workerQueue& queue = queues[nextWorker];
+        nextWorker = (nextWorker + 1) % numWorkers;
+        {
+            // Counted before it's published, so a worker taking it straight away can't wrap "available" below zero.
+            // Under the lock, so a worker can't check for jobs and go to sleep in between.
+            std::lock_guard<std::mutex> guard(sleepMutex);
+            ++available;
+        }
+        {
+            std::lock_guard<std::mutex> guard(queue.Mutex);
+            queue.Jobs.emplace_back(std::move(job));
+        }
+        cVar.notify_one();
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < waiting.size(); ++i) {
+        if (!taken[i]) {
+            waiting[kept++] = waiting[i];
+        }
+    }
+    waiting.resize(kept);
+}
+
+size_t ChunkGenerationJobSystem::PendingJobs() const noexcept {
+    return currentJobs.size();
+}
+
+size_t ChunkGenerationJobSystem::NumWorkers() const noexcept {
+    return numWorkers;
+}
+
+void ChunkGenerationJobSystem::workerFunction(const size_t worker_idx) {
+    while (true) {
+        std::shared_ptr<generationJob> job = takeJob(worker_idx);
+        if (!job) {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            cVar.wait(lock, [this]()->bool { return shutdown || available != 0; });
+            if (shutdown) {
+                return;
+            }
+            continue;
+        }
+
+        if (job->Cancelled.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        completedJob result{ job->GridPosition, job->JobID, ChunkComponent() };
+        result.Chunk.GridPosition = job->GridPosition;
+        result.Chunk.WorldPosition = glm::vec3(static_cast<float>(job->GridPosition.x) * static_cast<float>(CHUNK_SIZE), 0.0f,
+            static_cast<float>(job->GridPosition.y) * static_cast<float>(CHUNK_SIZE));
+        generator->Generate(result.Chunk);
+        completed.push(std::move(result));
+    }
+}
+
+std::shared_ptr<ChunkGenerationJobSystem::generationJob> ChunkGenerationJobSystem::takeJob(const size_t worker_idx) {
+    {
+        workerQueue& own = queues[worker_idx];
+        std::lock_guard<std::mutex> guard(own.Mutex);
+        if (!own.Jobs.empty()) {
+            std::shared_ptr<generationJob> job = std::move(own.Jobs.front());
+            own.Jobs.pop_front();
+            --available;
+            return job;
+        }
+    }
+    for (size_t i = 1; i < numWorkers; ++i) {
+        workerQueue& victim = queues[(worker_idx + i) % numWorkers];
+        std::lock_guard<std::mutex> guard(victim.Mutex);
+        if (!victim.Jobs.empty()) {
+            std::shared_ptr<generationJob> job = std::move(victim.Jobs.back());
+            victim.Jobs.pop_back();
+            --available;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+bool ChunkGenerationJobSystem::isCurrent(const glm::ivec2& grid_position, const uint64_t job_id) const {
+    auto iter = currentJobs.find(grid_position);
+    return iter != currentJobs.end() && iter->second == job_id;
+}
@@ -1,17 +1,60 @@
 #include "ecs/registry.hpp"
 #include "objects/ChunkManager.hpp"
+#include <algorithm>
+#include <stdexcept>
 
 struct area_t {
 	glm::ivec2 min, max;
 };
 
-ChunkManager::ChunkManager( const size_t & init_view_radius) : renderRadius(init_view_radius) {}
+static std::shared_ptr<terrain::TerrainGenerator> createTerrainGenerator() {
+	auto generator = std::make_shared<terrain::TerrainGenerator>();
+	// The mesher draws every block as an opaque cube, and has no textures for the plants DECORATION places
+	generator->SetStageEnabled(terrain::terrainStage::DECORATION, false);
+	// Chunks are regenerated as a baseline whenever they're saved, so keep the noise for recently generated ones
+	generator->SetStageCached(terrain::terrainStage::HEIGHT, true);
+	generator->SetStageCached(terrain::terrainStage::CAVES, true);
+	return generator;
+}
 
-ecs::entity_t ChunkManager::CreateChunk(const glm::ivec2& grid_position) {
-		
-	//auto new_chunk = std::make_shared<Chunk>(grid_position);
-	//new_chunk->BuildTerrain(0);
+ChunkManager::ChunkManager(const size_t& init_view_radius, const std::string& save_directory) : renderRadius(init_view_radius),
+	terrainGenerator(createTerrainGenerator()) {
+	std::shared_ptr<const terrain::TerrainGenerator> generator = terrainGenerator;
+	TerrainBaseline baseline;
+	// Only known once the stages are set up: switching one changes the terrain
+	baseline.GeneratorVersion = generator->GetVersion();
+	baseline.Generate = [generator](ChunkComponent& chunk) {
+		generator->Generate(chunk);
+	};
+	chunkIO = std::make_unique<ChunkIOService>(save_directory, std::move(baseline));
+	generationJobs = std::make_unique<ChunkGenerationJobSystem>(generator);
+	meshingJobs = std::make_unique<ChunkMeshingJobSystem>();
+}
 
+ChunkManager::~ChunkManager() {
+	// Save everything still loaded, not just chunks waiting on Prune()
+	for (const auto& chunk : chunkMap) {
+		pruneChunks.emplace(chunk.first, chunk.second);
+	}
+	chunkMap.clear();
+	Prune();
+	while (!pruneChunks.empty()) {
+		chunkIO->WaitIdle();
+		Prune();
+	}
+	// chunkIO finishes writing everything queued as it's destroyed
+}
+
+ecs::entity_t ChunkManager::CreateChunk(const glm::ivec2& grid_position) {
+	// One entity per chunk: blocks live in the chunk's own palette storage, starting out as air until a saved copy is loaded
+	// or its terrain is generated
+	auto& registry = ecs::default_registry_t::get_registry();
+	const ecs::entity_t chunk = registry.create();
+	auto& component = registry.assign<ChunkComponent>(chunk);
+	component.GridPosition = grid_position;
+	component.WorldPosition = glm::vec3(static_cast<float>(grid_position.x) * static_cast<float>(CHUNK_SIZE), 0.0f,
+		static_cast<float>(grid_position.y) * static_cast<float>(CHUNK_SIZE));
+	return chunk;
 }
 
 void ChunkManager::Init(const glm::vec3 & initial_position, const int & view_distance) {
@@ -39,9 +82,10 @@ size_t ChunkManager::GetRenderDistance() const noexcept {
 	return renderRadius;
 }
 
-void ChunkManager::Update(const glm::vec3 & update_position) {
+void ChunkManager::Update(const glm::vec3 & update_position, const glm::vec3& view_direction) {
 
 	glm::ivec2 camera_chunk_pos = glm::ivec2(static_cast<int>(update_position.x) / CHUNK_SIZE, static_cast<int>(update_position.z) / CHUNK_SIZE);
+	prefetchAhead(camera_chunk_pos);
 
 	{
 			
@@ -53,8 +97,28 @@ void ChunkManager::Update(const glm::vec3 & update_position) {
 			for (int x = area.min.x; x < area.max.x; ++x) {
 				for (int y = area.min.y; y < area.max.y; ++y) {
                     glm::ivec2 chunk_pos{ x, y };
-					if (chunkMap.count(chunk_pos) == 0) {
-						chunkMap.emplace(chunk_pos, CreateChunk(chunk_pos));
+					if (chunkMap.count(chunk_pos) != 0) {
+						continue;
+					}
+					// Still waiting to be saved, so it's newer than anything on disk: bring it back as it is
+					auto pruned = pruneChunks.find(chunk_pos);
+					if (pruned != pruneChunks.end()) {
+						const ecs::entity_t chunk = pruned->second;
+						pruneChunks.erase(pruned);
+						chunkMap.emplace(chunk_pos, chunk);
+						// Its generation was cancelled when it left view
+						if (generatingChunks.count(chunk) != 0) {
+							generationJobs->Submit(chunk_pos);
+						}
+						onChunkLoaded(chunk_pos);
+						continue;
+					}
+					// Once the I/O queue is full, the rest are picked up on a later frame
+					if (chunkIO->Load(chunk_pos)) {
+						const ecs::entity_t chunk = CreateChunk(chunk_pos);
+						chunkMap.emplace(chunk_pos, chunk);
+						loadingEntities.emplace(chunk);
+						++loadingChunks[chunk_pos];
 					}
 				}
 			}
@@ -68,16 +132,283 @@ void ChunkManager::Update(const glm::vec3 & update_position) {
 		area.min = camera_chunk_pos - static_cast<int>(renderRadius);
 		area.max = camera_chunk_pos + static_cast<int>(renderRadius);
 
+		// Neighbours of a removed chunk keep their current meshes: faces left facing the unloaded
+		// area are just a few extra quads at the edge of the view, not worth re-meshing for.
 		auto iter = chunkMap.begin();
 		while(iter != chunkMap.end()) {
-			const auto& pos = iter->second->GridPosition;
+			const glm::ivec2 pos = iter->first;
 			if (pos.x <= area.min.x || pos.y <= area.min.y || pos.x >= area.max.x || pos.y >= area.max.y) {
-				renderChunks.erase((iter++)->second);
-				chunkMap.erase(pos);
+				if (generatingChunks.count(iter->second) != 0) {
+					generationJobs->Cancel(pos);
+				}
+				pruneChunks.emplace(pos, iter->second);
+				remeshChunks.erase(pos);
+				iter = chunkMap.erase(iter);
 			}
 			else {
 				++iter;
 			}
 		}
 	}
+
+	applyLoadedChunks();
+	generationJobs->Schedule(camera_chunk_pos, glm::vec2(view_direction.x, view_direction.z));
+	applyGeneratedChunks();
+	updateMeshes();
+}
+
+void ChunkManager::Prune() {
+	auto& registry = ecs::default_registry_t::get_registry();
+	auto iter = pruneChunks.begin();
+	while (iter != pruneChunks.end()) {
+		const ecs::entity_t chunk = iter->second;
+		if (registry.alive(chunk) && registry.has<ChunkComponent>(chunk)) {
+			// Saving a chunk whose load hasn't landed would overwrite its saved copy with the placeholder. One never saved
+			// that's still being generated has nothing worth saving either, and nor has a read-only one.
+			const bool placeholder = loadingEntities.count(chunk) != 0 || generatingChunks.count(chunk) != 0 || readOnlyChunks.count(chunk) != 0;
+			if (!placeholder && !chunkIO->Save(registry.get<ChunkComponent>(chunk))) {
+				++iter;
+				continue;
+			}
+		}
+		loadingEntities.erase(chunk);
+		generatingChunks.erase(chunk);
+		readOnlyChunks.erase(chunk);
+		// Meshing jobs still in flight for the chunk are dropped once they finish, as it's no longer alive
+		if (registry.alive(chunk)) {
+			registry.destroy(chunk);
+		}
+		iter = pruneChunks.erase(iter);
+	}
+}
+
+void ChunkManager::SetIOStatsCallback(std::function<void(const ChunkIOStats&)> callback) {
+	chunkIO->SetStatsCallback(std::move(callback));
+}
+
+void ChunkManager::SetGenerationBudget(const double& budget_ms) {
+	generationBudgetMs = budget_ms;
+}
+
+ChunkNeighbors ChunkManager::GetNeighbors(const glm::ivec2& grid_position) const {
+	auto find_chunk = [this](const glm::ivec2& pos) {
+		auto iter = chunkMap.find(pos);
+		return iter != chunkMap.end() ? iter->second : ecs::INVALID_ENTITY;
+	};
+
+	// Grid positions are (x, z) in chunks
+	ChunkNeighbors result;
+	result.PosX = find_chunk(grid_position + glm::ivec2(1, 0));
+	result.NegX = find_chunk(grid_position - glm::ivec2(1, 0));
+	result.PosZ = find_chunk(grid_position + glm::ivec2(0, 1));
+	result.NegZ = find_chunk(grid_position - glm::ivec2(0, 1));
+	return result;
+}
+
+bool ChunkManager::IsReadOnly(const glm::ivec2& grid_position) const {
+	auto iter = chunkMap.find(grid_position);
+	return iter != chunkMap.end() && readOnlyChunks.count(iter->second) != 0;
+}
+
+void ChunkManager::MarkForRemesh(const glm::ivec2& grid_position) {
+	auto iter = chunkMap.find(grid_position);
+	if (iter == chunkMap.end()) {
+		return;
+	}
+	auto& registry = ecs::default_registry_t::get_registry();
+	if (registry.has<ChunkMeshComponent>(iter->second)) {
+		registry.get<ChunkMeshComponent>(iter->second).MarkAllDirty();
+	}
+	remeshChunks.emplace(grid_position);
+}
+
+void ChunkManager::MarkBlockChanged(const glm::ivec2& grid_position, const glm::ivec3& block) {
+	if (block.x < 0 || block.x >= static_cast<int>(CHUNK_SIZE) || block.y < 0 || block.y >= static_cast<int>(CHUNK_SIZE_Y) ||
+		block.z < 0 || block.z >= static_cast<int>(CHUNK_SIZE)) {
+		throw std::out_of_range("Changed block is outside of the chunk");
+	}
+	auto& registry = ecs::default_registry_t::get_registry();
+	auto mark_chunk = [&](const glm::ivec2& pos) {
+		auto iter = chunkMap.find(pos);
+		if (iter == chunkMap.end()) {
+			return;
+		}
+		if (registry.has<ChunkMeshComponent>(iter->second)) {
+			registry.get<ChunkMeshComponent>(iter->second).MarkBlockDirty(static_cast<uint32_t>(block.y));
+		}
+		remeshChunks.emplace(pos);
+	};
+
+	mark_chunk(grid_position);
+	if (block.x == 0) {
+		mark_chunk(grid_position - glm::ivec2(1, 0));
+	}
+	else if (block.x == static_cast<int>(CHUNK_SIZE) - 1) {
+		mark_chunk(grid_position + glm::ivec2(1, 0));
+	}
+	if (block.z == 0) {
+		mark_chunk(grid_position - glm::ivec2(0, 1));
+	}
+	else if (block.z == static_cast<int>(CHUNK_SIZE) - 1) {
+		mark_chunk(grid_position + glm::ivec2(0, 1));
+	}
+}
+
+void ChunkManager::onChunkLoaded(const glm::ivec2& grid_position) {
+	MarkForRemesh(grid_position);
+	MarkForRemesh(grid_position + glm::ivec2(1, 0));
+	MarkForRemesh(grid_position - glm::ivec2(1, 0));
+	MarkForRemesh(grid_position + glm::ivec2(0, 1));
+	MarkForRemesh(grid_position - glm::ivec2(0, 1));
+}
+
+void ChunkManager::applyLoadedChunks() {
+	auto& registry = ecs::default_registry_t::get_registry();
+	chunkIO->DrainCompleted([this, &registry](const glm::ivec2& grid_position, const ChunkLoadStatus status, ChunkComponent* loaded) {
+		auto loading = loadingChunks.find(grid_position);
+		if (loading == loadingChunks.end()) {
+			return;
+		}
+		// The chunk left view and came back while this load was in flight: only the latest load is current
+		if (--loading->second != 0) {
+			return;
+		}
+		loadingChunks.erase(loading);
+
+		// The chunk may have left view since, and be waiting on Prune(): it still gets its blocks, in case it comes back
+		auto iter = chunkMap.find(grid_position);
+		const bool in_view = iter != chunkMap.end();
+		auto pruned = pruneChunks.find(grid_position);
+		if (!in_view && pruned == pruneChunks.end()) {
+			return;
+		}
+		const ecs::entity_t chunk = in_view ? iter->second : pruned->second;
+		if (loadingEntities.erase(chunk) == 0) {
+			return;
+		}
+		if (status == ChunkLoadStatus::Incompatible || status == ChunkLoadStatus::Failed) {
+			// Saved against other terrain, or unreadable for now: saving whatever ends up in its place would lose the saved
+			// copy. It's filled with current terrain rather than left as a hole, but never saved.
+			readOnlyChunks.emplace(chunk);
+		}
+		if (!loaded) {
+			// Chunks out of view are only generated if they come back
+			generatingChunks.emplace(chunk);
+			if (in_view) {
+				generationJobs->Submit(grid_position);
+			}
+			return;
+		}
+		registry.get<ChunkComponent>(chunk).Blocks = std::move(loaded->Blocks);
+		if (in_view) {
+			onChunkLoaded(grid_position);
+		}
+	});
+}
+
+void ChunkManager::applyGeneratedChunks() {
+	auto& registry = ecs::default_registry_t::get_registry();
+	generationJobs->DrainCompleted([this, &registry](const glm::ivec2& grid_position, ChunkComponent& generated) {
+		// Chunks that leave view have their generation cancelled, so this is only a safeguard
+		auto iter = chunkMap.find(grid_position);
+		if (iter == chunkMap.end() || generatingChunks.erase(iter->second) == 0) {
+			return;
+		}
+		registry.get<ChunkComponent>(iter->second).Blocks = std::move(generated.Blocks);
+		onChunkLoaded(grid_position);
+	}, generationBudgetMs);
+}
+
+void ChunkManager::prefetchAhead(const glm::ivec2& camera_chunk_pos) {
+	if (camera_chunk_pos == lastCameraChunk) {
+		return;
+	}
+	auto sign = [](const int val) {
+		return (val > 0) - (val < 0);
+	};
+	const glm::ivec2 delta = camera_chunk_pos - lastCameraChunk;
+	const glm::ivec2 direction(sign(delta.x), sign(delta.y));
+	const bool straight_line = direction == lastMoveDirection;
+	lastCameraChunk = camera_chunk_pos;
+	lastMoveDirection = direction;
+	if (!straight_line) {
+		return;
+	}
+
+	// The strip of chunks just past the edge of the render area, along each axis we're moving on
+	const int radius = static_cast<int>(renderRadius);
+	for (int offset = -radius; offset <= radius; ++offset) {
+		if (direction.x != 0) {
+			chunkIO->Prefetch(camera_chunk_pos + glm::ivec2(direction.x * radius, offset));
+		}
+		if (direction.y != 0) {
+			chunkIO->Prefetch(camera_chunk_pos + glm::ivec2(offset, direction.y * radius));
+		}
+	}
+}
+
+void ChunkManager::updateMeshes() {
+	auto& registry = ecs::default_registry_t::get_registry();
+
+	for (const auto& pos : remeshChunks) {
+		const ecs::entity_t chunk = chunkMap.at(pos);
+		bool whole_chunk = !registry.has<ChunkMeshComponent>(chunk) || registry.get<ChunkMeshComponent>(chunk).Sections.empty();
+		std::vector<uint32_t> sections;
+		if (!whole_chunk) {
+			sections = registry.get<ChunkMeshComponent>(chunk).TakeDirtySections();
+			if (sections.empty()) {
+				continue;
+			}
+			// The new job supersedes any still in flight, so it has to cover that job's sections too
+			auto in_flight = meshingSections.find(chunk);
+			if (in_flight != meshingSections.end()) {
+				if (in_flight->second.empty()) {
+					whole_chunk = true;
+				}
+				else {
+					sections.insert(sections.end(), in_flight->second.begin(), in_flight->second.end());
+				}
+			}
+		}
+		if (whole_chunk) {
+			sections.clear();
+		}
+
+		ChunkMeshSnapshot snapshot = meshingJobs->AcquireSnapshot();
+		ChunkMeshingSystem::CreateSnapshot(chunk, GetNeighbors(pos), sections, DEFAULT_MESH_SECTION_HEIGHT, snapshot);
+		meshingJobs->Submit(chunk, std::move(snapshot));
+		meshingSections[chunk] = std::move(sections);
+	}
+	remeshChunks.clear();
+
+	meshingJobs->DrainCompleted([this, &registry](const ecs::entity_t chunk, const ChunkMeshData& mesh, const MeshingStats&) {
+		meshingSections.erase(chunk);
+		if (!registry.alive(chunk)) {
+			return;
+		}
+		if (!registry.has<ChunkMeshComponent>(chunk)) {
+			registry.assign<ChunkMeshComponent>(chunk).Assign(mesh);
+			return;
+		}
+
+		auto& dest = registry.get<ChunkMeshComponent>(chunk);
+		const bool partial = std::any_of(mesh.Sections.begin(), mesh.Sections.end(), [](const ChunkMeshComponent::section_t& section) {
+			return section.Dirty;
+		});
+		if (partial) {
+			dest.MergeSections(mesh);
+			return;
+		}
+
+		// Keep the existing component (and its GPU buffers), only swapping in the new geometry. Dirty flags
+		// set since the job was submitted are kept, so those sections get meshed again.
+		std::vector<bool> dirty(dest.Sections.size());
+		for (size_t i = 0; i < dest.Sections.size(); ++i) {
+			dirty[i] = dest.Sections[i].Dirty;
+		}
+		dest.Assign(mesh);
+		for (size_t i = 0; i < dirty.size() && i < dest.Sections.size(); ++i) {
+			dest.Sections[i].Dirty = dirty[i];
+		}
+	});
 }
@@ -1,9 +1,16 @@
 #include "objects/ChunkMesh.hpp"
+#include "objects/QuadIndexPattern.hpp"
 #include "objects/Chunk.hpp"
 #include "objects/Block.hpp"
-#include "util/Morton.hpp"
+#include "util/CommonUtil.hpp"
+#include "common/BlockTypes.hpp"
 #include "ecs/registry.hpp"
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 // Face normals. Don't change and can be reused. Yay for cubes!
 static const std::array<glm::ivec3, 6> normals {
@@ -15,28 +22,12 @@ static const std::array<glm::ivec3, 6> normals {
 	glm::ivec3( 0, 0,-1),   // (back)
 };
 
-static const std::array<glm::vec3, 8> base_vertices{
-	glm::vec3(-0.50f,-0.50f, 0.50f), // Point 0, left lower front
-	glm::vec3( 0.50f,-0.50f, 0.50f), // Point 1, right lower front
-	glm::vec3( 0.50f, 0.50f, 0.50f), // Point 2, right upper front 
-	glm::vec3(-0.50f, 0.50f, 0.50f), // Point 3, left upper front
-	glm::vec3( 0.50f,-0.50f,-0.50f), // Point 4, right lower rear
-	glm::vec3(-0.50f,-0.50f,-0.50f), // Point 5, left lower rear
-	glm::vec3(-0.50f, 0.50f,-0.50f), // Point 6, left upper rear
-	glm::vec3( 0.50f, 0.50f,-0.50f), // Point 7, right upper rear
-};
-
-constexpr static std::array<std::initializer_list<uint32_t>, 6> face_indices{
-	std::initializer_list<uint32_t>{ 5, 4, 1, 0 }, // Bottom
-	std::initializer_list<uint32_t>{ 3, 2, 7, 6 }, // Top
-	std::initializer_list<uint32_t>{ 4, 5, 6, 7 }, // Back
-	std::initializer_list<uint32_t>{ 0, 1, 2, 3 }, // Front 
-	std::initializer_list<uint32_t>{ 5, 0, 3, 6 }, // Left
-	std::initializer_list<uint32_t>{ 1, 4, 7, 2 } // Right
-};
+// Every block type but AIR can own faces
+constexpr static size_t NUM_BLOCK_TYPES = static_cast<size_t>(BlockTypes::AIR);
 
-constexpr static size_t textures[24][6] = {
+constexpr static size_t textures[NUM_BLOCK_TYPES][6] = {
 	// Each number corresponds to certain face, and thus certain index into texture array. Given as {front, right, top, left, bottom, back}
+	// Types past the last row have no textures yet, and are left as all zeroes.
 	// Current array order: Bedrock, Grass Top, Grass Sides, Dirt, Stone, Gravel, Sand, Cobble, Coal, Iron, Gold, Diamond, Emerald, Log, Log Top,
 	// Leaves, Planks, Glass, Stonebricks, Bricks, Tall grass, Fern, Flower, Grass Lower, Grass Upper,
 	{  0, 0, 0, 0, 0, 0 }, // Bedrock block
@@ -55,6 +46,14 @@ constexpr static size_t textures[24][6] = {
 	{ 20,20,20,20,20,20 }, // tall grass
 };
 
+// Texture array layer for a face of a block of type "type"
+static inline size_t textureLayer(const size_t type, const size_t face) {
+    if (type >= NUM_BLOCK_TYPES) {
+        throw std::out_of_range("Tried to mesh a face of a block type with no textures");
+    }
+    return textures[type][face];
+}
+
 /*
     The following look-up-tables are used to check a distance from a point
     without incurring a heavy computational expense
@@ -151,121 +150,521 @@ constexpr inline auto PosZDelta(const size_t z) {
     return deltaZ[z];
 }
 
-//void ChunkMeshingSystem::setBlockLightingData(const uint32_t& x, const uint32_t& y, const uint32_t& z, std::array<BlockType, 27>& neighbor_blocks, std::array<float, 27>& neighbor_shades) const {
-//	size_t idx = 0;
-//	if (x > 0 && y > 0 && z > 0 && x < CHUNK_SIZE && y < CHUNK_SIZE_Y && z < CHUNK_SIZE) {
-//		for (int dx = -1; dx <= 1; ++dx) {
-//			for (int dy = -1; dy <= 1; ++dy) {
-//				for (int dz = -1; dz <= 1; ++dz) {
-//					neighbor_blocks[idx] = terrainBlocks[GetBlockIndex(x + dx, y + dy, z + dz)].GetType();
-//					neighbor_shades[idx] = 0.0f;
-//					// If current block is the topmost in this column, do the following.
-//					if (terrainBlocks[GetBlockIndex(x + dx, y + dy + 1, z + dz)].Active()) {
-//						for (int offset_y = 0; offset_y < 8; ++offset_y) {
-//							if (terrainBlocks[GetBlockIndex(x + dx, y + dy + offset_y, z + dz)].Opaque()) {
-//								neighbor_shades[idx] = 1.0f - (static_cast<float>(offset_y) * 0.125f);
-//								break;
-//							}
-//						}
-//					}
-//				}
-//			}
-//			idx++;
-//		}
-//	}
-//}
-
-void ChunkMeshingSystem::createBlockFace(const BlockFace & face, const size_t & uv_idx, const glm::vec3 & pos, ChunkMeshComponent& cmp) {
-    ChunkMeshComponent::vertex_t v0, v1, v2, v3;
-
-    getFaceVertices(face, v0, v1, v2, v3, uv_idx);
-
-    v0.Position += pos;
-    v1.Position += pos;
-    v2.Position += pos;
-    v3.Position += pos;
-
-    uint32_t i0, i1, i2, i3;
-    i0 = cmp.addVertex(std::move(v0));
-    i1 = cmp.addVertex(std::move(v1));
-    i2 = cmp.addVertex(std::move(v2));
-    i3 = cmp.addVertex(std::move(v3));
-
-    cmp.Indices.insert(std::end(cmp.Indices), { i0, i1, i2 });
-    cmp.Indices.insert(std::end(cmp.Indices), { i0, i2, i3 });
-
-}
-
-void ChunkMeshingSystem::GenerateMesh(const ecs::entity_t ent, ChunkMeshComponent & mesh) {
+void ChunkMeshingSystem::createBlockFace(const BlockFace & face, const size_t & uv_idx, const glm::vec3 & pos, const FaceAO ao, ChunkMeshData& cmp) {
+    createMergedFace(face, uv_idx, pos, glm::ivec3(1, 1, 1), ao, cmp);
+}
+
+void ChunkMeshingSystem::createMergedFace(const BlockFace& face, const size_t& uv_idx, const glm::vec3& pos, const glm::ivec3& extent, const FaceAO ao, ChunkMeshData& cmp) {
+    if (cmp.VertexFormat == ChunkVertexFormat::PACKED) {
+        createPackedFace(face, uv_idx, glm::ivec3(pos), extent, ao, cmp);
+        return;
+    }
+
+    // Corners come from the tables packed vertices are decoded with. Greedy meshing with AO emits about twice as many
+    // quads as without, so this has to stay cheap.
+    const size_t f = static_cast<size_t>(face);
+    const float layer = static_cast<float>(textureLayer(uv_idx, f));
+    // UV.x runs from corner 0 to 1 and UV.y from corner 1 to 2. Scale both by the extent along those axes, so that
+    // the texture repeats once per block (requires a sampler using a repeating address mode).
+    const float width = static_cast<float>(extent[packed_vertex::uv_axes[f][0]]);
+    const float height = static_cast<float>(extent[packed_vertex::uv_axes[f][1]]);
+    const glm::vec3 normal(normals[f]);
+
+    // Quads are always split between the first and third vertex added, so starting from corner 1 instead
+    // of 0 flips the split. Rotating the order keeps the winding, and works with shared index patterns too.
+    const uint32_t first_corner = ShouldFlipQuad(ao) ? 1 : 0;
+
+    std::array<uint32_t, 4> idx;
+    for (uint32_t n = 0; n < 4; ++n) {
+        const uint32_t corner = (first_corner + n) % 4;
+        const uint8_t* offset = packed_vertex::corner_offsets[f][corner];
+        ChunkMeshComponent::vertex_t v;
+        // Corners on the positive side of the block get pushed out to cover the whole merged area
+        for (int a = 0; a < 3; ++a) {
+            v.Position[a] = pos[a] - 0.50f + static_cast<float>(offset[a] * extent[a]);
+        }
+        v.Normal = normal;
+        v.UV = glm::vec3(static_cast<float>(packed_vertex::corner_uvs[corner][0]) * width, static_cast<float>(packed_vertex::corner_uvs[corner][1]) * height, layer);
+        v.AO = static_cast<float>(GetCornerAO(ao, corner));
+        idx[n] = cmp.addVertex(v);
+    }
+
+    cmp.addQuadIndices(idx[0], idx[1], idx[2], idx[3]);
+}
+
+void ChunkMeshingSystem::createPackedFace(const BlockFace& face, const size_t& uv_idx, const glm::ivec3& block, const glm::ivec3& extent, const FaceAO ao, ChunkMeshData& cmp) {
+    const size_t f = static_cast<size_t>(face);
+    const uint32_t layer = static_cast<uint32_t>(textureLayer(uv_idx, f));
+    const uint32_t width = static_cast<uint32_t>(extent[packed_vertex::uv_axes[f][0]]);
+    const uint32_t height = static_cast<uint32_t>(extent[packed_vertex::uv_axes[f][1]]);
+
+    // Same corners and triangulation as createMergedFace() gives vertex_t
+    const uint32_t first_corner = ShouldFlipQuad(ao) ? 1 : 0;
+    std::array<uint32_t, 4> idx;
+    for (uint32_t n = 0; n < 4; ++n) {
+        const uint32_t corner = (first_corner + n) % 4;
+        idx[n] = cmp.addVertex(PackChunkVertex(block, face, corner, layer, width, height, GetCornerAO(ao, corner)));
+    }
+
+    cmp.addQuadIndices(idx[0], idx[1], idx[2], idx[3]);
+}
+
+// Output arena for the synchronous entry points, which copy the result out before returning
+static ChunkMeshArena& getThreadArena() {
+    thread_local ChunkMeshArena arena;
+    return arena;
+}
+
+static ChunkMeshData getMeshSettings(const ChunkMeshComponent& mesh) {
+    ChunkMeshData result;
+    result.VertexFormat = mesh.VertexFormat;
+    result.IndexMode = mesh.IndexMode;
+    result.AmbientOcclusion = mesh.AmbientOcclusion;
+    return result;
+}
+
+MeshingStats ChunkMeshingSystem::GenerateMesh(const ecs::entity_t ent, ChunkMeshComponent & mesh, const MeshingMode mode) {
+    ChunkMeshArena& arena = getThreadArena();
+    arena.Reset();
+    ChunkMeshData result = getMeshSettings(mesh);
+    const MeshingStats stats = GenerateMesh(CreateSnapshot(ent), arena, result, mode);
+    mesh.Assign(result);
+    return stats;
+}
+
+MeshingStats ChunkMeshingSystem::UpdateMesh(const ecs::entity_t ent, const ChunkNeighbors& neighbors, ChunkMeshComponent& mesh, const MeshingMode mode) {
+    const bool whole_chunk = mesh.Sections.empty();
+    const std::vector<uint32_t> sections = mesh.TakeDirtySections();
+    if (!whole_chunk && sections.empty()) {
+        return MeshingStats();
+    }
+
+    ChunkMeshArena& arena = getThreadArena();
+    arena.Reset();
+    ChunkMeshData result = getMeshSettings(mesh);
+    const MeshingStats stats = GenerateMesh(CreateSnapshot(ent, neighbors, sections, mesh.SectionHeight), arena, result, mode);
+    if (whole_chunk) {
+        mesh.Assign(result);
+    }
+    else {
+        mesh.MergeSections(result);
+    }
+    return stats;
+}
+
+static uint32_t getSectionCount(const uint32_t section_height) {
+    if (section_height == 0 || CHUNK_SIZE_Y % section_height != 0) {
+        throw std::domain_error("Mesh section height must evenly divide CHUNK_SIZE_Y");
+    }
+    return static_cast<uint32_t>(CHUNK_SIZE_Y) / section_height;
+}
+
+ChunkMeshSnapshot ChunkMeshingSystem::CreateSnapshot(const ecs::entity_t ent, const ChunkNeighbors& neighbors, const std::vector<uint32_t>& sections, const uint32_t section_height) {
+    ChunkMeshSnapshot snapshot;
+    CreateSnapshot(ent, neighbors, sections, section_height, snapshot);
+    return snapshot;
+}
+
+void ChunkMeshingSystem::CreateSnapshot(const ecs::entity_t ent, const ChunkNeighbors& neighbors, const std::vector<uint32_t>& sections, const uint32_t section_height,
+    ChunkMeshSnapshot& snapshot) {
     using namespace ecs;
-    // Iterate through every block in this chunk one-by-one to decide how/if to render it.
     auto& registry = default_registry_t::get_registry();
+    const auto& chunk_component = registry.get<ChunkComponent>(ent);
+
+    snapshot.SectionHeight = section_height;
+    snapshot.Sections = sections;
+    snapshot.Borders = ChunkBorderMasks();
+
+    // Meshing a section reads one layer past it on either side, for culling and AO.
+    const uint32_t section_count = getSectionCount(section_height);
+    std::array<bool, CHUNK_SIZE_Y> copy_layer;
+    copy_layer.fill(sections.empty());
+    for (const uint32_t section : sections) {
+        if (section >= section_count) {
+            throw std::out_of_range("Mesh section index is past the top of the chunk");
+        }
+        const uint32_t y_begin = section * section_height;
+        const uint32_t y_end = y_begin + section_height;
+        std::fill(copy_layer.begin() + (y_begin > 0 ? y_begin - 1 : 0), copy_layer.begin() + std::min<uint32_t>(y_end + 1, CHUNK_SIZE_Y), true);
+    }
 
-    auto& chunk_component = registry.get<ChunkComponent>(ent);
+    // Decode the needed layers once, then do all the culling work on bitmasks. Reuses the storage "snapshot" already has.
+    snapshot.Blocks.assign(BLOCKS_PER_CHUNK, static_cast<BlockType>(BlockTypes::AIR));
+    for (uint32_t j = 0; j < CHUNK_SIZE_Y;) {
+        if (!copy_layer[j]) {
+            ++j;
+            continue;
+        }
+        const uint32_t run_begin = j;
+        while (j < CHUNK_SIZE_Y && copy_layer[j]) {
+            ++j;
+        }
+        chunk_component.Blocks.CopyTypes(snapshot.Blocks.data(), run_begin, j);
+    }
 
-    auto block_alive = [&chunk_component,&registry](const uint32_t i, const uint32_t j, const uint32_t k) {
-        return registry.alive(chunk_component.Blocks[morton_encode(i, j, k)]);
+    // Border slices: only the opacity of the single layer of blocks facing this chunk is needed
+    auto copy_border = [&registry, &copy_layer](const entity_t neighbor, std::array<uint32_t, CHUNK_SIZE_Y>& dest, const bool along_z, const uint32_t fixed) {
+        if (!registry.alive(neighbor)) {
+            return;
+        }
+        const auto& neighbor_chunk = registry.get<ChunkComponent>(neighbor);
+        for (uint32_t j = 0; j < CHUNK_SIZE_Y; ++j) {
+            if (!copy_layer[j]) {
+                continue;
+            }
+            uint32_t row = 0;
+            for (uint32_t n = 0; n < CHUNK_SIZE; ++n) {
+                const BlockType type = along_z ? neighbor_chunk.Blocks.GetType(fixed, j, n) : neighbor_chunk.Blocks.GetType(n, j, fixed);
+                if (type != static_cast<BlockType>(BlockTypes::AIR)) {
+                    row |= (1u << n);
+                }
+            }
+            dest[j] = row;
+        }
     };
 
+    copy_border(neighbors.PosX, snapshot.Borders.PosX, true, 0);
+    copy_border(neighbors.NegX, snapshot.Borders.NegX, true, CHUNK_SIZE - 1);
+    copy_border(neighbors.PosZ, snapshot.Borders.PosZ, false, 0);
+    copy_border(neighbors.NegZ, snapshot.Borders.NegZ, false, CHUNK_SIZE - 1);
+}
 
-    for (uint32_t k = 0; k < CHUNK_SIZE; ++k) {
-        for (uint32_t j = 0; j < CHUNK_SIZE_Y; ++j) {
-            for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
-                // Get index of the current block we're at.
-                uint32_t idx = morton_encode(i, j, k);
-                entity_t block = chunk_component.Blocks[idx];
+// Scratch space for one slice of greedy meshing, per thread. See generateGreedy(): left zeroed after every use.
+using sliceMask = std::array<uint32_t, CHUNK_SIZE * CHUNK_SIZE_Y>;
 
-                if (!registry.alive(chunk_component.Blocks[idx])) {
+static uint32_t* getThreadSliceMask() {
+    // Value-initialized, so the mask starts out zeroed
+    thread_local std::unique_ptr<sliceMask> mask = std::make_unique<sliceMask>();
+    return mask->data();
+}
+
+static size_t getVertexSize(const ChunkVertexFormat format) noexcept {
+    return format == ChunkVertexFormat::PACKED ? sizeof(packed_chunk_vertex_t) : sizeof(ChunkMeshComponent::vertex_t);
+}
+
+MeshingStats ChunkMeshingSystem::GenerateMesh(const ChunkMeshSnapshot& snapshot, ChunkMeshArena& arena, ChunkMeshData& result, const MeshingMode mode) {
+    const ChunkMeshPlan plan = PlanMesh(snapshot, arena, result, mode);
+    // Bottom to top, which keeps the reserved ranges in the order they'll end up in anyways
+    for (const uint32_t section : plan.Sections) {
+        FillSection(plan, section, result);
+    }
+    return FinishMesh(plan, result);
+}
+
+ChunkMeshPlan ChunkMeshingSystem::PlanMesh(const ChunkMeshSnapshot& snapshot, ChunkMeshArena& arena, ChunkMeshData& result, const MeshingMode mode) {
+    if (mode != MeshingMode::NAIVE && mode != MeshingMode::GREEDY) {
+        throw std::domain_error("Invalid meshing mode passed to PlanMesh");
+    }
+
+    const uint32_t section_count = getSectionCount(snapshot.SectionHeight);
+    std::array<bool, CHUNK_SIZE_Y> selected;
+    selected.fill(snapshot.Sections.empty());
+    for (const uint32_t section : snapshot.Sections) {
+        if (section >= section_count) {
+            throw std::out_of_range("Mesh section index is past the top of the chunk");
+        }
+        selected[section] = true;
+    }
+    const uint32_t selected_count = static_cast<uint32_t>(std::count(selected.cbegin(), selected.cbegin() + section_count, true));
+
+    ChunkMeshPlan plan;
+    plan.Start = std::chrono::high_resolution_clock::now();
+    plan.Snapshot = &snapshot;
+    plan.Mode = mode;
+    plan.Sections = arena.Allocate<uint32_t>(selected_count);
+
+    // The masks are read by every thread filling sections, so they belong to the plan rather than to this thread
+    ChunkOpacityMask* opacity = arena.Allocate<ChunkOpacityMask>(1).data();
+    ChunkFaceMasks* faces = arena.Allocate<ChunkFaceMasks>(1).data();
+    plan.Opacity = opacity;
+    plan.Faces = faces;
+
+    result.SectionHeight = snapshot.SectionHeight;
+    result.Sections = arena.Allocate<ChunkMeshComponent::section_t>(section_count);
+    std::fill(result.Sections.begin(), result.Sections.end(), ChunkMeshComponent::section_t());
+
+    // Counting pass: build the masks of each section being meshed, and popcount its visible faces. Each face becomes
+    // at most one quad, which bounds the section's output: reserve that much for it, directly after the section below.
+    // Face masks of different sections don't overlap, so they all stay valid for the filling pass.
+    const uint32_t indices_per_quad = result.IndexMode == ChunkIndexMode::PER_CHUNK ? QuadIndexPattern::INDICES_PER_QUAD : 0;
+    size_t quad_count = 0;
+    size_t num_planned = 0;
+    for (uint32_t section = 0; section < section_count; ++section) {
+        if (!selected[section]) {
+            continue;
+        }
+        const uint32_t y_begin = section * snapshot.SectionHeight;
+        const uint32_t y_end = y_begin + snapshot.SectionHeight;
+        // Masks are built one layer past the section on either side, which culling and AO need
+        BuildOpacityMask(snapshot.Blocks.data(), *opacity, y_begin > 0 ? y_begin - 1 : 0, std::min<uint32_t>(y_end + 1, CHUNK_SIZE_Y));
+        BuildFaceMasks(*opacity, snapshot.Borders, *faces, y_begin, y_end);
+        size_t face_count = 0;
+        for (const auto& rows : faces->Faces) {
+            for (size_t row = GetRowIndex(y_begin, 0); row < GetRowIndex(y_end, 0); ++row) {
+                face_count += PopCount(rows[row]);
+            }
+        }
+
+        auto& range = result.Sections[section];
+        range.FirstVertex = static_cast<uint32_t>(quad_count * QuadIndexPattern::VERTICES_PER_QUAD);
+        range.FirstIndex = static_cast<uint32_t>(quad_count * indices_per_quad);
+        plan.Sections[num_planned++] = section;
+        quad_count += face_count;
+    }
+    plan.ReservedQuads = quad_count;
+
+    // Allocate the output exactly once. Spans are sized to what's been written by FinishMesh().
+    const size_t max_vertices = quad_count * QuadIndexPattern::VERTICES_PER_QUAD;
+    result.Indices = span_t<uint32_t>(arena.Allocate<uint32_t>(quad_count * indices_per_quad).data(), 0);
+    if (result.VertexFormat == ChunkVertexFormat::PACKED) {
+        result.Vertices = span_t<ChunkMeshComponent::vertex_t>();
+        result.PackedVertices = span_t<packed_chunk_vertex_t>(arena.Allocate<packed_chunk_vertex_t>(max_vertices).data(), 0);
+    }
+    else {
+        result.Vertices = span_t<ChunkMeshComponent::vertex_t>(arena.Allocate<ChunkMeshComponent::vertex_t>(max_vertices).data(), 0);
+        result.PackedVertices = span_t<packed_chunk_vertex_t>();
+    }
+
+    return plan;
+}
+
+void ChunkMeshingSystem::FillSection(const ChunkMeshPlan& plan, const uint32_t section, ChunkMeshData& result) {
+    auto& range = result.Sections[section];
+    const uint32_t y_begin = section * plan.Snapshot->SectionHeight;
+    const uint32_t y_end = y_begin + plan.Snapshot->SectionHeight;
+
+    // Write through a view of just this section's reserved range, so sections never touch shared counters
+    ChunkMeshData window;
+    window.VertexFormat = result.VertexFormat;
+    window.IndexMode = result.IndexMode;
+    window.AmbientOcclusion = result.AmbientOcclusion;
+    window.vertexBase = range.FirstVertex;
+    if (result.IndexMode == ChunkIndexMode::PER_CHUNK) {
+        window.Indices = span_t<uint32_t>(result.Indices.data() + range.FirstIndex, 0);
+    }
+    if (result.VertexFormat == ChunkVertexFormat::PACKED) {
+        window.PackedVertices = span_t<packed_chunk_vertex_t>(result.PackedVertices.data() + range.FirstVertex, 0);
+    }
+    else {
+        window.Vertices = span_t<ChunkMeshComponent::vertex_t>(result.Vertices.data() + range.FirstVertex, 0);
+    }
+
+    const meshingMasks masks{ *plan.Opacity, plan.Snapshot->Borders, *plan.Faces, getThreadSliceMask() };
+    if (plan.Mode == MeshingMode::NAIVE) {
+        generateNaive(plan.Snapshot->Blocks.data(), masks, y_begin, y_end, window);
+    }
+    else {
+        generateGreedy(plan.Snapshot->Blocks.data(), masks, y_begin, y_end, window);
+    }
+
+    range.VertexCount = static_cast<uint32_t>(window.VertexCount());
+    range.IndexCount = static_cast<uint32_t>(window.Indices.size());
+    range.Dirty = false;
+}
+
+MeshingStats ChunkMeshingSystem::FinishMesh(const ChunkMeshPlan& plan, ChunkMeshData& result) {
+    // Naive meshing fills every reservation exactly. Greedy meshing merges faces, leaving a gap after each section:
+    // close them up, bottom to top, so the output is contiguous. Indices hold absolute vertex numbers, so rebase them.
+    size_t vertex_end = 0;
+    size_t index_end = 0;
+    for (const uint32_t section : plan.Sections) {
+        auto& range = result.Sections[section];
+        const uint32_t vertex_delta = range.FirstVertex - static_cast<uint32_t>(vertex_end);
+        if (vertex_delta != 0) {
+            if (result.VertexFormat == ChunkVertexFormat::PACKED) {
+                packed_chunk_vertex_t* src = result.PackedVertices.data() + range.FirstVertex;
+                std::copy(src, src + range.VertexCount, result.PackedVertices.data() + vertex_end);
+            }
+            else {
+                ChunkMeshComponent::vertex_t* src = result.Vertices.data() + range.FirstVertex;
+                std::copy(src, src + range.VertexCount, result.Vertices.data() + vertex_end);
+            }
+        }
+        if (range.FirstIndex != index_end || vertex_delta != 0) {
+            uint32_t* src = result.Indices.data() + range.FirstIndex;
+            uint32_t* dest = result.Indices.data() + index_end;
+            for (uint32_t i = 0; i < range.IndexCount; ++i) {
+                dest[i] = src[i] - vertex_delta;
+            }
+        }
+        range.FirstVertex = static_cast<uint32_t>(vertex_end);
+        range.FirstIndex = static_cast<uint32_t>(index_end);
+        vertex_end += range.VertexCount;
+        index_end += range.IndexCount;
+    }
+    result.Indices.count = index_end;
+    if (result.VertexFormat == ChunkVertexFormat::PACKED) {
+        result.PackedVertices.count = vertex_end;
+    }
+    else {
+        result.Vertices.count = vertex_end;
+    }
+
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    MeshingStats stats;
+    stats.VertexCount = result.VertexCount();
+    stats.IndexCount = result.Indices.size();
+    stats.VertexDataSize = result.VertexDataSize();
+    stats.IndexDataSize = result.Indices.size() * sizeof(uint32_t);
+    stats.ReservedDataSize = plan.ReservedQuads * (QuadIndexPattern::VERTICES_PER_QUAD * getVertexSize(result.VertexFormat) +
+        (result.IndexMode == ChunkIndexMode::PER_CHUNK ? QuadIndexPattern::INDICES_PER_QUAD * sizeof(uint32_t) : 0));
+    stats.MeshingTimeMs = std::chrono::duration<double, std::milli>(end - plan.Start).count();
+    return stats;
+}
+
+void ChunkMeshingSystem::generateNaive(const BlockType* blocks, const meshingMasks& masks, const uint32_t y_begin, const uint32_t y_end, ChunkMeshData & mesh) {
+    // Only blocks with their bit set in a face mask have that face visible, so walk the set bits.
+    for (size_t f = 0; f < 6; ++f) {
+        const BlockFace face = static_cast<BlockFace>(f);
+        const auto& rows = masks.Faces.Faces[f];
+        for (uint32_t j = y_begin; j < y_end; ++j) {
+            for (uint32_t k = 0; k < CHUNK_SIZE; ++k) {
+                uint32_t bits = rows[GetRowIndex(j, k)];
+                if (bits == 0) {
                     continue;
                 }
-                else {
-                    auto& curr_block = registry.get<BlockComponent>(chunk_component.Blocks[idx]);
+                FaceAORow ao_row;
+                if (mesh.AmbientOcclusion) {
+                    LoadFaceAORow(masks.Opacity, masks.Borders, j, k, face, ao_row);
+                }
+                while (bits != 0) {
+                    const uint32_t i = CountTrailingZeros(bits);
+                    bits &= bits - 1;
+                    const glm::vec3 block_pos(static_cast<float>(i), static_cast<float>(j), static_cast<float>(k));
+                    const FaceAO ao = mesh.AmbientOcclusion ? ComputeFaceAO(ao_row, i) : FACE_AO_UNOCCLUDED;
+                    createBlockFace(face, blocks[GetBlockIndex(i, j, k)], block_pos, ao, mesh);
+                }
+            }
+        }
+    }
+}
 
-                    bool xNeg = true; // left
-                    if (i > 0) {
-                        if (!terrainBlocks[GetBlockIndex(i - 1, j, k)].Active()) {
-                            xNeg = false;
+// Axis (x = 0, y = 1, z = 2) that each face's normal lies along. Indexed by BlockFace.
+constexpr static std::array<int, 6> face_axis{ 2, 0, 1, 0, 1, 2 };
+constexpr static std::array<int, 3> chunk_dimensions{ static_cast<int>(CHUNK_SIZE), static_cast<int>(CHUNK_SIZE_Y), static_cast<int>(CHUNK_SIZE) };
+
+// Greedy mask entries keep the face's AO in the top byte, and the block type plus one below it
+constexpr static uint32_t MASK_AO_SHIFT = 24;
+constexpr static uint32_t MASK_TYPE_MASK = (1u << MASK_AO_SHIFT) - 1;
+
+void ChunkMeshingSystem::generateGreedy(const BlockType* blocks, const meshingMasks& masks, const uint32_t y_begin, const uint32_t y_end, ChunkMeshData & mesh) {
+
+    // Each entry of the mask is the type of the block owning a visible face plus one, or 0 if there's no face
+    // there. Sized for the largest slice, which is the 32x128 one. Merging consumes every face it finds, so
+    // the mask is back to all zeroes at the end of each slice.
+    uint32_t* mask = masks.SliceMask;
+
+    for (size_t f = 0; f < 6; ++f) {
+        const BlockFace face = static_cast<BlockFace>(f);
+        const auto& rows = masks.Faces.Faces[f];
+        const int axis = face_axis[f];
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        const int u_dim = chunk_dimensions[u];
+        // Only the part of each slice inside [y_begin, y_end) is meshed, so faces never merge across sections
+        const glm::ivec3 lower(0, static_cast<int>(y_begin), 0);
+        const glm::ivec3 upper(chunk_dimensions[0], static_cast<int>(y_end), chunk_dimensions[2]);
+
+        // Faces merge if they share a texture, even if the block types differ. Their AO has to match too,
+        // as the merged quad only has the four corners to interpolate between.
+        auto same_texture = [f](const uint32_t a, const uint32_t b) {
+            return (a != 0) && (b != 0) && ((a >> MASK_AO_SHIFT) == (b >> MASK_AO_SHIFT)) &&
+                (textureLayer((a & MASK_TYPE_MASK) - 1, f) == textureLayer((b & MASK_TYPE_MASK) - 1, f));
+        };
+
+        for (int s = lower[axis]; s < upper[axis]; ++s) {
+
+            bool slice_empty = true;
+            auto mark_face = [&](const uint32_t i, const uint32_t j, const uint32_t k, const FaceAO ao) {
+                const glm::ivec3 p(i, j, k);
+                mask[p[u] + p[v] * u_dim] = (static_cast<uint32_t>(blocks[GetBlockIndex(i, j, k)]) + 1) | (static_cast<uint32_t>(ao) << MASK_AO_SHIFT);
+                slice_empty = false;
+            };
+
+            auto mark_row = [&](uint32_t bits, const uint32_t j, const uint32_t k) {
+                if (bits == 0) {
+                    return;
+                }
+                FaceAORow ao_row;
+                if (mesh.AmbientOcclusion) {
+                    LoadFaceAORow(masks.Opacity, masks.Borders, j, k, face, ao_row);
+                }
+                while (bits != 0) {
+                    const uint32_t i = CountTrailingZeros(bits);
+                    bits &= bits - 1;
+                    mark_face(i, j, k, mesh.AmbientOcclusion ? ComputeFaceAO(ao_row, i) : FACE_AO_UNOCCLUDED);
+                }
+            };
+
+            // Rows run along x, so x slices test one bit of every row while y and z slices take whole rows.
+            if (axis == 0) {
+                const uint32_t i = static_cast<uint32_t>(s);
+                for (uint32_t j = y_begin; j < y_end; ++j) {
+                    for (uint32_t k = 0; k < CHUNK_SIZE; ++k) {
+                        if ((rows[GetRowIndex(j, k)] >> i) & 1u) {
+                            mark_face(i, j, k, mesh.AmbientOcclusion ? ComputeFaceAO(masks.Opacity, masks.Borders, i, j, k, face) : FACE_AO_UNOCCLUDED);
                         }
                     }
+                }
+            }
+            else if (axis == 1) {
+                for (uint32_t k = 0; k < CHUNK_SIZE; ++k) {
+                    mark_row(rows[GetRowIndex(s, k)], static_cast<uint32_t>(s), k);
+                }
+            }
+            else {
+                for (uint32_t j = y_begin; j < y_end; ++j) {
+                    mark_row(rows[GetRowIndex(j, s)], j, static_cast<uint32_t>(s));
+                }
+            }
 
-                    bool xPos = true; // right
-                    if (i < CHUNK_SIZE - 1) {
-                        if (!terrainBlocks[GetBlockIndex(i + 1, j, k)].Active()) {
-                            xPos = false;
-                        }
-                    }
+            if (slice_empty) {
+                continue;
+            }
 
-                    bool yPos = true; // bottom
-                    if (j > 0) {
-                        if (!terrainBlocks[GetBlockIndex(i, j - 1, k)].Active()) {
-                            yPos = false;
-                        }
+            // Grow a rectangle from each unconsumed face: first along u, then along v while the whole row matches.
+            for (int j = lower[v]; j < upper[v]; ++j) {
+                for (int i = lower[u]; i < upper[u];) {
+                    const uint32_t curr = mask[i + j * u_dim];
+                    if (curr == 0) {
+                        ++i;
+                        continue;
                     }
 
-                    bool yNeg = true; // top
-                    if (j < CHUNK_SIZE_Y - 1) {
-                        //std::cerr << GetBlockIndex(i, j - 1, k);
-                        if (!terrainBlocks[GetBlockIndex(i, j + 1, k)].Active()) {
-                            yNeg = false;
-                        }
+                    int width = 1;
+                    while (i + width < upper[u] && same_texture(curr, mask[i + width + j * u_dim])) {
+                        ++width;
                     }
 
-                    bool zNeg = true; // back
-                    if (k < CHUNK_SIZE - 1) {
-                        if (!terrainBlocks[GetBlockIndex(i, j, k + 1)].Active()) {
-                            zNeg = false;
+                    int height = 1;
+                    bool row_matches = true;
+                    while (j + height < upper[v] && row_matches) {
+                        for (int w = 0; w < width; ++w) {
+                            if (!same_texture(curr, mask[i + w + (j + height) * u_dim])) {
+                                row_matches = false;
+                                break;
+                            }
                         }
-                    }
-
-                    bool zPos = true; // front
-                    if (k > 0) {
-                        if (!terrainBlocks[GetBlockIndex(i, j, k - 1)].Active()) {
-                            zPos = false;
+                        if (row_matches) {
+                            ++height;
                         }
                     }
 
-                    createCube(i, j, k, zNeg, xPos, yNeg, xNeg, yPos, zPos, uv_type);
+                    glm::ivec3 origin;
+                    origin[axis] = s;
+                    origin[u] = i;
+                    origin[v] = j;
+                    glm::ivec3 extent{ 1, 1, 1 };
+                    extent[u] = width;
+                    extent[v] = height;
+                    createMergedFace(face, (curr & MASK_TYPE_MASK) - 1, glm::vec3(origin), extent, static_cast<FaceAO>(curr >> MASK_AO_SHIFT), mesh);
+
+                    for (int h = 0; h < height; ++h) {
+                        std::fill_n(mask + i + (j + h) * u_dim, width, 0u);
+                    }
 
+                    i += width;
                 }
             }
         }
@@ -273,95 +672,153 @@ void ChunkMeshingSystem::GenerateMesh(const ecs::entity_t ent, ChunkMeshComponen
 
 }
 
-void ChunkMeshingSystem::getFaceVertices(const BlockFace& face, ChunkMeshComponent::vertex_t& v0, ChunkMeshComponent::vertex_t& v1, ChunkMeshComponent::vertex_t& v2, ChunkMeshComponent::vertex_t& v3,
-    const size_t& texture_idx) {
-    switch (face) {
-    case BlockFace::BOTTOM:
-        v0.Position = base_vertices[5];
-        v1.Position = base_vertices[4];
-        v2.Position = base_vertices[1];
-        v3.Position = base_vertices[0];
-        break;
-    case BlockFace::TOP:
-        v0.Position = base_vertices[3];
-        v1.Position = base_vertices[2];
-        v2.Position = base_vertices[7];
-        v3.Position = base_vertices[6];
-        break;
-    case BlockFace::BACK:
-        v0.Position = base_vertices[4];
-        v1.Position = base_vertices[5];
-        v2.Position = base_vertices[6];
-        v3.Position = base_vertices[7];
-        break;
-    case BlockFace::FRONT:
-        v0.Position = base_vertices[0];
-        v1.Position = base_vertices[1];
-        v2.Position = base_vertices[2];
-        v3.Position = base_vertices[3];
-        break;
-    case BlockFace::LEFT:
-        v0.Position = base_vertices[5];
-        v1.Position = base_vertices[0];
-        v2.Position = base_vertices[3];
-        v3.Position = base_vertices[6];
-        break;
-    case BlockFace::RIGHT:
-        v0.Position = base_vertices[1];
-        v1.Position = base_vertices[4];
-        v2.Position = base_vertices[7];
-        v3.Position = base_vertices[2];
-        break;
-    default:
-        throw std::runtime_error("Tried to create face with invalid face type enum value");
-    }
-
-    v0.Normal = v1.Normal = v2.Normal = v3.Normal = normals[static_cast<size_t>(face)];
-    v0.UV = glm::ivec3(0, 0, textures[texture_idx][static_cast<size_t>(face)]);
-    v1.UV = glm::ivec3(1, 0, textures[texture_idx][static_cast<size_t>(face)]);
-    v2.UV = glm::ivec3(1, 1, textures[texture_idx][static_cast<size_t>(face)]);
-    v3.UV = glm::ivec3(0, 1, textures[texture_idx][static_cast<size_t>(face)]);
-}
-
-void ChunkMeshingSystem::createCube(const size_t& x, const size_t& y, const size_t& z, const bool& front_face, const bool& right_face, const bool& top_face, const bool& left_face,
-	const bool& bottom_face, const bool& back_face, const size_t& uv_idx, ChunkMeshComponent& cmp) {
-
-	// Following method for generating lighting data from:
-	// https://github.com/fogleman/Craft/blob/master/src/main.c#L1077
-	/*std::array<BlockType, 27> neighbors;
-	std::array<float, 27> shades;
-	setBlockLightingData(x, y, z, neighbors, shades);*/
-
-	// Builds a side of a cube
-	glm::vec3 block_pos = glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
-
-	if (!front_face) {
-		createBlockFace(BlockFace::FRONT, uv_idx, block_pos, cmp);
-	}
-
-	if (!right_face) {
-		createBlockFace(BlockFace::RIGHT, uv_idx, block_pos, cmp);
-	}
-
-	if (!top_face) {
-		createBlockFace(BlockFace::TOP, uv_idx, block_pos, cmp);
-	}
-
-	if (!left_face) {
-		createBlockFace(BlockFace::LEFT, uv_idx, block_pos, cmp);
-	}
-
-	if (!bottom_face) {
-		createBlockFace(BlockFace::BOTTOM, uv_idx, block_pos, cmp);
-	}
-
-	if (!back_face) {
-		createBlockFace(BlockFace::BACK, uv_idx, block_pos, cmp);
-	}
-
-}
-
-uint32_t ChunkMeshComponent::addVertex(vertex_t && v) {
-    Vertices.emplace_back(v);
-    return Vertices.size() - 1;
+size_t ChunkMeshComponent::VertexCount() const noexcept {
+    return VertexFormat == ChunkVertexFormat::PACKED ? PackedVertices.size() : Vertices.size();
+}
+
+size_t ChunkMeshComponent::VertexDataSize() const noexcept {
+    return VertexFormat == ChunkVertexFormat::PACKED ? PackedVertices.size() * sizeof(packed_chunk_vertex_t) : Vertices.size() * sizeof(vertex_t);
+}
+
+uint32_t ChunkMeshComponent::QuadCount() const noexcept {
+    return static_cast<uint32_t>(VertexCount() / QuadIndexPattern::VERTICES_PER_QUAD);
+}
+
+void ChunkMeshComponent::MarkBlockDirty(const uint32_t y) {
+    if (y >= CHUNK_SIZE_Y) {
+        throw std::out_of_range("Block height is past the top of the chunk");
+    }
+    if (Sections.empty()) {
+        // Never meshed, so there's nothing to invalidate
+        return;
+    }
+    const uint32_t section = y / SectionHeight;
+    Sections[section].Dirty = true;
+    // Faces in the layers either side of "y" are culled and shaded against it
+    if (y % SectionHeight == 0 && section > 0) {
+        Sections[section - 1].Dirty = true;
+    }
+    if (y % SectionHeight == SectionHeight - 1 && section + 1 < Sections.size()) {
+        Sections[section + 1].Dirty = true;
+    }
+}
+
+void ChunkMeshComponent::MarkAllDirty() {
+    for (auto& section : Sections) {
+        section.Dirty = true;
+    }
+}
+
+void ChunkMeshComponent::Assign(const ChunkMeshData& src) {
+    VertexFormat = src.VertexFormat;
+    IndexMode = src.IndexMode;
+    AmbientOcclusion = src.AmbientOcclusion;
+    SectionHeight = src.SectionHeight;
+    Sections.assign(src.Sections.begin(), src.Sections.end());
+    Indices.assign(src.Indices.begin(), src.Indices.end());
+    Vertices.assign(src.Vertices.begin(), src.Vertices.end());
+    PackedVertices.assign(src.PackedVertices.begin(), src.PackedVertices.end());
+    if (IndexMode == ChunkIndexMode::SHARED_QUADS) {
+        // Release anything left over from meshing this chunk with per-chunk indices
+        Indices.shrink_to_fit();
+    }
+}
+
+std::vector<uint32_t> ChunkMeshComponent::TakeDirtySections() {
+    std::vector<uint32_t> result;
+    for (uint32_t i = 0; i < Sections.size(); ++i) {
+        if (Sections[i].Dirty) {
+            result.emplace_back(i);
+            Sections[i].Dirty = false;
+        }
+    }
+    return result;
+}
+
+// Replaces "count" elements of "dest" starting at "first" with "src_count" elements from "src"
+template<typename T>
+static void spliceRange(std::vector<T>& dest, const size_t first, const size_t count, const T* src, const size_t src_count) {
+    if (src_count > count) {
+        dest.insert(dest.begin() + first + count, src_count - count, T());
+    }
+    else if (src_count < count) {
+        dest.erase(dest.begin() + first + src_count, dest.begin() + first + count);
+    }
+    std::copy(src, src + src_count, dest.begin() + first);
+}
+
+void ChunkMeshComponent::MergeSections(const ChunkMeshData& src) {
+    if (src.VertexFormat != VertexFormat || src.IndexMode != IndexMode || src.SectionHeight != SectionHeight || src.Sections.size() != Sections.size()) {
+        throw std::runtime_error("Tried to merge mesh sections generated with different settings");
+    }
+
+    for (size_t i = 0; i < Sections.size(); ++i) {
+        const section_t& incoming = src.Sections[i];
+        if (incoming.Dirty) {
+            continue;
+        }
+        section_t& section = Sections[i];
+
+        if (VertexFormat == ChunkVertexFormat::PACKED) {
+            spliceRange(PackedVertices, section.FirstVertex, section.VertexCount, src.PackedVertices.data() + incoming.FirstVertex, incoming.VertexCount);
+        }
+        else {
+            spliceRange(Vertices, section.FirstVertex, section.VertexCount, src.Vertices.data() + incoming.FirstVertex, incoming.VertexCount);
+        }
+
+        // Indices are absolute, so rebase the incoming ones onto this section's position...
+        spliceRange(Indices, section.FirstIndex, section.IndexCount, src.Indices.data() + incoming.FirstIndex, incoming.IndexCount);
+        for (size_t j = section.FirstIndex; j < section.FirstIndex + incoming.IndexCount; ++j) {
+            Indices[j] = Indices[j] - incoming.FirstVertex + section.FirstVertex;
+        }
+
+        // ...and shift everything after this section by how much it grew or shrank
+        const int64_t vertex_delta = static_cast<int64_t>(incoming.VertexCount) - static_cast<int64_t>(section.VertexCount);
+        const int64_t index_delta = static_cast<int64_t>(incoming.IndexCount) - static_cast<int64_t>(section.IndexCount);
+        section.VertexCount = incoming.VertexCount;
+        section.IndexCount = incoming.IndexCount;
+        for (size_t j = i + 1; j < Sections.size(); ++j) {
+            Sections[j].FirstVertex = static_cast<uint32_t>(Sections[j].FirstVertex + vertex_delta);
+            Sections[j].FirstIndex = static_cast<uint32_t>(Sections[j].FirstIndex + index_delta);
+        }
+        if (vertex_delta != 0) {
+            for (size_t j = section.FirstIndex + section.IndexCount; j < Indices.size(); ++j) {
+                Indices[j] = static_cast<uint32_t>(Indices[j] + vertex_delta);
+            }
+        }
+    }
+}
+
+uint32_t ChunkMeshData::addVertex(const ChunkMeshComponent::vertex_t& v) noexcept {
+    // Capacity was reserved up front, from the visible face count
+    Vertices.ptr[Vertices.count] = v;
+    return vertexBase + static_cast<uint32_t>(Vertices.count++);
+}
+
+uint32_t ChunkMeshData::addVertex(const packed_chunk_vertex_t v) noexcept {
+    PackedVertices.ptr[PackedVertices.count] = v;
+    return vertexBase + static_cast<uint32_t>(PackedVertices.count++);
+}
+
+void ChunkMeshData::addQuadIndices(const uint32_t i0, const uint32_t i1, const uint32_t i2, const uint32_t i3) noexcept {
+    // The shared index pattern already triangulates every quad this way.
+    if (IndexMode == ChunkIndexMode::SHARED_QUADS) {
+        return;
+    }
+    uint32_t* dest = Indices.ptr + Indices.count;
+    dest[0] = i0;
+    dest[1] = i1;
+    dest[2] = i2;
+    dest[3] = i0;
+    dest[4] = i2;
+    dest[5] = i3;
+    Indices.count += QuadIndexPattern::INDICES_PER_QUAD;
+}
+
+size_t ChunkMeshData::VertexCount() const noexcept {
+    return VertexFormat == ChunkVertexFormat::PACKED ? PackedVertices.size() : Vertices.size();
+}
+
+size_t ChunkMeshData::VertexDataSize() const noexcept {
+    return VertexCount() * getVertexSize(VertexFormat);
 }
@@ -0,0 +1,45 @@
+#include "objects/ChunkMeshArena.hpp"
+#include <algorithm>
+
+ChunkMeshArena::ChunkMeshArena(const size_t block_size) : blockSize(block_size) {}
+
+void* ChunkMeshArena::allocateBytes(const size_t size, const size_t alignment) {
+    while (currentBlock < blocks.size()) {
+        block_t& block = blocks[currentBlock];
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.Data.get());
+        const size_t aligned_offset = ((base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1)) - base;
+        if (aligned_offset + size <= block.Size) {
+            offset = aligned_offset + size;
+            return block.Data.get() + aligned_offset;
+        }
+        // Doesn't fit: the rest of this block goes unused until the next reset
+        usedBefore += offset;
+        offset = 0;
+        ++currentBlock;
+    }
+
+    // Only reached while the arena is still growing. Blocks are over-sized by the alignment so the
+    // allocation always fits at the start of the new block.
+    const size_t new_size = std::max(blockSize, size + alignment);
+    blocks.emplace_back(block_t{ std::make_unique<std::byte[]>(new_size), new_size });
+    currentBlock = blocks.size() - 1;
+    return allocateBytes(size, alignment);
+}
+
+void ChunkMeshArena::Reset() noexcept {
+    currentBlock = 0;
+    offset = 0;
+    usedBefore = 0;
+}
+
+size_t ChunkMeshArena::BytesUsed() const noexcept {
+    return usedBefore + offset;
+}
+
+size_t ChunkMeshArena::Capacity() const noexcept {
+    size_t result = 0;
+    for (const auto& block : blocks) {
+        result += block.Size;
+    }
+    return result;
+}
@@ -0,0 +1,195 @@
+#include "objects/ChunkMeshingJobs.hpp"
+
+ChunkMeshingJobSystem::ChunkMeshingJobSystem(const size_t num_workers, const MeshingMode _mode, const ChunkVertexFormat vertex_format, const ChunkIndexMode index_mode,
+    const bool ambient_occlusion) : mode(_mode), vertexFormat(vertex_format), indexMode(index_mode), ambientOcclusion(ambient_occlusion) {
+    // hardware_concurrency() is allowed to return 0
+    const size_t worker_count = num_workers == 0 ? 1 : num_workers;
+    arenas = std::make_unique<workerArena[]>(worker_count);
+    sectionTasks.reserve(worker_count);
+    workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&ChunkMeshingJobSystem::workerFunction, this, i);
+    }
+}
+
+ChunkMeshingJobSystem::~ChunkMeshingJobSystem() {
+    {
+        std::lock_guard<std::mutex> guard(queueMutex);
+        shutdown = true;
+    }
+    cVar.notify_all();
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+ChunkMeshSnapshot ChunkMeshingJobSystem::AcquireSnapshot() {
+    if (spareSnapshots.empty()) {
+        return ChunkMeshSnapshot();
+    }
+    ChunkMeshSnapshot result = std::move(spareSnapshots.back());
+    spareSnapshots.pop_back();
+    return result;
+}
+
+void ChunkMeshingJobSystem::Submit(const ecs::entity_t chunk, ChunkMeshSnapshot&& snapshot) {
+    ++pendingJobs;
+    std::unique_lock<std::mutex> lock(queueMutex);
+    sectionTask* task = freeTasks;
+    if (task != nullptr) {
+        freeTasks = task->Next;
+        task->Next = nullptr;
+    }
+    else {
+        taskStorage.emplace_back(std::make_unique<sectionTask>());
+        task = taskStorage.back().get();
+    }
+    // Held until drained
+    task->References = 1;
+    task->Chunk = chunk;
+    task->Snapshot = std::move(snapshot);
+    task->NextSection.store(0, std::memory_order_relaxed);
+    task->Superseded = false;
+    if (jobsTail != nullptr) {
+        jobsTail->Next = task;
+    }
+    else {
+        jobsHead = task;
+    }
+    jobsTail = task;
+    lock.unlock();
+    cVar.notify_one();
+
+    auto iter = std::find_if(latestJobs.begin(), latestJobs.end(), [chunk](const sectionTask* job) { return job->Chunk == chunk; });
+    if (iter != latestJobs.end()) {
+        (*iter)->Superseded = true;
+        *iter = task;
+    }
+    else {
+        latestJobs.emplace_back(task);
+    }
+}
+
+void ChunkMeshingJobSystem::WaitIdle() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idleCVar.wait(lock, [this]()->bool { return pendingJobs == 0; });
+}
+
+size_t ChunkMeshingJobSystem::PendingJobs() const noexcept {
+    return pendingJobs;
+}
+
+size_t ChunkMeshingJobSystem::NumWorkers() const noexcept {
+    return workers.size();
+}
+
+void ChunkMeshingJobSystem::workerFunction(const size_t worker_idx) {
+    workerArena& arena = arenas[worker_idx];
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        cVar.wait(lock, [this]()->bool {
+            pruneSectionTasks();
+            return shutdown || !sectionTasks.empty() || jobsHead != nullptr;
+        });
+
+        if (shutdown) {
+            return;
+        }
+
+        // Help finish chunks that are already being meshed before starting new ones
+        if (!sectionTasks.empty()) {
+            sectionTask* task = sectionTasks.front();
+            ++task->References;
+            lock.unlock();
+            fillSections(*task);
+            lock.lock();
+            releaseTask(task);
+            continue;
+        }
+
+        sectionTask* task = jobsHead;
+        jobsHead = task->Next;
+        if (jobsHead == nullptr) {
+            jobsTail = nullptr;
+        }
+        task->Next = nullptr;
+        ++task->References;
+        lock.unlock();
+
+        // Once the main thread has drained everything we've produced, nothing points into the arena anymore.
+        // Until then we keep appending to it, and it grows if it has to. Counted as outstanding from here on,
+        // as other workers may be filling sections in it after we've moved on.
+        if (arena.Outstanding.load(std::memory_order_acquire) == 0) {
+            arena.Arena.Reset();
+        }
+        arena.Outstanding.fetch_add(1, std::memory_order_relaxed);
+
+        task->Source = &arena;
+        task->Mesh = ChunkMeshData();
+        task->Mesh.VertexFormat = vertexFormat;
+        task->Mesh.IndexMode = indexMode;
+        task->Mesh.AmbientOcclusion = ambientOcclusion;
+        task->Plan = ChunkMeshingSystem::PlanMesh(task->Snapshot, arena.Arena, task->Mesh, mode);
+        task->Remaining = task->Plan.Sections.size();
+
+        if (task->Plan.Sections.empty()) {
+            finishTask(*task);
+        }
+        else {
+            if (task->Plan.Sections.size() > 1 && workers.size() > 1) {
+                lock.lock();
+                sectionTasks.push_back(task);
+                lock.unlock();
+                cVar.notify_all();
+            }
+            fillSections(*task);
+        }
+
+        lock.lock();
+        releaseTask(task);
+    }
+}
+
+void ChunkMeshingJobSystem::fillSections(sectionTask& task) {
+    while (true) {
+        const size_t idx = task.NextSection.fetch_add(1, std::memory_order_relaxed);
+        if (idx >= task.Plan.Sections.size()) {
+            return;
+        }
+        ChunkMeshingSystem::FillSection(task.Plan, task.Plan.Sections[idx], task.Mesh);
+        // Makes every other worker's writes to the mesh visible to whoever finishes it
+        if (task.Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finishTask(task);
+        }
+    }
+}
+
+void ChunkMeshingJobSystem::finishTask(sectionTask& task) {
+    task.Stats = ChunkMeshingSystem::FinishMesh(task.Plan, task.Mesh);
+    completed.push(&task);
+
+    // Decrement under the lock, so WaitIdle() can't miss the wakeup between checking and waiting
+    std::lock_guard<std::mutex> guard(queueMutex);
+    pruneSectionTasks();
+    if (--pendingJobs == 0) {
+        idleCVar.notify_all();
+    }
+}
+
+void ChunkMeshingJobSystem::pruneSectionTasks() {
+    // Not just from the front: a finished task has to be gone before it can be recycled for another job
+    sectionTasks.erase(std::remove_if(sectionTasks.begin(), sectionTasks.end(), [](const sectionTask* task) {
+        return task->NextSection.load(std::memory_order_relaxed) >= task->Plan.Sections.size();
+    }), sectionTasks.end());
+}
+
+void ChunkMeshingJobSystem::releaseTask(sectionTask* task) {
+    if (--task->References == 0) {
+        task->Next = freeTasks;
+        freeTasks = task;
+    }
+}
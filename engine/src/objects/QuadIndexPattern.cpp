@@ -0,0 +1,75 @@
+#include "objects/QuadIndexPattern.hpp"
+#include "ResourceContext.hpp"
+#include <algorithm>
+#include <mutex>
+
+static VulkanResource* quadIndexBuffer{ nullptr };
+static std::mutex quadIndexBufferMutex;
+
+const std::vector<uint16_t>& QuadIndexPattern::Indices() {
+    static const std::vector<uint16_t> indices = []() {
+        std::vector<uint16_t> result;
+        result.reserve(MAX_QUADS_PER_DRAW * INDICES_PER_QUAD);
+        for (uint32_t i = 0; i < MAX_QUADS_PER_DRAW; ++i) {
+            const uint16_t first = static_cast<uint16_t>(i * VERTICES_PER_QUAD);
+            result.insert(std::end(result), { first, uint16_t(first + 1), uint16_t(first + 2) });
+            result.insert(std::end(result), { first, uint16_t(first + 2), uint16_t(first + 3) });
+        }
+        return result;
+    }();
+    return indices;
+}
+
+VulkanResource* QuadIndexPattern::Buffer() {
+    std::lock_guard<std::mutex> guard(quadIndexBufferMutex);
+    if (quadIndexBuffer != nullptr) {
+        return quadIndexBuffer;
+    }
+
+    const auto& indices = Indices();
+
+    const VkBufferCreateInfo buffer_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        nullptr,
+        0,
+        static_cast<VkDeviceSize>(indices.size() * sizeof(uint16_t)),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_SHARING_MODE_EXCLUSIVE,
+        0,
+        nullptr
+    };
+
+    const gpu_resource_data_t index_data{ indices.data(), indices.size() * sizeof(uint16_t), 0, 0, 0 };
+
+    quadIndexBuffer = ResourceContext::Get().CreateNamedBuffer("SharedQuadIndexBuffer", &buffer_info, nullptr, 1, &index_data, memory_type::DEVICE_LOCAL);
+    return quadIndexBuffer;
+}
+
+void QuadIndexPattern::Destroy() {
+    std::lock_guard<std::mutex> guard(quadIndexBufferMutex);
+    if (quadIndexBuffer != nullptr) {
+        ResourceContext::Get().DestroyResource(quadIndexBuffer);
+        quadIndexBuffer = nullptr;
+    }
+}
+
+std::vector<QuadIndexPattern::draw_batch_t> QuadIndexPattern::GetDrawBatches(const uint32_t quad_count, const uint32_t first_vertex) {
+    std::vector<draw_batch_t> batches;
+    batches.reserve((quad_count + MAX_QUADS_PER_DRAW - 1) / MAX_QUADS_PER_DRAW);
+    for (uint32_t first_quad = 0; first_quad < quad_count; first_quad += MAX_QUADS_PER_DRAW) {
+        const uint32_t batch_quads = std::min(quad_count - first_quad, MAX_QUADS_PER_DRAW);
+        batches.emplace_back(draw_batch_t{ batch_quads * INDICES_PER_QUAD, static_cast<int32_t>(first_vertex + first_quad * VERTICES_PER_QUAD) });
+    }
+    return batches;
+}
+
+void QuadIndexPattern::RecordDraws(VkCommandBuffer cmd, const uint32_t quad_count, const uint32_t first_vertex) {
+    if (quad_count == 0) {
+        return;
+    }
+
+    vkCmdBindIndexBuffer(cmd, (VkBuffer)Buffer()->Handle, 0, INDEX_TYPE);
+    for (const auto& batch : GetDrawBatches(quad_count, first_vertex)) {
+        vkCmdDrawIndexed(cmd, batch.IndexCount, 1, 0, batch.VertexOffset, 0);
+    }
+}
@@ -0,0 +1,83 @@
+#include "objects/ChunkMesh.hpp"
+#include "objects/QuadIndexPattern.hpp"
+#include "generation/TerrainGenerator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/*
+	Times meshing generated chunks with and without ambient occlusion, naively and greedily, into both vertex formats.
+	Baking AO should cost no more than about 20% over meshing without it: returns non-zero if any configuration goes
+	over. Greedy meshing can't merge faces whose AO differs, so it also produces more quads with AO on: both quad
+	counts are reported.
+
+	Each time is the best of several trials, alternating between AO off and on, to keep noise from other processes
+	out of the comparison.
+*/
+
+using bench_clock = std::chrono::steady_clock;
+constexpr static int NUM_CHUNKS = 16;
+constexpr static int REPEATS = 10;
+constexpr static int TRIALS = 7;
+
+struct result_t {
+	double Us;
+	size_t Quads;
+};
+
+static result_t mesh(ChunkMeshArena& arena, const std::vector<ChunkMeshSnapshot>& snapshots, const MeshingMode mode, const ChunkVertexFormat format,
+	const bool ao) {
+	size_t vertices = 0;
+	const auto start = bench_clock::now();
+	for (int r = 0; r < REPEATS; ++r) {
+		for (const ChunkMeshSnapshot& snapshot : snapshots) {
+			arena.Reset();
+			ChunkMeshData result;
+			result.VertexFormat = format;
+			result.AmbientOcclusion = ao;
+			ChunkMeshingSystem::GenerateMesh(snapshot, arena, result, mode);
+			vertices += result.VertexCount();
+		}
+	}
+	const double count = static_cast<double>(REPEATS * snapshots.size());
+	return result_t{ std::chrono::duration<double, std::micro>(bench_clock::now() - start).count() / count,
+		vertices / (QuadIndexPattern::VERTICES_PER_QUAD * REPEATS * snapshots.size()) };
+}
+
+int main() {
+	terrain::TerrainGenerator generator;
+	generator.SetStageEnabled(terrain::terrainStage::DECORATION, false);
+
+	std::vector<ChunkMeshSnapshot> snapshots(NUM_CHUNKS);
+	for (int i = 0; i < NUM_CHUNKS; ++i) {
+		ChunkComponent chunk;
+		chunk.GridPosition = glm::ivec2(i % 4, i / 4);
+		generator.Generate(chunk);
+		snapshots[i].Blocks.resize(BLOCKS_PER_CHUNK);
+		chunk.Blocks.CopyTypes(snapshots[i].Blocks.data());
+	}
+
+	ChunkMeshArena arena;
+	// Warms up the arena and caches, so the first configuration timed isn't penalised
+	mesh(arena, snapshots, MeshingMode::NAIVE, ChunkVertexFormat::FULL, true);
+
+	bool within_target = true;
+	for (const MeshingMode mode : { MeshingMode::NAIVE, MeshingMode::GREEDY }) {
+		for (const ChunkVertexFormat format : { ChunkVertexFormat::FULL, ChunkVertexFormat::PACKED }) {
+			result_t plain{ 1.0e30, 0 }, ao{ 1.0e30, 0 };
+			for (int t = 0; t < TRIALS; ++t) {
+				const result_t plain_trial = mesh(arena, snapshots, mode, format, false);
+				const result_t ao_trial = mesh(arena, snapshots, mode, format, true);
+				plain = result_t{ std::min(plain.Us, plain_trial.Us), plain_trial.Quads };
+				ao = result_t{ std::min(ao.Us, ao_trial.Us), ao_trial.Quads };
+			}
+			const double overhead = (ao.Us / plain.Us - 1.0) * 100.0;
+			within_target &= overhead <= 20.0;
+			std::printf("%-6s %-6s no AO %8.1f us/chunk %6zu quads  AO %8.1f us/chunk %6zu quads  %+6.1f%%\n", mode == MeshingMode::GREEDY ? "greedy" : "naive",
+				format == ChunkVertexFormat::PACKED ? "packed" : "full", plain.Us, plain.Quads, ao.Us, ao.Quads, overhead);
+		}
+	}
+	std::printf(within_target ? "AO overhead within 20%%\n" : "AO overhead above 20%%\n");
+	return within_target ? 0 : 1;
+}
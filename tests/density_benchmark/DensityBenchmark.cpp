@@ -0,0 +1,79 @@
+#include "generation/DensityField.hpp"
+#include "util/CommonUtil.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/*
+	Times DensityField's lattice sampling and interpolation against sampling 3D noise at every block of a chunk, for
+	both noise types, and reports how far the interpolated field strays from the per-block one. Then times
+	GenerateDensityTerrain() for whole chunks.
+*/
+
+using bench_clock = std::chrono::steady_clock;
+constexpr static int NUM_CHUNKS = 16;
+
+static double elapsedUs(const bench_clock::time_point& start) {
+	return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+}
+
+static glm::ivec2 chunkPosition(const int i) {
+	return glm::ivec2(i * 7 - 40, i * 3 - 10);
+}
+
+int main() {
+	std::vector<float> lattice_values(BLOCKS_PER_CHUNK);
+	std::vector<float> block_values(BLOCKS_PER_CHUNK);
+	terrain::DensityField field;
+
+	for (const noise::noiseType type : { noise::noiseType::VALUE, noise::noiseType::SIMPLEX }) {
+		noise::NoiseCfg cfg;
+		cfg.NoiseType = type;
+		const noise::NoiseGenerator generator(cfg);
+
+		double lattice_us = 0.0;
+		double block_us = 0.0;
+		double total_error = 0.0;
+		double max_error = 0.0;
+		for (int i = 0; i < NUM_CHUNKS; ++i) {
+			const glm::ivec2 grid_position = chunkPosition(i);
+			const auto lattice_start = bench_clock::now();
+			field.SampleLattice(generator, grid_position);
+			field.Interpolate(lattice_values.data());
+			lattice_us += elapsedUs(lattice_start);
+
+			const auto block_start = bench_clock::now();
+			for (size_t y = 0; y < CHUNK_SIZE_Y; ++y) {
+				for (size_t x = 0; x < CHUNK_SIZE; ++x) {
+					for (size_t z = 0; z < CHUNK_SIZE; ++z) {
+						const glm::vec3 pos(static_cast<float>(grid_position.x * static_cast<int>(CHUNK_SIZE)) + static_cast<float>(x), static_cast<float>(y),
+							static_cast<float>(grid_position.y * static_cast<int>(CHUNK_SIZE)) + static_cast<float>(z));
+						block_values[GetBlockIndex(x, y, z)] = generator.Sample(pos);
+					}
+				}
+			}
+			block_us += elapsedUs(block_start);
+
+			for (size_t j = 0; j < BLOCKS_PER_CHUNK; ++j) {
+				const double error = std::fabs(lattice_values[j] - block_values[j]);
+				total_error += error;
+				max_error = std::max(max_error, error);
+			}
+		}
+
+		std::printf("%-7s lattice %8.0f us/chunk  per-block %8.0f us/chunk  (%.1fx)  mean error %.4f, max %.4f\n",
+			type == noise::noiseType::SIMPLEX ? "simplex" : "value", lattice_us / NUM_CHUNKS, block_us / NUM_CHUNKS, block_us / lattice_us,
+			total_error / (static_cast<double>(NUM_CHUNKS) * BLOCKS_PER_CHUNK), max_error);
+
+		ChunkComponent chunk;
+		const auto generate_start = bench_clock::now();
+		for (int i = 0; i < NUM_CHUNKS; ++i) {
+			chunk.GridPosition = chunkPosition(i);
+			terrain::GenerateDensityTerrain(generator, terrain::DensityTerrainParams(), chunk);
+		}
+		std::printf("        GenerateDensityTerrain %8.0f us/chunk\n", elapsedUs(generate_start) / NUM_CHUNKS);
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "objects/ChunkFaceMasks.hpp"
+#include "util/CommonUtil.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+/*
+	Builds face masks for random chunks and borders with BuildFaceMasks() and BuildFaceMasksScalar(), over whole
+	chunks and over ranges of layers, and checks the two give identical masks. Rows outside the range must be left
+	untouched by both.
+
+	Built with AVX2 enabled, so BuildFaceMasks() takes the AVX2 path.
+*/
+
+constexpr static uint32_t UNTOUCHED = 0xA5A5A5A5u;
+
+static size_t failures = 0;
+
+static void check(const bool condition, const char* what) {
+	if (!condition) {
+		std::printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+static void randomChunk(std::mt19937& rng, std::vector<BlockType>& blocks) {
+	// Solid fraction varies per chunk, from almost empty to almost full
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float density = unit(rng);
+	// Some chunks are terrain-like: solid below a height, with holes
+	const bool layered = unit(rng) < 0.5f;
+	const uint32_t height = std::uniform_int_distribution<uint32_t>(0, CHUNK_SIZE_Y)(rng);
+	for (uint32_t y = 0; y < CHUNK_SIZE_Y; ++y) {
+		for (uint32_t x = 0; x < CHUNK_SIZE; ++x) {
+			for (uint32_t z = 0; z < CHUNK_SIZE; ++z) {
+				const bool solid = layered ? (y < height) != (unit(rng) < density * 0.1f) : unit(rng) < density;
+				blocks[GetBlockIndex(x, y, z)] = solid ? static_cast<BlockType>(BlockTypes::STONE) : static_cast<BlockType>(BlockTypes::AIR);
+			}
+		}
+	}
+}
+
+static void randomBorders(std::mt19937& rng, ChunkBorderMasks& borders) {
+	// Unloaded neighbours leave a side at its default of solid
+	std::uniform_int_distribution<uint32_t> bits;
+	for (auto* side : { &borders.PosX, &borders.NegX, &borders.PosZ, &borders.NegZ }) {
+		if (bits(rng) & 1u) {
+			for (auto& row : *side) {
+				row = bits(rng);
+			}
+		}
+	}
+}
+
+static void compareRange(const ChunkOpacityMask& opacity, const ChunkBorderMasks& borders, const uint32_t y_begin, const uint32_t y_end) {
+	auto simd = std::make_unique<ChunkFaceMasks>();
+	auto scalar = std::make_unique<ChunkFaceMasks>();
+	for (size_t face = 0; face < 6; ++face) {
+		simd->Faces[face].fill(UNTOUCHED);
+		scalar->Faces[face].fill(UNTOUCHED);
+	}
+	BuildFaceMasks(opacity, borders, *simd, y_begin, y_end);
+	BuildFaceMasksScalar(opacity, borders, *scalar, y_begin, y_end);
+
+	for (size_t face = 0; face < 6; ++face) {
+		if (simd->Faces[face] != scalar->Faces[face]) {
+			for (size_t row = 0; row < ROWS_PER_CHUNK; ++row) {
+				if (simd->Faces[face][row] != scalar->Faces[face][row]) {
+					std::printf("FAIL face %zu, layers %u to %u: row (%zu, %zu) is %08x, scalar gives %08x\n", face, y_begin, y_end,
+						row / CHUNK_SIZE, row % CHUNK_SIZE, simd->Faces[face][row], scalar->Faces[face][row]);
+					break;
+				}
+			}
+			++failures;
+		}
+		bool outside_untouched = true;
+		for (size_t row = 0; row < ROWS_PER_CHUNK; ++row) {
+			const bool inside = row >= GetRowIndex(y_begin, 0) && row < GetRowIndex(y_end, 0);
+			outside_untouched &= inside || simd->Faces[face][row] == UNTOUCHED;
+		}
+		check(outside_untouched, "BuildFaceMasks() wrote outside the requested layers");
+	}
+}
+
+int main() {
+	std::mt19937 rng(1234);
+	std::vector<BlockType> blocks(BLOCKS_PER_CHUNK);
+	auto opacity = std::make_unique<ChunkOpacityMask>();
+	std::uniform_int_distribution<uint32_t> layer(0, CHUNK_SIZE_Y);
+
+	for (size_t i = 0; i < 64; ++i) {
+		randomChunk(rng, blocks);
+		ChunkBorderMasks borders;
+		randomBorders(rng, borders);
+		BuildOpacityMask(blocks.data(), *opacity);
+
+		compareRange(*opacity, borders, 0, CHUNK_SIZE_Y);
+		// The top and bottom layers read past the chunk, and a single layer has no neighbours within the range
+		compareRange(*opacity, borders, 0, 1);
+		compareRange(*opacity, borders, CHUNK_SIZE_Y - 1, CHUNK_SIZE_Y);
+		uint32_t y_begin = layer(rng), y_end = layer(rng);
+		if (y_begin > y_end) {
+			std::swap(y_begin, y_end);
+		}
+		compareRange(*opacity, borders, y_begin, y_end);
+	}
+
+	if (failures != 0) {
+		std::printf("%zu failures\n", failures);
+		return 1;
+	}
+	std::printf("All passed\n");
+	return 0;
+}
@@ -0,0 +1,174 @@
+#include "objects/ChunkMesh.hpp"
+#include "generation/TerrainGenerator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/*
+	Compares ChunkBlockStorage's layouts (ChunkBlockLayout.hpp) on generated chunks, for three access patterns:
+
+	- Meshing: decoding the chunk with CopyTypes() and meshing it, as a meshing job does.
+	- Lighting: a sunlight flood. Nothing in the engine propagates light yet, so this is a plain breadth-first
+	  flood reading blocks through GetType() and storing light in the same layout as the blocks.
+	- Column scans: finding the highest solid block of every column, top down.
+
+	Each time is the best of several trials. Results are checked to agree between layouts.
+*/
+
+using bench_clock = std::chrono::steady_clock;
+constexpr static int NUM_CHUNKS = 16;
+constexpr static int TRIALS = 5;
+constexpr static BlockType AIR = static_cast<BlockType>(BlockTypes::AIR);
+
+template<typename Fn>
+static double bestUs(Fn&& fn) {
+	double best = 1.0e30;
+	for (int t = 0; t < TRIALS; ++t) {
+		const auto start = bench_clock::now();
+		fn();
+		best = std::min(best, std::chrono::duration<double, std::micro>(bench_clock::now() - start).count());
+	}
+	return best / NUM_CHUNKS;
+}
+
+template<typename Layout>
+static size_t meshChunk(const ChunkBlockStorage<Layout>& blocks, ChunkMeshArena& arena) {
+	ChunkMeshSnapshot snapshot;
+	snapshot.Blocks.resize(BLOCKS_PER_CHUNK);
+	blocks.CopyTypes(snapshot.Blocks.data());
+	arena.Reset();
+	ChunkMeshData result;
+	ChunkMeshingSystem::GenerateMesh(snapshot, arena, result);
+	return result.VertexCount();
+}
+
+template<typename Layout>
+static size_t floodSunlight(const ChunkBlockStorage<Layout>& blocks, std::vector<uint8_t>& light, std::vector<uint32_t>& queue) {
+	std::fill(light.begin(), light.end(), uint8_t(0));
+	queue.clear();
+	auto pack = [](const uint32_t x, const uint32_t y, const uint32_t z) {
+		return (y << 10) | (x << 5) | z;
+	};
+
+	// Full sunlight straight down each column, until it hits something solid
+	for (uint32_t x = 0; x < CHUNK_SIZE; ++x) {
+		for (uint32_t z = 0; z < CHUNK_SIZE; ++z) {
+			for (uint32_t y = CHUNK_SIZE_Y; y-- > 0 && blocks.GetType(x, y, z) == AIR;) {
+				light[Layout::GetIndex(x, y, z)] = uint8_t(SUNLIGHT_LEVEL);
+				queue.emplace_back(pack(x, y, z));
+			}
+		}
+	}
+
+	// Then outwards, one level dimmer per block
+	for (size_t head = 0; head < queue.size(); ++head) {
+		const uint32_t x = (queue[head] >> 5) & 31u, y = queue[head] >> 10, z = queue[head] & 31u;
+		const uint8_t level = light[Layout::GetIndex(x, y, z)];
+		if (level <= 1) {
+			continue;
+		}
+		auto spread = [&](const uint32_t nx, const uint32_t ny, const uint32_t nz) {
+			uint8_t& dest = light[Layout::GetIndex(nx, ny, nz)];
+			if (dest + 1 < level && blocks.GetType(nx, ny, nz) == AIR) {
+				dest = level - 1;
+				queue.emplace_back(pack(nx, ny, nz));
+			}
+		};
+		if (x > 0) spread(x - 1, y, z);
+		if (x + 1 < CHUNK_SIZE) spread(x + 1, y, z);
+		if (y > 0) spread(x, y - 1, z);
+		if (y + 1 < CHUNK_SIZE_Y) spread(x, y + 1, z);
+		if (z > 0) spread(x, y, z - 1);
+		if (z + 1 < CHUNK_SIZE) spread(x, y, z + 1);
+	}
+
+	size_t total = 0;
+	for (const uint8_t level : light) {
+		total += level;
+	}
+	return total;
+}
+
+template<typename Layout>
+static size_t scanColumns(const ChunkBlockStorage<Layout>& blocks) {
+	size_t total = 0;
+	for (uint32_t x = 0; x < CHUNK_SIZE; ++x) {
+		for (uint32_t z = 0; z < CHUNK_SIZE; ++z) {
+			uint32_t y = CHUNK_SIZE_Y;
+			while (y > 0 && blocks.GetType(x, y - 1, z) == AIR) {
+				--y;
+			}
+			total += y;
+		}
+	}
+	return total;
+}
+
+struct checksums_t {
+	size_t Vertices{ 0 };
+	size_t Light{ 0 };
+	size_t Heights{ 0 };
+
+	bool operator==(const checksums_t& other) const noexcept {
+		return Vertices == other.Vertices && Light == other.Light && Heights == other.Heights;
+	}
+};
+
+template<typename Layout>
+static checksums_t run(const char* name, const std::vector<ChunkComponent>& chunks) {
+	std::vector<ChunkBlockStorage<Layout>> storage(chunks.size());
+	std::vector<BlockComponent> palette;
+	std::vector<uint16_t> entries(BLOCKS_PER_CHUNK);
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		chunks[i].Blocks.ExportEntries(palette, entries.data());
+		storage[i].ImportEntries(palette.data(), palette.size(), entries.data());
+	}
+
+	ChunkMeshArena arena;
+	std::vector<uint8_t> light(BLOCKS_PER_CHUNK);
+	std::vector<uint32_t> queue;
+	queue.reserve(BLOCKS_PER_CHUNK);
+	checksums_t sums;
+
+	const double mesh_us = bestUs([&]() {
+		sums.Vertices = 0;
+		for (const auto& blocks : storage) {
+			sums.Vertices += meshChunk(blocks, arena);
+		}
+	});
+	const double light_us = bestUs([&]() {
+		sums.Light = 0;
+		for (const auto& blocks : storage) {
+			sums.Light += floodSunlight(blocks, light, queue);
+		}
+	});
+	const double scan_us = bestUs([&]() {
+		sums.Heights = 0;
+		for (const auto& blocks : storage) {
+			sums.Heights += scanColumns(blocks);
+		}
+	});
+
+	std::printf("%-7s meshing %8.1f us/chunk  lighting %8.1f us/chunk  column scans %7.1f us/chunk\n", name, mesh_us, light_us, scan_us);
+	return sums;
+}
+
+int main() {
+	terrain::TerrainGenerator generator;
+	generator.SetStageEnabled(terrain::terrainStage::DECORATION, false);
+	std::vector<ChunkComponent> chunks(NUM_CHUNKS);
+	for (int i = 0; i < NUM_CHUNKS; ++i) {
+		chunks[i].GridPosition = glm::ivec2(i % 4, i / 4);
+		generator.Generate(chunks[i]);
+	}
+
+	const checksums_t linear = run<LinearChunkLayout>("linear", chunks);
+	const checksums_t morton = run<MortonChunkLayout>("morton", chunks);
+	const checksums_t tiled = run<TiledChunkLayout>("tiled", chunks);
+	if (!(linear == morton) || !(linear == tiled)) {
+		std::printf("Layouts disagree on the results\n");
+		return 1;
+	}
+	return 0;
+}
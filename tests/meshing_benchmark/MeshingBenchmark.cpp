@@ -0,0 +1,102 @@
+#include "objects/ChunkMeshingJobs.hpp"
+#include "generation/TerrainGenerator.hpp"
+#include "ecs/registry.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+/*
+	Headless meshing throughput: generates a 16x16 area of chunks into the registry, snapshots each one with its
+	neighbours the way ChunkManager does, and meshes the whole area through ChunkMeshingJobSystem with 1, 2, 4, ...
+	workers, up to the number of hardware threads. Pass a worker count to go up to that instead.
+*/
+
+using bench_clock = std::chrono::steady_clock;
+constexpr static int WIDTH = 16;
+
+static double elapsedMs(const bench_clock::time_point& start) {
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static double meshArea(const std::vector<ChunkMeshSnapshot>& snapshots, const size_t num_workers, const MeshingMode mode) {
+	ChunkMeshingJobSystem jobs(num_workers, mode);
+	// Copied up front, so only meshing is timed
+	std::vector<ChunkMeshSnapshot> pending = snapshots;
+	const auto start = bench_clock::now();
+	for (size_t i = 0; i < pending.size(); ++i) {
+		jobs.Submit(static_cast<ecs::entity_t>(i), std::move(pending[i]));
+	}
+	jobs.WaitIdle();
+	const double ms = elapsedMs(start);
+	const size_t meshed = jobs.DrainCompleted([](const ecs::entity_t, const ChunkMeshData&, const MeshingStats&) {});
+	if (meshed != snapshots.size()) {
+		std::printf("Only %zu of %zu chunks meshed\n", meshed, snapshots.size());
+	}
+	return ms;
+}
+
+int main(int argc, char* argv[]) {
+	const size_t hardware_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	const size_t max_workers = argc > 1 ? static_cast<size_t>(std::max(std::atoi(argv[1]), 1)) : hardware_threads;
+	std::vector<size_t> worker_counts;
+	for (size_t workers = 1; workers < max_workers; workers *= 2) {
+		worker_counts.emplace_back(workers);
+	}
+	worker_counts.emplace_back(max_workers);
+
+	terrain::TerrainGenerator generator;
+	generator.SetStageEnabled(terrain::terrainStage::DECORATION, false);
+
+	auto& registry = ecs::default_registry_t::get_registry();
+	std::vector<ecs::entity_t> chunks(WIDTH * WIDTH);
+	for (int x = 0; x < WIDTH; ++x) {
+		for (int z = 0; z < WIDTH; ++z) {
+			const ecs::entity_t chunk = registry.create();
+			auto& component = registry.assign<ChunkComponent>(chunk);
+			component.GridPosition = glm::ivec2(x - WIDTH / 2, z - WIDTH / 2);
+			generator.Generate(component);
+			chunks[x * WIDTH + z] = chunk;
+		}
+	}
+
+	auto find_chunk = [&chunks](const int x, const int z) {
+		return (x >= 0 && x < WIDTH && z >= 0 && z < WIDTH) ? chunks[x * WIDTH + z] : ecs::INVALID_ENTITY;
+	};
+
+	std::vector<ChunkMeshSnapshot> snapshots;
+	const auto snapshot_start = bench_clock::now();
+	for (int x = 0; x < WIDTH; ++x) {
+		for (int z = 0; z < WIDTH; ++z) {
+			ChunkNeighbors neighbors;
+			neighbors.PosX = find_chunk(x + 1, z);
+			neighbors.NegX = find_chunk(x - 1, z);
+			neighbors.PosZ = find_chunk(x, z + 1);
+			neighbors.NegZ = find_chunk(x, z - 1);
+			snapshots.emplace_back(ChunkMeshingSystem::CreateSnapshot(find_chunk(x, z), neighbors));
+		}
+	}
+	std::printf("%d chunks, %zu hardware threads. Snapshots: %.1f us/chunk on the main thread\n", WIDTH * WIDTH, hardware_threads,
+		elapsedMs(snapshot_start) * 1000.0 / static_cast<double>(snapshots.size()));
+
+	for (const MeshingMode mode : { MeshingMode::NAIVE, MeshingMode::GREEDY }) {
+		// Warms up the workers' arenas and the allocator
+		meshArea(snapshots, 1, mode);
+		double single_ms = 0.0;
+		for (const size_t workers : worker_counts) {
+			const double ms = meshArea(snapshots, workers, mode);
+			if (workers == 1) {
+				single_ms = ms;
+			}
+			std::printf("%-6s %3zu workers %8.1f ms  %7.1f chunks/s  %5.2fx\n", mode == MeshingMode::GREEDY ? "greedy" : "naive", workers, ms,
+				static_cast<double>(snapshots.size()) * 1000.0 / ms, single_ms / ms);
+		}
+	}
+
+	for (const ecs::entity_t chunk : chunks) {
+		registry.destroy(chunk);
+	}
+	return 0;
+}
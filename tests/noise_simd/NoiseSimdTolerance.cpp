@@ -0,0 +1,94 @@
+#include "generation/NoiseGen.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/*
+	Checks NoiseGenerator::SampleGrid()'s SSE4 and AVX2 kernels against the scalar path, for both noise types, near
+	and far from the origin, over grids whose width isn't a multiple of the vector width, written with a stride wider
+	than the grid. Padding past each row must be left untouched.
+
+	Built with AVX2 enabled, so both kernels are compiled in.
+*/
+
+using namespace noise;
+
+// SampleGrid() promises about 1e-5
+constexpr static double TOLERANCE = 1.0e-5;
+constexpr static float PADDING = -1234.5f;
+
+static size_t failures = 0;
+
+static const char* levelName(const simdLevel level) {
+	return level == simdLevel::AVX2 ? "AVX2" : level == simdLevel::SSE4 ? "SSE4" : "scalar";
+}
+
+static void checkGrid(const NoiseGenerator& generator, const simdLevel level, const double x, const double z, const double step) {
+	// 37 is a multiple of neither 4 nor 8, so both kernels finish each row with a partial vector
+	constexpr size_t COUNT_X = 37, COUNT_Z = 13, STRIDE = 45;
+	std::vector<float> expected(COUNT_X * COUNT_Z);
+	std::vector<float> result(STRIDE * COUNT_Z, PADDING);
+	generator.SampleGrid(x, z, step, step, COUNT_X, COUNT_Z, expected.data(), COUNT_X, simdLevel::SCALAR);
+	generator.SampleGrid(x, z, step, step, COUNT_X, COUNT_Z, result.data(), STRIDE, level);
+
+	double max_error = 0.0;
+	bool padding_intact = true;
+	for (size_t j = 0; j < COUNT_Z; ++j) {
+		for (size_t i = 0; i < COUNT_X; ++i) {
+			max_error = std::max(max_error, static_cast<double>(std::fabs(result[j * STRIDE + i] - expected[j * COUNT_X + i])));
+		}
+		for (size_t i = COUNT_X; i < STRIDE; ++i) {
+			padding_intact &= result[j * STRIDE + i] == PADDING;
+		}
+	}
+
+	const char* type = generator.GetConfig().NoiseType == noiseType::SIMPLEX ? "simplex" : "value";
+	if (max_error > TOLERANCE || !padding_intact) {
+		std::printf("FAIL %s %s at (%g, %g) step %g: max error %.3g%s\n", type, levelName(level), x, z, step, max_error,
+			padding_intact ? "" : ", wrote past the end of a row");
+		++failures;
+	}
+}
+
+int main() {
+	const simdLevel best = NoiseGenerator::BestSimdLevel();
+	std::printf("noise_simd_tolerance: best level %s\n", levelName(best));
+	if (best == simdLevel::SCALAR) {
+		std::printf("No SIMD kernels compiled in, nothing to compare\n");
+	}
+
+	for (const noiseType type : { noiseType::VALUE, noiseType::SIMPLEX }) {
+		NoiseCfg cfg;
+		cfg.NoiseType = type;
+		const NoiseGenerator generator(cfg);
+
+		// Sample the scalar path directly too, so SampleGrid()'s own scalar loop is held to Sample()
+		float sample;
+		generator.SampleGrid(12.5, -3.25, 1.0, 1.0, 1, 1, &sample, 1, simdLevel::SCALAR);
+		if (std::fabs(sample - static_cast<float>(generator.Sample(12.5, -3.25))) > TOLERANCE) {
+			std::printf("FAIL scalar SampleGrid() differs from Sample()\n");
+			++failures;
+		}
+
+		for (const simdLevel level : { simdLevel::SSE4, simdLevel::AVX2 }) {
+			if (level > best) {
+				std::printf("%s not compiled in, skipped\n", levelName(level));
+				continue;
+			}
+			// Far from the origin is where computing in float could lose the fractional part of each coordinate
+			for (const double origin : { 0.0, -1234.0, 20000.0, -300000.0, 4000000.0 }) {
+				for (const double step : { 1.0, 0.37, 4.0 }) {
+					checkGrid(generator, level, origin, -0.5 * origin, step);
+				}
+			}
+		}
+	}
+
+	if (failures != 0) {
+		std::printf("%zu failures\n", failures);
+		return 1;
+	}
+	std::printf("All passed\n");
+	return 0;
+}
@@ -0,0 +1,103 @@
+#include "objects/ChunkMesh.hpp"
+#include "util/CommonUtil.hpp"
+#include <cstdio>
+#include <random>
+
+/*
+	Meshes the same chunk into full vertices and into packed ones, naively and greedily, and checks that decoding each
+	packed vertex as block_packed.vert does gives back the position, normal, UV and AO of the matching full vertex.
+	Both formats emit quads in the same order, so vertex i of one corresponds to vertex i of the other.
+*/
+
+static size_t failures = 0;
+
+static void check(const bool passed, const char* what) {
+	if (!passed) {
+		std::printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+static ChunkMeshSnapshot makeSnapshot() {
+	ChunkMeshSnapshot snapshot;
+	snapshot.Blocks.assign(BLOCKS_PER_CHUNK, static_cast<BlockType>(BlockTypes::AIR));
+	// Open borders, so faces on the edges of the chunk get meshed too
+	snapshot.Borders.PosX.fill(0);
+	snapshot.Borders.NegX.fill(0);
+	snapshot.Borders.PosZ.fill(0);
+	snapshot.Borders.NegZ.fill(0);
+
+	std::mt19937 rng(3);
+	for (size_t x = 0; x < CHUNK_SIZE; ++x) {
+		for (size_t z = 0; z < CHUNK_SIZE; ++z) {
+			// Terraces of a few block types, wide enough that greedy meshing merges their faces across several blocks
+			const size_t height = 40 + ((x / 8) * 3 + (z / 8) * 5) % 17;
+			for (size_t y = 0; y < height; ++y) {
+				snapshot.Blocks[GetBlockIndex(x, y, z)] = static_cast<BlockType>(y < 30 ? BlockTypes::STONE : y < height - 3 ? BlockTypes::DIRT : BlockTypes::GRASS);
+			}
+		}
+	}
+	// Scattered blocks of other types above the terraces and holes through them, for uneven AO and every texture layer
+	for (size_t i = 0; i < 600; ++i) {
+		const size_t x = rng() % CHUNK_SIZE, y = 30 + rng() % 60, z = rng() % CHUNK_SIZE;
+		snapshot.Blocks[GetBlockIndex(x, y, z)] = static_cast<BlockType>(i % 3 == 0 ? static_cast<uint32_t>(BlockTypes::AIR) : rng() % static_cast<uint32_t>(BlockTypes::AIR));
+	}
+	return snapshot;
+}
+
+static void compare(const ChunkMeshSnapshot& snapshot, const MeshingMode mode, const char* name) {
+	ChunkMeshArena full_arena, packed_arena;
+	ChunkMeshData full, packed;
+	full.VertexFormat = ChunkVertexFormat::FULL;
+	packed.VertexFormat = ChunkVertexFormat::PACKED;
+	ChunkMeshingSystem::GenerateMesh(snapshot, full_arena, full, mode);
+	ChunkMeshingSystem::GenerateMesh(snapshot, packed_arena, packed, mode);
+
+	if (full.Vertices.size() != packed.PackedVertices.size() || full.Vertices.size() == 0) {
+		std::printf("FAIL %s: %zu full vertices, %zu packed\n", name, full.Vertices.size(), packed.PackedVertices.size());
+		++failures;
+		return;
+	}
+
+	size_t mismatches = 0;
+	bool faces_seen[6]{};
+	bool merged_seen = false;
+	for (size_t i = 0; i < full.Vertices.size(); ++i) {
+		const ChunkMeshComponent::vertex_t& expected = full.Vertices[i];
+		const packed_chunk_vertex_t& v = packed.PackedVertices[i];
+		const decoded_chunk_vertex_t decoded = DecodePackedChunkVertex(v);
+		faces_seen[(v.Data0 >> packed_vertex::FACE_SHIFT) & packed_vertex::FACE_MASK] = true;
+		merged_seen |= ((v.Data1 >> packed_vertex::WIDTH_SHIFT) & packed_vertex::EXTENT_MASK) != 0 ||
+			((v.Data1 >> packed_vertex::HEIGHT_SHIFT) & packed_vertex::EXTENT_MASK) != 0;
+
+		if (decoded.Position != expected.Position || decoded.Normal != expected.Normal || decoded.UV != expected.UV ||
+			static_cast<float>(decoded.AO) != expected.AO) {
+			if (mismatches++ < 8) {
+				std::printf("FAIL %s vertex %zu: position (%g, %g, %g) vs (%g, %g, %g), UV (%g, %g, %g) vs (%g, %g, %g), AO %u vs %g\n", name, i,
+					decoded.Position.x, decoded.Position.y, decoded.Position.z, expected.Position.x, expected.Position.y, expected.Position.z,
+					decoded.UV.x, decoded.UV.y, decoded.UV.z, expected.UV.x, expected.UV.y, expected.UV.z, decoded.AO, expected.AO);
+			}
+		}
+	}
+	failures += mismatches;
+
+	for (size_t f = 0; f < 6; ++f) {
+		check(faces_seen[f], "chunk meshes every face direction");
+	}
+	if (mode == MeshingMode::GREEDY) {
+		check(merged_seen, "greedy meshing merged some faces");
+	}
+}
+
+int main() {
+	const ChunkMeshSnapshot snapshot = makeSnapshot();
+	compare(snapshot, MeshingMode::NAIVE, "naive");
+	compare(snapshot, MeshingMode::GREEDY, "greedy");
+
+	if (failures != 0) {
+		std::printf("%zu failures\n", failures);
+		return 1;
+	}
+	std::printf("All passed\n");
+	return 0;
+}
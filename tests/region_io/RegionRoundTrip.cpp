@@ -0,0 +1,235 @@
+#include "io/RegionStore.hpp"
+#include "io/ChunkSerializer.hpp"
+#include "generation/TerrainGenerator.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+/*
+	Saves a generated area spanning four region files, edits it, and checks every chunk reads back exactly as it was
+	saved: whole and as deltas, after rewrites in place, after payloads outgrow their sectors and move, after erasing
+	chunks, and after closing and reopening the files.
+*/
+
+static size_t failures = 0;
+
+static void check(const bool passed, const char* what) {
+	if (!passed) {
+		std::printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+static bool sameBlocks(const ChunkComponent& lhs, const ChunkComponent& rhs) {
+	for (size_t i = 0; i < BLOCKS_PER_CHUNK; ++i) {
+		if (!(lhs.Blocks.GetBlock(i) == rhs.Blocks.GetBlock(i))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static BlockComponent makeBlock(const uint16_t type) {
+	BlockComponent block;
+	block.Type = type;
+	return block;
+}
+
+static bool loadsAs(RegionStore& store, const ChunkComponent& expected) {
+	ChunkComponent loaded;
+	loaded.GridPosition = expected.GridPosition;
+	return store.LoadChunk(loaded) == ChunkLoadStatus::Loaded && sameBlocks(loaded, expected);
+}
+
+static void testStore(const std::string& directory, const terrain::TerrainGenerator& generator, const bool delta) {
+	std::filesystem::remove_all(directory);
+	TerrainBaseline baseline;
+	if (delta) {
+		baseline.GeneratorVersion = generator.GetVersion();
+		baseline.Generate = [&generator](ChunkComponent& chunk) {
+			generator.Generate(chunk);
+		};
+	}
+
+	// Straddles the corner of four regions, so negative coordinates get covered too
+	std::vector<ChunkComponent> chunks;
+	for (int x = -6; x < 6; ++x) {
+		for (int z = -6; z < 6; ++z) {
+			ChunkComponent chunk;
+			chunk.GridPosition = glm::ivec2(x, z);
+			generator.Generate(chunk);
+			chunks.emplace_back(std::move(chunk));
+		}
+	}
+	std::mt19937 rng(42);
+	// A few edits to some chunks, so deltas aren't all empty
+	for (size_t i = 0; i < chunks.size(); i += 3) {
+		for (size_t j = 0; j < 20; ++j) {
+			chunks[i].Blocks.SetBlock(rng() % CHUNK_SIZE, rng() % CHUNK_SIZE_Y, rng() % CHUNK_SIZE, makeBlock(static_cast<uint16_t>(rng() % 20)));
+		}
+	}
+
+	{
+		RegionStore store(directory, baseline);
+		for (const ChunkComponent& chunk : chunks) {
+			check(store.SaveChunk(chunk), "save");
+		}
+		store.Flush();
+		bool all_loaded = true;
+		for (const ChunkComponent& chunk : chunks) {
+			all_loaded &= loadsAs(store, chunk);
+		}
+		check(all_loaded, delta ? "delta round trip" : "whole round trip");
+		ChunkComponent missing;
+		missing.GridPosition = glm::ivec2(100, 100);
+		check(store.LoadChunk(missing) == ChunkLoadStatus::NotSaved, "chunk never saved");
+	}
+
+	{
+		RegionStore store(directory, baseline);
+		bool all_loaded = true;
+		for (const ChunkComponent& chunk : chunks) {
+			all_loaded &= loadsAs(store, chunk);
+		}
+		check(all_loaded, "round trip after reopening");
+
+		for (size_t i = 0; i < chunks.size(); i += 5) {
+			if (i % 2 == 0) {
+				// Same size or close to it: rewritten in place
+				chunks[i].Blocks.SetBlock(1, 100, 1, makeBlock(static_cast<uint16_t>(BlockTypes::GLASS)));
+			}
+			else {
+				// Noise all through the chunk: far larger, so it has to move
+				for (size_t j = 0; j < 30000; ++j) {
+					chunks[i].Blocks.SetBlock(rng() % CHUNK_SIZE, rng() % CHUNK_SIZE_Y, rng() % CHUNK_SIZE, makeBlock(static_cast<uint16_t>(rng() % 57)));
+				}
+			}
+			check(store.SaveChunk(chunks[i]), "resave");
+		}
+		// Shrunk down to a single run, freeing most of its sectors for the chunks that grew
+		chunks[7].Blocks.Fill(makeBlock(static_cast<uint16_t>(BlockTypes::AIR)));
+		check(store.SaveChunk(chunks[7]), "resave shrunk");
+		store.Flush();
+	}
+
+	{
+		RegionStore store(directory, baseline);
+		bool all_loaded = true;
+		for (const ChunkComponent& chunk : chunks) {
+			all_loaded &= loadsAs(store, chunk);
+		}
+		check(all_loaded, delta ? "delta round trip after rewrites" : "whole round trip after rewrites");
+	}
+}
+
+static void testRegionFile(const std::string& directory) {
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	const std::string path = (std::filesystem::path(directory) / "r.0.0.hrg").string();
+	const glm::ivec2 first(3, 4), second(4, 4), third(5, 4);
+	std::vector<uint8_t> small(1000, 1), large(3 * RegionFile::SECTOR_SIZE + 10, 2), neighbour(5000, 3), payload;
+
+	{
+		RegionFile region(path);
+		check(region.SectorCount() == RegionFile::FIRST_PAYLOAD_SECTOR, "new file holds just the header and table");
+		region.Write(first, span_t<const uint8_t>(small.data(), small.size()));
+		region.Write(second, span_t<const uint8_t>(neighbour.data(), neighbour.size()));
+		const size_t sectors = region.SectorCount();
+
+		// Fits in the sector it already has
+		small.assign(900, 4);
+		region.Write(first, span_t<const uint8_t>(small.data(), small.size()));
+		check(region.SectorCount() == sectors, "rewrite in place keeps the file size");
+		check(region.Read(first, payload) && payload == small, "rewrite in place");
+
+		// Boxed in by "second", so it has to move to the end of the file
+		region.Write(first, span_t<const uint8_t>(large.data(), large.size()));
+		check(region.SectorCount() > sectors, "growth relocates to the end of the file");
+		check(region.Read(first, payload) && payload == large, "grown payload");
+		check(region.Read(second, payload) && payload == neighbour, "neighbour of a relocated payload");
+
+		// Takes the sector "first" left behind, rather than growing the file
+		const size_t grown = region.SectorCount();
+		region.Write(third, span_t<const uint8_t>(small.data(), small.size()));
+		check(region.SectorCount() == grown, "freed sectors are reused");
+
+		region.Erase(second);
+		check(!region.Read(second, payload), "erased chunk reads as never saved");
+		check(region.ReadMapped(second).empty(), "erased chunk maps as never saved");
+		region.Flush();
+	}
+
+	{
+		RegionFile region(path);
+		check(region.Read(first, payload) && payload == large, "relocated payload after reopening");
+		const span_t<const uint8_t> mapped = region.ReadMapped(third);
+		check(mapped.size() == small.size() && std::equal(mapped.begin(), mapped.end(), small.begin()), "mapped read after reopening");
+		check(!region.Read(second, payload), "erased chunk after reopening");
+	}
+}
+
+// A payload the serializer can't decode is Corrupt, and may be overwritten. A region file that can't be read at all
+// throws, as the chunks in it may be fine.
+static void testUnreadable(const std::string& directory) {
+	std::filesystem::remove_all(directory);
+	const glm::ivec2 position(2, 3);
+	std::vector<uint8_t> garbage(300, 0xAB);
+	{
+		RegionStore store(directory);
+		ChunkComponent chunk;
+		chunk.GridPosition = position;
+		check(store.SaveChunk(chunk), "save before corrupting");
+		store.Flush();
+	}
+	{
+		RegionFile region((std::filesystem::path(directory) / "r.0.0.hrg").string());
+		region.Write(position, span_t<const uint8_t>(garbage.data(), garbage.size()));
+		region.Flush();
+	}
+	{
+		RegionStore store(directory);
+		ChunkComponent chunk;
+		chunk.GridPosition = position;
+		check(store.LoadChunk(chunk) == ChunkLoadStatus::Corrupt, "undecodable payload loads as corrupt");
+		check(store.SaveChunk(chunk), "corrupt payload may be overwritten");
+		check(loadsAs(store, chunk), "overwritten corrupt payload");
+	}
+
+	// Not a region file at all
+	const std::string bad_path = (std::filesystem::path(directory) / "r.1.0.hrg").string();
+	{
+		std::FILE* file = std::fopen(bad_path.c_str(), "wb");
+		std::fwrite(garbage.data(), 1, garbage.size(), file);
+		std::fclose(file);
+	}
+	bool threw = false;
+	try {
+		RegionStore store(directory);
+		ChunkComponent chunk;
+		chunk.GridPosition = glm::ivec2(RegionFile::REGION_SIZE, 0);
+		store.LoadChunk(chunk);
+	}
+	catch (const std::exception&) {
+		threw = true;
+	}
+	check(threw, "unreadable region file throws rather than reporting the chunk as unsaved");
+}
+
+int main() {
+	const std::string directory = (std::filesystem::temp_directory_path() / "hephaestus_region_test").string();
+	terrain::TerrainGenerator generator;
+	testStore(directory, generator, false);
+	testStore(directory, generator, true);
+	testRegionFile(directory);
+	testUnreadable(directory);
+	std::filesystem::remove_all(directory);
+
+	if (failures != 0) {
+		std::printf("%zu failures\n", failures);
+		return 1;
+	}
+	std::printf("All passed\n");
+	return 0;
+}
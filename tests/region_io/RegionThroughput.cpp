@@ -0,0 +1,94 @@
+#include "io/RegionStore.hpp"
+#include "generation/TerrainGenerator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+/*
+	Measures save and load throughput per chunk through RegionStore, over a generated area with a few edits per chunk:
+	once saving chunks whole, and once as deltas against the generator, set up the way ChunkManager sets it up.
+	Delta loads include regenerating the baseline. Pass the width of the area, in chunks, to change it from 16.
+*/
+
+using bench_clock = std::chrono::steady_clock;
+
+static double elapsedMs(const bench_clock::time_point& start) {
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static void run(const char* name, const std::string& directory, const TerrainBaseline& baseline, const std::vector<ChunkComponent>& chunks) {
+	std::filesystem::remove_all(directory);
+	const double num_chunks = static_cast<double>(chunks.size());
+
+	double save_ms = 0.0;
+	uint64_t bytes_written = 0;
+	{
+		RegionStore store(directory, baseline);
+		const auto start = bench_clock::now();
+		for (const ChunkComponent& chunk : chunks) {
+			store.SaveChunk(chunk);
+		}
+		store.Flush();
+		save_ms = elapsedMs(start);
+		bytes_written = store.BytesWritten();
+	}
+
+	// Reopened, so loads map the files afresh rather than reusing the mapping saving left behind
+	double load_ms = 0.0;
+	{
+		RegionStore store(directory, baseline);
+		std::vector<ChunkComponent> loaded(chunks.size());
+		const auto start = bench_clock::now();
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			loaded[i].GridPosition = chunks[i].GridPosition;
+			if (store.LoadChunk(loaded[i]) != ChunkLoadStatus::Loaded) {
+				std::printf("Failed to load chunk (%d, %d)\n", chunks[i].GridPosition.x, chunks[i].GridPosition.y);
+			}
+		}
+		load_ms = elapsedMs(start);
+	}
+
+	std::printf("%-6s save %8.1f us/chunk  load %8.1f us/chunk  %8.1f bytes/chunk\n", name, save_ms * 1000.0 / num_chunks,
+		load_ms * 1000.0 / num_chunks, static_cast<double>(bytes_written) / num_chunks);
+	std::filesystem::remove_all(directory);
+}
+
+int main(int argc, char* argv[]) {
+	const int width = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 16;
+	const std::string directory = (std::filesystem::temp_directory_path() / "hephaestus_region_throughput").string();
+
+	auto generator = std::make_shared<terrain::TerrainGenerator>();
+	generator->SetStageEnabled(terrain::terrainStage::DECORATION, false);
+	generator->SetStageCached(terrain::terrainStage::HEIGHT, true);
+	generator->SetStageCached(terrain::terrainStage::CAVES, true);
+
+	std::vector<ChunkComponent> chunks;
+	std::mt19937 rng(7);
+	for (int x = -width / 2; x < width - width / 2; ++x) {
+		for (int z = -width / 2; z < width - width / 2; ++z) {
+			ChunkComponent chunk;
+			chunk.GridPosition = glm::ivec2(x, z);
+			generator->Generate(chunk);
+			for (size_t i = 0; i < 64; ++i) {
+				BlockComponent block;
+				block.Type = static_cast<uint16_t>(BlockTypes::BRICK);
+				chunk.Blocks.SetBlock(rng() % CHUNK_SIZE, rng() % CHUNK_SIZE_Y, rng() % CHUNK_SIZE, block);
+			}
+			chunks.emplace_back(std::move(chunk));
+		}
+	}
+	std::printf("%zu chunks\n", chunks.size());
+
+	run("whole", directory, TerrainBaseline(), chunks);
+	TerrainBaseline baseline;
+	baseline.GeneratorVersion = generator->GetVersion();
+	baseline.Generate = [generator](ChunkComponent& chunk) {
+		generator->Generate(chunk);
+	};
+	run("delta", directory, baseline, chunks);
+	return 0;
+}
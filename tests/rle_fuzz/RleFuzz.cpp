@@ -0,0 +1,172 @@
+#include "util/rle.hpp"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+	Round-trips random and adversarial data through rle_system, for each type it's used with, and checks the
+	encoding against a plain scalar encoder: the vector run searches must find exactly the same runs.
+
+	Built twice, with and without AVX2, so both vector paths are covered.
+*/
+
+static size_t failures = 0;
+
+template<typename T>
+static std::vector<T> referenceEncode(const std::vector<T>& input) {
+	using codec = rle_system<T>;
+	std::vector<T> result;
+	size_t read = 0;
+	while (read < input.size()) {
+		const size_t max_count = std::min<size_t>(input.size() - read, codec::COUNTER_MASK);
+		size_t run = 1;
+		while (run < max_count && input[read + run] == input[read]) {
+			++run;
+		}
+		if (run >= codec::MIN_RUN) {
+			result.push_back(T(codec::REPETITION_BIT | T(run)));
+			result.push_back(input[read]);
+			read += run;
+			continue;
+		}
+		size_t uniques = 0;
+		while (uniques < max_count && !(uniques + 2 < max_count && input[read + uniques] == input[read + uniques + 1] &&
+			input[read + uniques] == input[read + uniques + 2])) {
+			++uniques;
+		}
+		result.push_back(T(uniques));
+		result.insert(result.end(), input.begin() + read, input.begin() + read + uniques);
+		read += uniques;
+	}
+	return result;
+}
+
+template<typename T>
+static void checkRoundTrip(const std::vector<T>& input, const char* name) {
+	using codec = rle_system<T>;
+	std::vector<T> encoded(codec::max_encoded_size(input.size()));
+	const size_t encoded_size = codec::encode(span_t<const T>(input.data(), input.size()), span_t<T>(encoded.data(), encoded.size()));
+	encoded.resize(encoded_size);
+	if (encoded != referenceEncode(input)) {
+		std::printf("FAIL %s (%zu bit, %zu values): encoding differs from the scalar reference\n", name, sizeof(T) * 8, input.size());
+		++failures;
+		return;
+	}
+
+	std::vector<T> decoded(input.size());
+	const size_t decoded_size = codec::decode(span_t<const T>(encoded.data(), encoded.size()), span_t<T>(decoded.data(), decoded.size()));
+	if (decoded_size != input.size() || decoded != input) {
+		std::printf("FAIL %s (%zu bit, %zu values): decoded data differs from the input\n", name, sizeof(T) * 8, input.size());
+		++failures;
+	}
+}
+
+template<typename T>
+static void checkMalformed() {
+	using codec = rle_system<T>;
+	auto throws = [](const std::vector<T>& input, const size_t output_size) {
+		std::vector<T> output(output_size);
+		try {
+			codec::decode(span_t<const T>(input.data(), input.size()), span_t<T>(output.data(), output.size()));
+		}
+		catch (const std::exception&) {
+			return true;
+		}
+		return false;
+	};
+
+	// Zero count, repetition missing its value, copy running off the end, and output too small
+	if (!throws({ T(0) }, 8) || !throws({ T(codec::REPETITION_BIT | T(4)) }, 8) || !throws({ T(3), T(1), T(2) }, 8) ||
+		!throws({ T(codec::REPETITION_BIT | T(9)), T(1) }, 8)) {
+		std::printf("FAIL malformed (%zu bit): decode accepted bad input\n", sizeof(T) * 8);
+		++failures;
+	}
+}
+
+template<typename T>
+static void fuzz(std::mt19937& rng) {
+	using codec = rle_system<T>;
+	// Long enough to need several tokens at COUNTER_MASK for 8 bit values, without making 32 bit ones slow
+	const size_t max_size = std::min<size_t>(size_t(codec::COUNTER_MASK) * 3 + 77, 70000);
+	constexpr size_t LANES = 32 / sizeof(T);
+
+	checkRoundTrip(std::vector<T>(), "empty");
+	for (size_t size = 1; size <= LANES * 2 + 3; ++size) {
+		// Tails shorter than a vector, with and without a run in them
+		std::vector<T> values(size);
+		for (size_t i = 0; i < size; ++i) {
+			values[i] = T(i);
+		}
+		checkRoundTrip(values, "short uniques");
+		checkRoundTrip(std::vector<T>(size, T(7)), "short run");
+		if (size >= 3) {
+			values[size - 1] = values[size - 2] = values[size - 3];
+			checkRoundTrip(values, "run at the tail");
+		}
+	}
+
+	// Runs right at, and either side of, the longest a single token can count
+	for (const size_t length : { size_t(codec::COUNTER_MASK) - 1, size_t(codec::COUNTER_MASK), size_t(codec::COUNTER_MASK) + 1,
+		size_t(codec::COUNTER_MASK) * 2, size_t(codec::COUNTER_MASK) + 2 }) {
+		if (length <= max_size) {
+			checkRoundTrip(std::vector<T>(length, std::numeric_limits<T>::max()), "run at COUNTER_MASK");
+		}
+	}
+	// As many uniques as a token can count, so the copy has to be split
+	{
+		std::vector<T> values(std::min<size_t>(size_t(codec::COUNTER_MASK) + 5, max_size));
+		for (size_t i = 0; i < values.size(); ++i) {
+			values[i] = T(i % 2);
+		}
+		checkRoundTrip(values, "uniques at COUNTER_MASK");
+	}
+	// Pairs: runs of 2 are too short to encode as repetitions, so the whole thing is one long copy
+	{
+		std::vector<T> values(1000);
+		for (size_t i = 0; i < values.size(); ++i) {
+			values[i] = T(i / 2);
+		}
+		checkRoundTrip(values, "runs of 2");
+	}
+	// A run starting at each offset within a vector, ending at each offset in the next
+	for (size_t start = 0; start < LANES; ++start) {
+		for (size_t length = 1; length < LANES * 2; ++length) {
+			std::vector<T> values(LANES * 4);
+			for (size_t i = 0; i < values.size(); ++i) {
+				values[i] = T(i + 1);
+			}
+			std::fill_n(values.begin() + start, length, T(0));
+			checkRoundTrip(values, "run at every offset");
+		}
+	}
+
+	// Random runs of random lengths, over a few values so neighbouring runs often share one
+	for (size_t iteration = 0; iteration < 200; ++iteration) {
+		std::vector<T> values(rng() % max_size);
+		const uint32_t num_values = 1 + rng() % 4;
+		const uint32_t max_run = 1 + rng() % (iteration % 2 == 0 ? 8 : 300);
+		size_t i = 0;
+		while (i < values.size()) {
+			const size_t run = std::min<size_t>(1 + rng() % max_run, values.size() - i);
+			std::fill_n(values.begin() + i, run, T(rng() % num_values));
+			i += run;
+		}
+		checkRoundTrip(values, "random runs");
+	}
+
+	checkMalformed<T>();
+}
+
+int main() {
+	std::printf("rle_fuzz: vector path %s\n", HEPHAESTUS_RLE_SIMD == 2 ? "AVX2" : HEPHAESTUS_RLE_SIMD == 1 ? "SSE2" : "none");
+	std::mt19937 rng(1234);
+	fuzz<uint8_t>(rng);
+	fuzz<uint16_t>(rng);
+	fuzz<uint32_t>(rng);
+	if (failures != 0) {
+		std::printf("%zu failures\n", failures);
+		return 1;
+	}
+	std::printf("All passed\n");
+	return 0;
+}